@@ -0,0 +1,33 @@
+#include "AnalogDma.h"
+#include <Arduino.h>
+#include <libmaple/adc.h>
+#include <libmaple/dma.h>
+
+void AnalogDma::begin() {
+  adc_dev* adc = ADC1;
+  adc_set_sample_rate(adc, ADC_SMPR_71_5);
+  adc_set_reg_seqlen(adc, _pinCount);
+  uint32 sqr3 = 0;
+  for (int i = 0; i < _pinCount; i++) {
+    pinMode(_pins[i], INPUT_ANALOG);
+    sqr3 |= PIN_MAP[_pins[i]].adc_channel << (5 * i);
+  }
+  adc->regs->SQR3 = sqr3;
+  adc->regs->CR1 |= ADC_CR1_SCAN;
+  adc->regs->CR2 |= ADC_CR2_DMA;
+
+  // TIMER3's update event is its trigger output, and that starts each scan
+  TIMER3->regs.gen->CR2 = (TIMER3->regs.gen->CR2 & ~TIMER_CR2_MMS) | TIMER_CR2_MMS_UPDATE;
+  adc_set_extsel(adc, ADC_EXT_EV_TIM3_TRGO);
+  adc_set_exttrig(adc, 1);
+
+  dma_init(DMA1);
+  dma_setup_transfer(DMA1, DMA_CH1, &adc->regs->DR, DMA_SIZE_16BITS, _buffer, DMA_SIZE_16BITS,
+                     DMA_MINC_MODE | DMA_CIRC_MODE);
+  dma_set_num_transfers(DMA1, DMA_CH1, _pinCount * _frames);
+  dma_enable(DMA1, DMA_CH1);
+}
+
+int AnalogDma::frame() const {
+  return (_pinCount * _frames - dma_get_count(DMA1, DMA_CH1)) / _pinCount;
+}
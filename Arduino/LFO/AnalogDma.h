@@ -0,0 +1,42 @@
+/**
+ * @file AnalogDma.h
+ * @author Gino Bollaert
+ * @brief Analog inputs sampled continuously into a circular buffer by ADC1 and DMA
+ * @details ADC1 converts the pins in order (scan mode) on every TIMER3 update event, i.e. once per PWM period, and
+ * DMA1 channel 1 writes each conversion to the next place in the buffer, wrapping at its end. Reading an input is then
+ * a memory read with no wait for the ADC, and frame() tells how far the DMA has got. AnalogDma.cpp sets up the
+ * peripherals; the host build links sim/hal/AnalogDma.cpp instead, which hands the buffer to the simulator's ADC model.
+ * @date 2023-07-03
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+class AnalogDma
+{
+public:
+  /** Samples `pinCount` pins, up to six, into `buffer`, which holds `frames` frames of one sample per pin */
+  AnalogDma(const uint8_t* pins, int pinCount, uint16_t* buffer, int frames)
+      : _pins(pins), _pinCount(pinCount), _buffer(buffer), _frames(frames)
+  {
+  }
+
+  /** Starts the conversions; TIMER3 must be running for them to be triggered */
+  void begin();
+
+  /** The frame the DMA is writing: the frames before it, back to where it was last read, are complete */
+  int frame() const;
+
+  int pinCount() const { return _pinCount; }
+  int frames() const { return _frames; }
+  /** Sample of pin `pin` (an index into the pins) in frame `frame` */
+  const uint16_t* samples(int frame, int pin) const { return _buffer + frame * _pinCount + pin; }
+
+private:
+  const uint8_t* _pins;
+  int _pinCount;
+  uint16_t* _buffer;
+  int _frames;
+};
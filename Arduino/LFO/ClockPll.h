@@ -0,0 +1,143 @@
+/**
+ * @file ClockPll.h
+ * @author Gino Bollaert
+ * @brief Tempo and beat position from MIDI clock ticks
+ * @details MIDI clock is 24 ticks per quarter note. Each tick is stamped with the time loop() parsed it, so the stamps
+ * carry the sender's jitter, USB's 1 ms frames and loop()'s own latency. A second-order delay-locked loop predicts
+ * each tick from the last one and the period, then moves the prediction by a fraction b of the error and the period
+ * by a fraction c = b^2 / 2 of it, which damps the loop critically. The loop starts wide, so that it locks within a
+ * couple of beats, and narrows in steps to a bandwidth of about 1/150 of the tick rate to filter out the jitter. A tick
+ * more than half a period late is taken for the second after a lost one and a tick more than half a period early is
+ * dropped. An error of more than a quarter of the period is beyond any jitter: the tempo has changed, so the loop is
+ * widened again to follow it.
+ *
+ * Times are micros() with an 8-bit fraction. The filtered time of the latest tick, its position since the last
+ * Start and the period give the beat phase at any moment, so the LFO can be locked to it; the divides that turn
+ * these into a rate and a phase slope are done once per tick.
+ * @date 2023-07-07
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+class ClockPll
+{
+public:
+  static constexpr int TicksPerBeat = 24;
+  // Ticks counted before the position wraps: three bars, a whole number of every division the LFO can follow
+  static constexpr int PositionWrap = 288;
+  static constexpr int LockTicks = TicksPerBeat;
+
+  /** Forgets the clock, as when it has stopped */
+  void reset()
+  {
+    _ticks = 0;
+    _position = -1;
+    _locked = false;
+  }
+
+  /** MIDI Start: the next tick is the first of a bar */
+  void start() { _position = -1; }
+
+  /** A clock tick received at `us` */
+  void tick(uint32_t us)
+  {
+    if (_ticks < 2)
+    {
+      step();
+    }
+    if (_ticks == 0)
+    {
+      _time = us;
+      _fraction = 0;
+      _ticks = 1;
+      return;
+    }
+    if (_ticks == 1)
+    {
+      // The first interval is the first estimate of the period
+      _period = (us - _time) << 8;
+      _time = us;
+      _ticks = 2;
+      return;
+    }
+
+    int32_t error = static_cast<int32_t>(us - _time) * 256 - _fraction - static_cast<int32_t>(_period);
+    if (error < -static_cast<int32_t>(_period >> 1))
+    {
+      return; // a tick in the middle of the period is not one of the clock's
+    }
+    if (error > static_cast<int32_t>(_period >> 1))
+    {
+      // A tick was lost on the way: count it where it should have been
+      step();
+      advance(static_cast<int32_t>(_period));
+      error -= static_cast<int32_t>(_period);
+    }
+    step();
+    int32_t limit = static_cast<int32_t>(_period >> 2);
+    if (error > limit || error < -limit)
+    {
+      _ticks = 2;
+    }
+    int shift = _ticks < 12 ? 1 : _ticks < 48 ? 2 : _ticks < 96 ? 3 : 4;
+    advance(static_cast<int32_t>(_period) + (error >> shift));
+    _period += error >> (2 * shift + 1);
+    if (_ticks < 96)
+    {
+      _ticks++;
+    }
+    _locked = _locked || _ticks >= LockTicks;
+  }
+
+  bool locked() const { return _locked; }
+  /** True once no tick has come for four periods after `us` */
+  bool timedOut(uint32_t us) const
+  {
+    return _ticks > 1 && static_cast<int32_t>(us - _time) > static_cast<int32_t>(_period >> 6);
+  }
+
+  /** Filtered time of the latest tick, as micros() */
+  uint32_t time() const { return _time; }
+  /** Filtered interval between ticks in us, Q8 */
+  uint32_t period() const { return _period; }
+  /** Ticks from the last Start (or the first tick seen) to the latest one, wrapping at PositionWrap */
+  int position() const { return _position; }
+
+  /** Rate in Hz, unsigned Q16.16, of a cycle `ticks` ticks long */
+  uint32_t rate(int ticks) const
+  {
+    return static_cast<uint32_t>((1000000ull << 24) / (static_cast<uint64_t>(ticks) * _period));
+  }
+
+  /** Phase, in 2^-32 of a cycle `ticks` long, at the latest tick: zero on every `ticks`th tick from the position 0 */
+  uint32_t phase(int ticks) const
+  {
+    return static_cast<uint32_t>((static_cast<uint64_t>(_position % ticks) << 32) / ticks);
+  }
+
+  /** Phase advance per us of a cycle `ticks` long, Q8 */
+  uint32_t phasePerUs(int ticks) const
+  {
+    return static_cast<uint32_t>((1ull << 48) / (static_cast<uint64_t>(ticks) * _period));
+  }
+
+private:
+  void step() { _position = _position + 1 == PositionWrap ? 0 : _position + 1; }
+
+  void advance(int32_t q8)
+  {
+    int32_t total = _fraction + q8;
+    _time += total >> 8;
+    _fraction = total & 0xff;
+  }
+
+  uint32_t _time = 0; // us
+  int32_t _fraction = 0; // 1/256 us past _time
+  uint32_t _period = 0;
+  int _ticks = 0;
+  int _position = -1;
+  bool _locked = false;
+};
@@ -0,0 +1,142 @@
+/**
+ * @file Compressor.h
+ * @author Gino Bollaert
+ * @brief Fixed-point envelope follower and gain computer for the compressor
+ * @details The envelope input is reduced to its peak over each block of ADC samples, and each peak is one control
+ * sample. A one-pole follower tracks it with the attack coefficient while it rises and the release coefficient while
+ * it falls. The gain computer works on the log2 of the followed level: above the threshold, the excess is scaled by
+ * the amount (1 - 1 / ratio) and the gain is 2 to the minus that. The log and exponential use the count of leading
+ * zeros and small tables, so processing needs no float and no divide. Only the control path, turning times into
+ * coefficients, divides.
+ * @date 2023-07-03
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+struct CompressorParams
+{
+  uint16_t attack = 0xffff;  // follower coefficient per control sample while the level rises, Q16
+  uint16_t release = 0xffff; // and while it falls
+  int16_t threshold = 0;     // log2 of the level relative to full scale, Q8
+  uint16_t amount = 0;       // 1 - 1 / ratio, Q16: 0 leaves the gain at unity
+};
+
+/** 2^(-k / 32) in Q16, summing the series of e^x so that the table is built at compile time */
+constexpr uint16_t exp2Fraction(int k)
+{
+  double x = -0.6931471805599453 * k / 32;
+  double term = 1;
+  double sum = 1;
+  for (int n = 1; n < 16; n++)
+  {
+    term *= x / n;
+    sum += term;
+  }
+  double q = sum * 65536 + 0.5;
+  return q >= 65535 ? 0xffff : static_cast<uint16_t>(q);
+}
+
+// 33 entries, so that the last step of the octave interpolates towards 2^-1
+struct Exp2FractionTable
+{
+  uint16_t values[33];
+
+  constexpr uint16_t operator[](int k) const { return values[k]; }
+};
+
+constexpr Exp2FractionTable makeExp2FractionTable()
+{
+  Exp2FractionTable table = {};
+  for (int k = 0; k <= 32; k++)
+  {
+    table.values[k] = exp2Fraction(k);
+  }
+  return table;
+}
+
+inline constexpr Exp2FractionTable Exp2Fractions = makeExp2FractionTable();
+
+class Compressor
+{
+public:
+  static constexpr uint16_t Unity = 0xffff;
+  static constexpr int InputBits = 12;
+
+  /** One-pole coefficient, Q16, for a time constant of `ms` at `rate` control samples per second */
+  static uint16_t coefficient(uint32_t ms, uint32_t rate)
+  {
+    // 1 / (n + 1/2) for a time constant of n samples is within 2% of the exact 1 - e^(-1/n) from n = 2, 0.1% from 10
+    uint32_t c = (1000u << 16) / (500u + ms * rate);
+    return c > 0xffff ? 0xffff : static_cast<uint16_t>(c);
+  }
+
+  /** Takes one block of ADC samples, `stride` apart, and returns the gain for it */
+  uint16_t processBlock(const uint16_t* samples, int count, const CompressorParams& params, int stride = 1)
+  {
+    uint16_t peak = 0;
+    for (int i = 0; i < count * stride; i += stride)
+    {
+      peak = samples[i] > peak ? samples[i] : peak;
+    }
+    return process(peak, params);
+  }
+
+  /** Takes one control sample, a 12-bit level, and returns the gain for it, Q16 */
+  uint16_t process(uint16_t level, const CompressorParams& params)
+  {
+    int32_t input = static_cast<int32_t>(level) << (EnvelopeBits - InputBits);
+    int32_t delta = input - _envelope;
+    uint16_t coefficient = delta > 0 ? params.attack : params.release;
+    _envelope += static_cast<int32_t>((static_cast<int64_t>(delta) * coefficient) >> 16);
+
+    _gain = Unity;
+    if (params.amount != 0 && _envelope > 0)
+    {
+      int32_t over = log2Q8(static_cast<uint32_t>(_envelope)) - EnvelopeBits * 256 - params.threshold;
+      if (over > 0)
+      {
+        _gain = exp2NegativeQ8((over * params.amount) >> 16);
+      }
+    }
+    return _gain;
+  }
+
+  uint16_t gain() const { return _gain; }
+  /** The followed level, full scale 1 << 24 */
+  int32_t envelope() const { return _envelope; }
+
+  /** log2(x) in Q8, rounded, within 0.004; x > 0 */
+  static int32_t log2Q8(uint32_t x)
+  {
+    int exponent = 31 - __builtin_clz(x);
+    uint32_t f = ((x << (31 - exponent)) >> 15) & 0xffff; // the 16 bits below the leading one, Q16
+    // log2(1 + f) - f is close to f (1 - f) (0.422 - 0.158 f), within 0.001
+    uint32_t p = (f * (0x10000 - f)) >> 16;
+    uint32_t correction = (p * (27656 - ((10355 * f) >> 16))) >> 16;
+    return (exponent << 8) + static_cast<int32_t>((f + correction + 128) >> 8);
+  }
+
+  /** 2^(-x / 256) in Q16 for x >= 0 */
+  static uint16_t exp2NegativeQ8(int32_t x)
+  {
+    int shift = x >> 8;
+    if (shift >= 16)
+    {
+      return 0;
+    }
+    int index = (x >> 3) & 31;
+    int frac = x & 7;
+    uint32_t a = Exp2Fractions[index];
+    uint32_t b = Exp2Fractions[index + 1];
+    return static_cast<uint16_t>((a - (((a - b) * frac) >> 3)) >> shift);
+  }
+
+private:
+  static constexpr int EnvelopeBits = 24;
+
+  int32_t _envelope = 0;
+  uint16_t _gain = Unity;
+};
@@ -0,0 +1,75 @@
+/**
+ * @file ControlChangeTable.h
+ * @author Gino Bollaert
+ * @brief Latest-value table for coalescing incoming MIDI control changes
+ * @details Control changes are recorded as they are parsed and applied once per loop(), so a dense sweep of one
+ * controller costs one update per loop instead of one per message.
+ * @date 2023-06-20
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+class ControlChangeTable
+{
+public:
+  static constexpr int Size = 128;
+
+  /** Records the latest value of `controller`, replacing one that has not been applied yet */
+  void set(uint8_t controller, uint8_t value)
+  {
+    controller &= Size - 1;
+    uint32_t bit = 1u << (controller & 31);
+    uint32_t& word = _dirty[controller >> 5];
+    if (word & bit)
+    {
+      _coalesced++;
+    }
+    word |= bit;
+    _values[controller] = value;
+    _received++;
+  }
+
+  /**
+   * Calls apply(controller, value) for every controller set since the previous call, in controller order, and
+   * returns how many were applied
+   */
+  template <typename F> int apply(F apply)
+  {
+    int count = 0;
+    for (int w = 0; w < Size / 32; w++)
+    {
+      while (_dirty[w])
+      {
+        uint8_t controller = (w << 5) + __builtin_ctz(_dirty[w]);
+        _dirty[w] &= _dirty[w] - 1;
+        apply(controller, _values[controller]);
+        count++;
+      }
+    }
+    _applied += count;
+    return count;
+  }
+
+  /** Drops the changes that have not been applied yet */
+  void discard()
+  {
+    for (uint32_t& word : _dirty)
+    {
+      word = 0;
+    }
+  }
+
+  uint32_t received() const { return _received; }
+  uint32_t applied() const { return _applied; }
+  uint32_t coalesced() const { return _coalesced; }
+
+private:
+  uint8_t _values[Size] = {};
+  uint32_t _dirty[Size / 32] = {};
+  uint32_t _received = 0;
+  uint32_t _applied = 0;
+  uint32_t _coalesced = 0;
+};
@@ -0,0 +1,116 @@
+/**
+ * @file Curves.h
+ * @author Gino Bollaert
+ * @brief MIDI CC value to parameter curves
+ * @details Each curve is defined once as a constexpr function of the 7-bit CC value and tabulated into a 128-entry
+ * lookup table at build time. The firmware reads the tables when a CC arrives and tools/curves.cpp prints them.
+ * @date 2023-06-18
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+constexpr int CurveSize = 128;
+
+template <typename T> struct CurveTable
+{
+  T values[CurveSize];
+
+  constexpr T operator[](int val) const { return values[val]; }
+};
+
+template <typename T> constexpr CurveTable<T> makeCurve(T (*curve)(int))
+{
+  CurveTable<T> table = {};
+  for (int val = 0; val < CurveSize; val++)
+  {
+    table.values[val] = curve(val);
+  }
+  return table;
+}
+
+/** LFO rate r + r^3 Hz with r = 3 * val / 127, as unsigned Q16.16 */
+constexpr uint32_t rateCurve(int val)
+{
+  uint64_t r = (val * (3 << 16)) / 127;
+  return static_cast<uint32_t>(r + ((r * r * r) >> 32));
+}
+
+/** LFO rate in rotations per minute, rounded, for display */
+constexpr uint16_t rateRpmCurve(int val) { return static_cast<uint16_t>((rateCurve(val) * 60 + 0x8000) >> 16); }
+
+/** Ramp time in ms, roughly 8 * val + val^2 / 4 */
+constexpr uint16_t rampTimeCurve(int val) { return ((1001 * val) >> 7) + ((4071 * val * val) >> 14); }
+
+/** Volume and expression gain, 0 to 0xffff, roughly quadratic */
+constexpr uint16_t volumeCurve(int val) { return ((val * val) << 1) + val * 262; }
+
+/** Tremolo, vibrato and phaser depth, linear 0 to 0xfffc */
+constexpr uint16_t depthCurve(int val) { return (val << 9) + (val << 2); }
+
+/** Stereo phase spread in 2^-32 cycles, up to half a cycle */
+constexpr uint32_t autopanWidthCurve(int val)
+{
+  uint32_t d = val * 0x8000 / 128;
+  return (d << 16) + d;
+}
+
+/** Rotary phase in 2^-32 cycles, up to a whole cycle */
+constexpr uint32_t rotaryPhaseCurve(int val)
+{
+  uint32_t d = val * 0x10000 / 128;
+  return (d << 16) + d;
+}
+
+/** Depth in percent, for display */
+constexpr uint8_t percentCurve(int val) { return val * 100 / 127; }
+
+/** Phase control in percent for display: 0 to 100 over the lower half of the range, then -99 back towards 0 */
+constexpr int8_t signedPercentCurve(int val)
+{
+  int p = val * 200 / 128;
+  return p > 100 ? p - 200 : p;
+}
+
+/** Compressor attack time in ms, 1 to 100, roughly quadratic */
+constexpr uint16_t compressorAttackCurve(int val) { return 1 + (99 * val * val) / (127 * 127); }
+
+/** Compressor release time in ms, 10 to 2000, roughly quadratic */
+constexpr uint16_t compressorReleaseCurve(int val) { return 10 + (1990 * val * val) / (127 * 127); }
+
+/** Compressor threshold as log2 of the level relative to full scale, Q8: from 8 octaves (48 dB) below up to it */
+constexpr int16_t compressorThresholdCurve(int val) { return (val - 127) * 2048 / 127; }
+
+/** Compressor threshold in dB, rounded, for display */
+constexpr int8_t compressorThresholdDbCurve(int val)
+{
+  return -((-compressorThresholdCurve(val) * 6021 + 128000) / 256000);
+}
+
+/** Compressor amount, 1 - 1 / ratio, 0 (off) to 0xffff (limiting) */
+constexpr uint16_t compressorAmountCurve(int val) { return val * 0xffff / 127; }
+
+/** MIDI clock ticks per LFO cycle, 0 to run free: off, 1, 1/2, 1/4, dotted 1/8, 1/8, 1/8 triplet, 1/16 */
+constexpr uint8_t clockDivisionCurve(int val)
+{
+  constexpr uint8_t ticks[] = {0, 96, 48, 24, 18, 12, 8, 6};
+  return ticks[val >> 4];
+}
+
+inline constexpr CurveTable<uint32_t> RateCurve = makeCurve(rateCurve);
+inline constexpr CurveTable<uint16_t> RateRpmCurve = makeCurve(rateRpmCurve);
+inline constexpr CurveTable<uint16_t> RampTimeCurve = makeCurve(rampTimeCurve);
+inline constexpr CurveTable<uint16_t> VolumeCurve = makeCurve(volumeCurve);
+inline constexpr CurveTable<uint16_t> DepthCurve = makeCurve(depthCurve);
+inline constexpr CurveTable<uint32_t> AutopanWidthCurve = makeCurve(autopanWidthCurve);
+inline constexpr CurveTable<uint32_t> RotaryPhaseCurve = makeCurve(rotaryPhaseCurve);
+inline constexpr CurveTable<uint8_t> PercentCurve = makeCurve(percentCurve);
+inline constexpr CurveTable<int8_t> SignedPercentCurve = makeCurve(signedPercentCurve);
+inline constexpr CurveTable<uint16_t> CompressorAttackCurve = makeCurve(compressorAttackCurve);
+inline constexpr CurveTable<uint16_t> CompressorReleaseCurve = makeCurve(compressorReleaseCurve);
+inline constexpr CurveTable<int16_t> CompressorThresholdCurve = makeCurve(compressorThresholdCurve);
+inline constexpr CurveTable<int8_t> CompressorThresholdDbCurve = makeCurve(compressorThresholdDbCurve);
+inline constexpr CurveTable<uint16_t> CompressorAmountCurve = makeCurve(compressorAmountCurve);
+inline constexpr CurveTable<uint8_t> ClockDivisionCurve = makeCurve(clockDivisionCurve);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include "TextBuffer.h"
 
 enum class Align {
   kLeft = 0,
@@ -10,10 +11,16 @@ enum class Align {
 class DisplayInterface {
 public:
   virtual void clear() = 0;
+  virtual void clearRect(int x, int y, int w, int h) = 0;
   virtual void show() = 0;
   virtual int width() = 0;
   virtual int height() = 0;
   virtual void requestFontHeight(int hgt) = 0;
   virtual int fontHeight() = 0;
-  virtual void drawString(int x, int y, String s, Align align = Align::kLeft) = 0;
+  virtual void drawString(int x, int y, const char* s, Align align = Align::kLeft) = 0;
+
+  // Displays that can send their frame in horizontal bands override these, so that a transfer can be spread over
+  // several calls; by default the whole frame is a single page.
+  virtual int pageCount() { return 1; }
+  virtual void showPage(int /* page */) { show(); }
 };
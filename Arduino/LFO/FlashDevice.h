@@ -0,0 +1,52 @@
+/**
+ * @file FlashDevice.h
+ * @author Gino Bollaert
+ * @brief Page-erasable NOR flash interface
+ * @details Follows the STM32F1 embedded flash: an erased page reads 0xff, programming writes half-words that must
+ * still be erased, and the only way back to 0xff is erasing the whole page.
+ * @date 2023-06-26
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+class FlashDevice
+{
+public:
+  virtual ~FlashDevice() = default;
+
+  virtual uint32_t pageSize() const = 0;
+  virtual int pageCount() const = 0;
+
+  virtual void read(int page, uint32_t offset, void* data, uint32_t bytes) = 0;
+  virtual bool erasePage(int page) = 0;
+  /** Programs `count` half-words at an even `offset`; returns false if the flash reports an error */
+  virtual bool program(int page, uint32_t offset, const uint16_t* data, uint32_t count) = 0;
+};
+
+/**
+ * Fletcher-32 of `count` half-words, the checksum of the records kept in flash. The sums are reduced once per 359
+ * words, the most that cannot overflow 32 bits, rather than once per word.
+ */
+inline uint32_t fletcher32(const uint16_t* words, uint32_t count)
+{
+  uint32_t a = 0xffff;
+  uint32_t b = 0xffff;
+  while (count > 0)
+  {
+    uint32_t block = count < 359 ? count : 359;
+    count -= block;
+    while (block-- > 0)
+    {
+      a += *words++;
+      b += a;
+    }
+    a = (a & 0xffff) + (a >> 16);
+    b = (b & 0xffff) + (b >> 16);
+  }
+  a = (a & 0xffff) + (a >> 16);
+  b = (b & 0xffff) + (b >> 16);
+  return (b << 16) | a;
+}
@@ -9,13 +9,80 @@
 
 #pragma once
 
-#include "PotController.h"
+#include "AnalogDma.h"
+#include "ClockPll.h"
+#include "Compressor.h"
+#include "ControlChangeTable.h"
+#include "Curves.h"
+#include "InternalFlash.h"
+#include "PotFilter.h"
 #include "OledDisplay.h"
 #include "MidiController.h"
+#include "MidiParser.h"
+#include "PresetBank.h"
+#include "PwmDither.h"
+#include "RecordLog.h"
+#include "StateBuffer.h"
+#include "StatusRenderer.h"
+#include "SysEx.h"
+#include "Trace.h"
 #include "WaveTable.h"
 
 #define USB_SERIAL_LOGGING 0
+#ifndef OLED_DISPLAY
 #define OLED_DISPLAY 1
+#endif
+
+// 1: TIMER1's repetition counter raises the update interrupt once per sample (every DownSample PWM periods)
+// 0: the update interrupt fires every PWM period and TimerInterrupt() downsamples with a counter
+#ifndef SAMPLE_RATE_TIMER
+#define SAMPLE_RATE_TIMER 1
+#endif
+
+// 1: TimerInterrupt() runs every PWM period and carries the bits of each 16-bit level below the PWM's resolution over
+//    to the following periods (pwmDither), so that they average to the level; it renders every DownSample periods.
+//    This gives up SAMPLE_RATE_TIMER's one interrupt per sample, and resets TIMER2 to TIMER4 from TIMER1.
+// 0: the levels are truncated to PwmBits
+#ifndef PWM_DITHER
+#define PWM_DITHER 0
+#endif
+
+// 1: MIDI control changes are collected in controlChanges and the latest value of each is applied once per loop()
+// 0: every control change is applied and published as soon as it is parsed, as it was originally
+#ifndef CC_COALESCING
+#define CC_COALESCING 1
+#endif
+
+// 1: the control values are saved to flash once they have settled and restored at power-on
+// 0: every power-on starts from DefaultSettings
+#ifndef SETTINGS_PERSISTENCE
+#define SETTINGS_PERSISTENCE 1
+#endif
+
+// 1: the rate, tremolo and vibrato pots are read from the ADC's DMA buffer and a turn of one is a control change
+// 0: the pots are not read
+#ifndef POT_CONTROLS
+#define POT_CONTROLS 1
+#endif
+
+// 1: with a clock division chosen, the LFO follows the MIDI clock's tempo and TimerInterrupt() keeps it on the beat
+// 0: MIDI clock is ignored
+#ifndef MIDI_CLOCK_SYNC
+#define MIDI_CLOCK_SYNC 1
+#endif
+
+// 1: a Program Change recalls a preset of control values, applied in one pass with a single publish and LFO retarget
+// 0: Program Change is only indicated on the MIDI LED
+#ifndef PROGRAM_CHANGE_PRESETS
+#define PROGRAM_CHANGE_PRESETS 1
+#endif
+
+// 1: TimerInterrupt(), loop() and the time from a control change to the PWM compares are timed on the cycle counter,
+//    for a SysEx TraceRequest or, in the USB serial build, a report every TraceReportMs
+// 0: no probes are compiled in
+#ifndef TRACE_PROBES
+#define TRACE_PROBES 0
+#endif
 
 enum class MidiStatus
 {
@@ -31,6 +98,11 @@ enum class MidiCC : uint8_t
   Volume = 7,
   Expression = 11,
   VoiceMode = 70,
+  CompressorRelease = 72,
+  CompressorAttack = 73,
+  CompressorThreshold = 74,
+  CompressorAmount = 75,
+  ClockDivision = 76,
   AutopanWidth = 91,
   Tremolo = 92,
   Vibrato = 93,
@@ -38,6 +110,33 @@ enum class MidiCC : uint8_t
   Phaser = 95,
 };
 
+// The controls saved with the settings, in the order they are stored and applied at power-on
+inline constexpr MidiCC SavedControls[] = {
+    MidiCC::Rate,
+    MidiCC::RampTime,
+    MidiCC::Volume,
+    MidiCC::Expression,
+    MidiCC::VoiceMode,
+    MidiCC::AutopanWidth,
+    MidiCC::Tremolo,
+    MidiCC::Vibrato,
+    MidiCC::RotaryPhase,
+    MidiCC::Phaser,
+    MidiCC::CompressorRelease,
+    MidiCC::CompressorAttack,
+    MidiCC::CompressorThreshold,
+    MidiCC::CompressorAmount,
+    MidiCC::ClockDivision,
+};
+inline constexpr int SavedControlCount = sizeof(SavedControls) / sizeof(SavedControls[0]);
+
+struct Settings
+{
+  uint8_t controls[SavedControlCount]; // MIDI values of SavedControls
+};
+
+inline constexpr Settings DefaultSettings = {{24, 75, 100, 100, 0, 32, 127, 127, 0, 0, 64, 32, 96, 0, 0}};
+
 enum class VoiceMode : uint8_t
 {
   Vibrato = 0,
@@ -55,17 +154,26 @@ enum class PwmOut
   V1,
   V2,
   V3,
-  OscCount = V3,
-  Dry,
+  OscCount,
+  Dry = OscCount,
   Count
 };
 
 inline constexpr int OscCount = (int)PwmOut::OscCount;
 inline constexpr int PwmOutCount = (int)PwmOut::Count;
 
+// The beat the LFO is locked to while it follows the MIDI clock
+struct ClockSync
+{
+  bool locked = false;
+  uint32_t time = 0;       // micros() of the latest tick, as filtered by the PLL
+  uint32_t phase = 0;      // LFO phase due at that tick
+  uint32_t phasePerUs = 0; // LFO phase advance per us, Q8
+};
+
 struct State
 {
-  float rate = 0;
+  uint32_t rate = 0; // Hz, unsigned Q16.16
   uint32_t rampTimeMs = 0;
   uint32_t stereoDelta = 0;
   uint32_t syncDelta = 0;
@@ -73,16 +181,33 @@ struct State
   uint16_t vibratoDepth = 0;
   uint32_t volume = 0xffff;
   uint32_t expression = 0xffff;
-  uint32_t dryLevel = 0x0;
-  uint32_t dryMul = 0x0;
+  uint32_t dryLevel = 0x0; // Phaser control, Q16
+  uint32_t dryMul = 0x0; // dryLevel with volume, expression and compressorGain applied, as the Dry output
   VoiceMode voiceMode = VoiceMode::Vibrato;
   bool bypass = false;
-  uint32_t oscMul[OscCount];
-  uint32_t oscOffset[OscCount];
+  OutputGain osc[OscCount] = {};
+  uint32_t lfoDelta = 0;
+  uint32_t lfoOffset[OscCount] = {};
+  uint32_t lfoRetarget = 0; // bumped whenever the LFO should ramp to lfoDelta/lfoOffset
+  CompressorParams compressor;
+  uint16_t compressorGain = Compressor::Unity; // applied with volume and expression, Q16
+  uint8_t clockTicks = 0; // MIDI clock ticks per LFO cycle, 0 to run free at `rate`
+  ClockSync clock;
+};
+
+// The control values alone: what is derived from them takes a table lookup or a few multiplies, so a recall rebuilds
+// the state in one pass rather than storing it
+struct Preset
+{
+  Settings settings;
 };
 
-uint32_t PhaseOffset2 = 1431655765;
-uint32_t PhaseOffset3 = 2863311531;
+// Version of the Preset layout, in the header of every SysEx message and preset slot, so that presets of another
+// layout are refused rather than misread. Any change to Settings or SavedControls has to bump it.
+constexpr uint8_t PresetFormat = 1;
+
+inline constexpr uint32_t PhaseOffset2 = 1431655765;
+inline constexpr uint32_t PhaseOffset3 = 2863311531;
 
 struct Pwm
 {
@@ -120,11 +245,88 @@ constexpr int PinDisplaySda = PB7;
 
 constexpr int PinStatusLed = PC13;
 
+// Settings log in the last 4 KB of a 64 KB STM32F103C8, saved this long after the last change
+constexpr int SettingsFirstPage = 60;
+constexpr int SettingsPageCount = 4;
+constexpr uint32_t SettingsSaveDelayMs = 2000;
+
+// One preset per MIDI program, in the pages just below the settings log (4 KB). InternalFlash refuses to write any page
+// the sketch's image reaches into, so the sketch has the 56 KB below
+constexpr int PresetCount = 128;
+constexpr int PresetPageCount = PresetBank<Preset>::pagesFor(PresetCount, InternalFlash::PageSize);
+constexpr int PresetFirstPage = SettingsFirstPage - PresetPageCount;
+static_assert(PresetPageCount <= 4, "the preset bank takes more flash than the sketch can spare");
+
+enum class TraceProbe
+{
+  Interrupt,     // TimerInterrupt(), from entry to the compares being written
+  Loop,          // one loop()
+  ControlToPwm,  // a control change parsed to the first compares written with it, which the timers load at their
+                 // next update event
+  Controls,      // one applyControlChanges() that applied anything, to its State published
+  Count,
+};
+inline constexpr const char* TraceProbeNames[] = {"interrupt", "loop", "cc to pwm", "controls"};
+inline constexpr int TraceProbeCount = (int)TraceProbe::Count;
+
+// Sent as it is in reply to a SysEx TraceRequest
+struct TraceReport
+{
+  uint32_t overruns = 0; // TimerInterrupt() calls that took longer than InterruptDeadline
+  TraceStats probes[TraceProbeCount];
+};
+
+// One SysEx conversation per MIDI port: the message being received and the reply being sent
+constexpr uint32_t SysExReplyPayload = TRACE_PROBES && sizeof(TraceReport) > sizeof(Preset) ? sizeof(TraceReport)
+                                                                                            : sizeof(Preset);
+struct SysExPort
+{
+  SysExReader<sizeof(Preset)> reader;
+  uint8_t reply[SysEx::messageSize(SysExReplyPayload)];
+  uint16_t replyLength = 0;
+  uint16_t replySent = 0;
+  int bankDump = -1; // next preset of a bank dump in progress
+  int bankDumpCount = 0;
+};
+
 constexpr uint16 PwmBits = 12;
 constexpr uint16 PwmPrecision = 1 << PwmBits;
 constexpr uint16 PwmMax = PwmPrecision - 1;
 constexpr int DownSample = 35;
 constexpr float SampleRate = static_cast<float>(F_CPU) / PwmPrecision / DownSample;
+// PWM periods between TimerInterrupt() calls, set by TIMER1's repetition counter with SAMPLE_RATE_TIMER
+constexpr int InterruptPeriods = SAMPLE_RATE_TIMER && !PWM_DITHER ? DownSample : 1;
+// TimerInterrupt() has to be done before the next update event
+constexpr uint32_t InterruptDeadline = (PwmPrecision + 1) * InterruptPeriods;
+constexpr uint32_t TraceReportMs = 5000;
+
+// The analog inputs are scanned on every TIMER3 update, once per PWM period (~17.6 kHz), into a ring of AnalogFrames
+// frames. loop() takes them a block of AnalogBlock frames at a time: one control sample for the compressor (~1.1 kHz),
+// and a quarter of a pot reading, which averages 2^PotOversampleBits frames (~275 Hz)
+inline constexpr uint8_t AnalogPins[] = {PinEnvelope, PinRate, PinTremolo, PinVibrato};
+inline constexpr int AnalogPinCount = sizeof(AnalogPins) / sizeof(AnalogPins[0]);
+constexpr int AnalogEnvelope = 0; // indices in AnalogPins
+constexpr int AnalogRate = 1;
+constexpr int AnalogTremolo = 2;
+constexpr int AnalogVibrato = 3;
+constexpr int AnalogFrames = 128;
+constexpr uint32_t AnalogSampleRate = F_CPU / (PwmPrecision + 1);
+constexpr int AnalogBlock = 16;
+constexpr uint32_t CompressorRate = AnalogSampleRate / AnalogBlock;
+constexpr int PotOversampleBits = 6;
+static_assert(AnalogFrames % AnalogBlock == 0, "blocks do not straddle the end of the ring");
+
+// The pots and the controls they turn
+inline constexpr uint8_t PotChannels[] = {AnalogRate, AnalogTremolo, AnalogVibrato};
+inline constexpr MidiCC PotControls[] = {MidiCC::Rate, MidiCC::Tremolo, MidiCC::Vibrato};
+inline constexpr int PotCount = sizeof(PotChannels) / sizeof(PotChannels[0]);
+
+// While the LFO follows the MIDI clock its phase is moved a sixteenth of the way to the beat every sample, by at most
+// 1/4096 of a cycle, so that it never runs more than 0.12 Hz off the clock's rate
+constexpr int32_t ClockMaxNudge = 1 << 20;
+
+// Of the PWM timers only TIMER1 (advanced) has a repetition counter
+inline timer_dev* const SampleTimer = TIMER1;
 
 #if USB_SERIAL_LOGGING
 inline USBCompositeSerial CompositeSerial;
@@ -132,14 +334,39 @@ inline USBCompositeSerial CompositeSerial;
 inline MidiController midi;
 #endif
 
-// inline PotController RatePit(PinRate);
-// inline PotController TremoloPot(PinTremolo);
-// inline PotController VibratoPot(PinVibrato);
 #if OLED_DISPLAY
 inline OledDisplay display(PinDisplayScl, PinDisplaySda);
+inline StatusRenderer status(display);
 #endif
-inline WaveTable<9> lfo(SampleRate, 1);
+inline WaveTable<OscCount> lfo(SampleRate, 1);
+inline PwmDither<PwmOutCount, 16 - PwmBits> pwmDither;
 inline MidiStatus midiIndicator = MidiStatus::Idle;
 inline uint32_t midiIndicatorChanged = 0;
-inline State state = {};
+inline State state = {}; // owned by loop(), handed to TimerInterrupt() through stateBuffer
+inline StateBuffer<State> stateBuffer;
+inline ControlChangeTable controlChanges;
 inline bool displayRealtimeChanges = false;
+inline Settings settings = DefaultSettings; // as last applied
+inline bool settingsChanged = false;
+inline uint32_t settingsChangedAt = 0;
+inline InternalFlash settingsFlash(SettingsFirstPage, SettingsPageCount);
+inline RecordLog<Settings> settingsLog(settingsFlash);
+inline InternalFlash presetFlash(PresetFirstPage, PresetPageCount);
+inline PresetBank<Preset> presets(presetFlash, PresetCount, PresetFormat);
+inline SysExPort usbSysEx;
+inline SysExPort dinSysEx;
+inline uint16_t analogSamples[AnalogFrames * AnalogPinCount];
+inline AnalogDma analogDma(AnalogPins, AnalogPinCount, analogSamples, AnalogFrames);
+inline Compressor compressor;
+inline int analogFrame = 0; // first frame of the next block loop() takes from the ring
+inline ClockPll midiClock;
+inline uint32_t clockRate = 0; // Hz, unsigned Q16.16, of the LFO while it follows the clock
+inline PotFilter<PotCount, PotOversampleBits> pots(PotChannels, AnalogPinCount);
+#if TRACE_PROBES
+inline TraceReport trace;
+inline uint32_t traceControlParsed = 0;                 // cycles at the first control change not yet published
+inline bool traceControlPending = false;
+inline std::atomic<uint32_t> traceControlPublished{0}; // cycles at the first control change of the latest publish
+inline uint32_t traceControlSampled = 0;                // traceControlPublished as of the sample being output
+inline uint32_t traceReportedAt = 0;
+#endif
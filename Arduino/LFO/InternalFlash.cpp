@@ -0,0 +1,42 @@
+#include "InternalFlash.h"
+#include <flash_stm32.h>
+#include <string.h>
+
+// Set by libmaple's linker scripts for start_c(): the image ends with the .rodata section, whose last word,
+// _lm_rom_img_cfgp, holds the load address of the .data initializers
+extern "C" char _lm_rom_img_cfgp;
+extern "C" char __data_start__, __data_end__;
+
+int InternalFlash::firstFreePage() {
+  uint32_t rodataEnd = reinterpret_cast<uint32_t>(&_lm_rom_img_cfgp) + 4;
+  uint32_t dataEnd = *reinterpret_cast<const uint32_t*>(&_lm_rom_img_cfgp) + (&__data_end__ - &__data_start__);
+  uint32_t end = rodataEnd > dataEnd ? rodataEnd : dataEnd;
+  return (end - BaseAddress + PageSize - 1) / PageSize;
+}
+
+void InternalFlash::read(int page, uint32_t offset, void* data, uint32_t bytes) {
+  memcpy(data, reinterpret_cast<const void*>(address(page, offset)), bytes);
+}
+
+bool InternalFlash::erasePage(int page) {
+  if (!writable(page)) {
+    return false;
+  }
+  FLASH_Unlock();
+  FLASH_Status status = FLASH_ErasePage(address(page, 0));
+  FLASH_Lock();
+  return status == FLASH_COMPLETE;
+}
+
+bool InternalFlash::program(int page, uint32_t offset, const uint16_t* data, uint32_t count) {
+  if (!writable(page)) {
+    return false;
+  }
+  FLASH_Status status = FLASH_COMPLETE;
+  FLASH_Unlock();
+  for (uint32_t i = 0; i < count && status == FLASH_COMPLETE; i++) {
+    status = FLASH_ProgramHalfWord(address(page, offset + 2 * i), data[i]);
+  }
+  FLASH_Lock();
+  return status == FLASH_COMPLETE;
+}
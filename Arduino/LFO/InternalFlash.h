@@ -0,0 +1,41 @@
+/**
+ * @file InternalFlash.h
+ * @author Gino Bollaert
+ * @brief A range of pages of the STM32F103's own flash
+ * @details InternalFlash.cpp programs the pages through the flash controller. The host build links
+ * sim/hal/InternalFlash.cpp instead, which keeps them in the simulator's file-backed flash. Either refuses to erase or
+ * program a page below firstFreePage(), so a sketch that has grown into the pages kept for data loses its saves
+ * rather than its code.
+ * @date 2023-06-26
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include "FlashDevice.h"
+
+class InternalFlash : public FlashDevice
+{
+public:
+  static constexpr uint32_t BaseAddress = 0x08000000;
+  static constexpr uint32_t PageSize = 1024; // medium-density STM32F103
+
+  InternalFlash(int firstPage, int pageCount) : _firstPage(firstPage), _pageCount(pageCount) {}
+
+  /** First page past the sketch's own image */
+  static int firstFreePage();
+
+  uint32_t pageSize() const override { return PageSize; }
+  int pageCount() const override { return _pageCount; }
+
+  void read(int page, uint32_t offset, void* data, uint32_t bytes) override;
+  bool erasePage(int page) override;
+  bool program(int page, uint32_t offset, const uint16_t* data, uint32_t count) override;
+
+private:
+  bool writable(int page) const { return _firstPage + page >= firstFreePage(); }
+  uint32_t address(int page, uint32_t offset) const { return BaseAddress + (_firstPage + page) * PageSize + offset; }
+
+  int _firstPage;
+  int _pageCount;
+};
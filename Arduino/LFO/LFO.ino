@@ -10,10 +10,9 @@
 #include "Globals.h"
 
 const char* kNotes[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+const char* kDivisions[] = {"Off", "1", "1/2", "1/4", "1/8.", "1/8", "1/8T", "1/16"};
 
 int channel = 0;
-int pot1Control = 81;
-int pot2Control = 82;
 
 // volatile float freq = 1;
 
@@ -40,7 +39,17 @@ void handleControlChange(unsigned int channel, unsigned int controller, unsigned
     return;
   }
   setMidiStatus(MidiStatus::Receiving);
-  handleControlValue((MidiCC)controller, value);
+  controlChanges.set(controller, value);
+#if TRACE_PROBES
+  if (!traceControlPending)
+  {
+    traceControlParsed = traceCycles();
+    traceControlPending = true;
+  }
+#endif
+#if !CC_COALESCING
+  applyControlChanges();
+#endif
 }
 
 void handleProgramChange(unsigned int channel, unsigned int program)
@@ -50,24 +59,222 @@ void handleProgramChange(unsigned int channel, unsigned int program)
   String s = String() + "Received Program Change " + String(program) + " [Ch:" + String(channel + 1) + "]\n";
   CompositeSerial.write(s.c_str());
 #endif
+#if PROGRAM_CHANGE_PRESETS
+  if (channel == 0)
+  {
+    recallPreset(program);
+  }
+#endif
+}
+
+// Clock ticks are stamped when loop() parses them, so the PLL has to filter out loop()'s latency as well as the
+// sender's jitter
+void handleClock()
+{
+#if MIDI_CLOCK_SYNC
+  midiClock.tick(micros());
+  if (updateClockSync())
+  {
+    stateBuffer.publish(state);
+  }
+#endif
 }
 
-void handleSysExData(unsigned char data)
+void handleStart()
+{
+#if MIDI_CLOCK_SYNC
+  midiClock.start();
+#endif
+}
+
+// The LFO runs free again once the clock has stopped
+void checkClockTimeout()
+{
+#if MIDI_CLOCK_SYNC
+  if (midiClock.timedOut(micros()))
+  {
+    midiClock.reset();
+    if (updateClockSync())
+    {
+      stateBuffer.publish(state);
+    }
+  }
+#endif
+}
+
+void handleSysExData(SysExPort& port, unsigned char data)
 {
   setMidiStatus(MidiStatus::Receiving);
 #if USB_SERIAL_LOGGING
   String s = String() + "Received SysEx byte: 0x" + String(data, 16) + "\n";
   CompositeSerial.write(s.c_str());
 #endif
+  port.reader.push(data);
 }
 
-void handleSysExEnd()
+void handleSysExEnd(SysExPort& port)
 {
   setMidiStatus(MidiStatus::Receiving);
 #if USB_SERIAL_LOGGING
   String s = String() + "End of SysEx\n";
   CompositeSerial.write(s.c_str());
 #endif
+  if (port.reader.end())
+  {
+    handleSysExMessage(port);
+  }
+}
+
+void handleUsbSysExData(unsigned char data) { handleSysExData(usbSysEx, data); }
+void handleUsbSysExEnd() { handleSysExEnd(usbSysEx); }
+
+void setSysExReply(SysExPort& port, SysEx::Command command, uint8_t index, const void* payload, uint32_t bytes)
+{
+  SysExWriter writer(port.reply, PresetFormat, command, index);
+  writer.write(payload, bytes);
+  port.replyLength = writer.finish();
+  port.replySent = 0;
+}
+
+// Senders wait for the reply to one message before sending the next, so a message that arrives while a reply is
+// still going out is dropped. Loads are acknowledged once applied or stored: a flash write holds the CPU for longer
+// than the DIN input can buffer. A load of another PresetFormat or size is refused; the controls it carries are
+// applied through applyControlValue() like any others, so no byte of it lands in the state as it is.
+void handleSysExMessage(SysExPort& port)
+{
+  if (port.replySent < port.replyLength || port.bankDump >= 0)
+  {
+    return;
+  }
+  const auto& message = port.reader;
+  Preset preset;
+  switch (message.command())
+  {
+    case SysEx::Command::StateRequest:
+      applyControlChanges();
+      preset.settings = settings;
+      setSysExReply(port, SysEx::Command::State, 0, &preset, sizeof(preset));
+      break;
+    case SysEx::Command::PresetRequest:
+      if (presets.read(message.index(), preset))
+      {
+        setSysExReply(port, SysEx::Command::Preset, message.index(), &preset, sizeof(preset));
+      }
+      else
+      {
+        setSysExReply(port, SysEx::Command::Nak, message.index(), nullptr, 0);
+      }
+      break;
+    case SysEx::Command::BankRequest:
+      port.bankDump = 0;
+      port.bankDumpCount = 0;
+      break;
+#if TRACE_PROBES
+    case SysEx::Command::TraceRequest:
+    {
+      TraceReport report = readTrace(message.index() == 1);
+      setSysExReply(port, SysEx::Command::Trace, 0, &report, sizeof(report));
+      break;
+    }
+#endif
+    case SysEx::Command::State:
+    {
+      bool applied = message.format() == PresetFormat && message.size() == sizeof(Preset);
+      if (applied)
+      {
+        memcpy(&preset, message.payload(), sizeof(Preset));
+        applyPreset(preset);
+      }
+      setSysExReply(port, applied ? SysEx::Command::Ack : SysEx::Command::Nak, 0, nullptr, 0);
+      break;
+    }
+    case SysEx::Command::Preset:
+    {
+      bool stored = message.format() == PresetFormat && message.size() == sizeof(Preset);
+      if (stored)
+      {
+        memcpy(&preset, message.payload(), sizeof(Preset));
+        stored = presets.write(message.index(), preset);
+      }
+      setSysExReply(port, stored ? SysEx::Command::Ack : SysEx::Command::Nak, message.index(), nullptr, 0);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+// A bank dump is one message per stored preset, each prepared once the previous one has been sent
+void continueBankDump(SysExPort& port)
+{
+  while (port.bankDump >= 0 && port.replySent == port.replyLength)
+  {
+    Preset preset;
+    if (port.bankDump == presets.count())
+    {
+      uint8_t count = port.bankDumpCount;
+      setSysExReply(port, SysEx::Command::BankEnd, 0, &count, sizeof(count));
+      port.bankDump = -1;
+    }
+    else if (presets.read(port.bankDump++, preset))
+    {
+      setSysExReply(port, SysEx::Command::Preset, port.bankDump - 1, &preset, sizeof(preset));
+      port.bankDumpCount++;
+    }
+  }
+}
+
+// Called from loop(): USB takes a whole message at once, DIN only the bytes the UART can buffer without waiting
+void sendSysExReplies()
+{
+#if !USB_SERIAL_LOGGING
+  continueBankDump(usbSysEx);
+  if (usbSysEx.replySent < usbSysEx.replyLength)
+  {
+    midi.sendSysEx(usbSysEx.reply, usbSysEx.replyLength);
+    usbSysEx.replySent = usbSysEx.replyLength;
+  }
+#endif
+  continueBankDump(dinSysEx);
+  dinSysEx.replySent +=
+      usart_tx(Serial3.c_dev(), dinSysEx.reply + dinSysEx.replySent, dinSysEx.replyLength - dinSysEx.replySent);
+}
+
+// DIN MIDI, parsed with the same channel filter as USB
+struct DinMidiHandler : MidiParserHandler
+{
+  static bool CheckChannel(uint8_t channel) { return channel == 0; }
+  static void ControlChange(uint8_t channel, uint8_t controller, uint8_t value)
+  {
+    handleControlChange(channel, controller, value);
+  }
+  static void ProgramChange(uint8_t channel, uint8_t program) { handleProgramChange(channel, program); }
+  static void SysExStart() { dinSysEx.reader.reset(); }
+  static void SysExByte(uint8_t byte) { handleSysExData(dinSysEx, byte); }
+  static void SysExEnd() { handleSysExEnd(dinSysEx); }
+  static void Clock() { handleClock(); }
+  static void Start() { handleStart(); }
+};
+
+stmlib_midi::MidiStreamParser<DinMidiHandler> dinMidi;
+
+void receiveDinMidi()
+{
+  // One pass over what the UART has buffered so far; anything arriving meanwhile waits for the next loop()
+  uint8_t buffer[64];
+  int count = Serial3.available();
+  if (count > (int)sizeof(buffer))
+  {
+    count = sizeof(buffer);
+  }
+  for (int i = 0; i < count; i++)
+  {
+    buffer[i] = Serial3.read();
+  }
+  for (int i = 0; i < count; i++)
+  {
+    dinMidi.PushByte(buffer[i]);
+  }
 }
 
 void setupUsb()
@@ -83,7 +290,8 @@ void setupUsb()
   midi.registerComponent();
   midi.setControlChangeCallback(handleControlChange);
   midi.setProgramChangeCallback(handleProgramChange);
-  midi.setSysExCallbacks(handleSysExData, handleSysExEnd);
+  midi.setSysExCallbacks(handleUsbSysExData, handleUsbSysExEnd);
+  midi.setClockCallbacks(handleClock, handleStart);
 #endif
   USBComposite.begin();
 #if USB_SERIAL_LOGGING
@@ -94,6 +302,12 @@ void setupUsb()
 
 void setupPwms()
 {
+  pwmDither.reset();
+#if PWM_DITHER
+  // TIMER1's update event is its trigger output, and that resets the other PWM timers, so every output starts its
+  // period and loads its compare value together, as pwmDither's averaging over consecutive periods assumes
+  SampleTimer->regs.adv->CR2 = (SampleTimer->regs.adv->CR2 & ~TIMER_CR2_MMS) | TIMER_CR2_MMS_UPDATE;
+#endif
   for (int i = 0; i < PwmOutCount; i++)
   {
     pinMode(Pwms[i].pin, PWM);
@@ -104,11 +318,33 @@ void setupPwms()
     timer_set_prescaler(Pwms[i].timer, 0);
     timer_set_reload(Pwms[i].timer, PwmPrecision);
     timer_cc_enable(Pwms[i].timer, Pwms[i].channel);
+#if PWM_DITHER
+    if (Pwms[i].timer != SampleTimer)
+    {
+      // ITR0 is TIMER1's trigger output for TIMER2 to TIMER4
+      Pwms[i].timer->regs.gen->SMCR = TIMER_SMCR_TS_ITR0 | TIMER_SMCR_SMS_RESET;
+    }
+#endif
+#if SAMPLE_RATE_TIMER
+    if (Pwms[i].timer == SampleTimer)
+    {
+      // Update events (and compare preloads) now happen once per InterruptPeriods periods; with PWM_DITHER they also
+      // reset the other timers, which otherwise run free
+      SampleTimer->regs.adv->RCR = InterruptPeriods - 1;
+      timer_generate_update(Pwms[i].timer);
+      timer_attach_interrupt(Pwms[i].timer, TIMER_UPDATE_INTERRUPT, &TimerInterrupt);
+    }
+    else
+    {
+      timer_generate_update(Pwms[i].timer);
+    }
+#else
     timer_generate_update(Pwms[i].timer);
     if (i == 0)
     {
       timer_attach_interrupt(Pwms[i].timer, TIMER_UPDATE_INTERRUPT, &TimerInterrupt);
     }
+#endif
     timer_resume(Pwms[i].timer);
   }
 }
@@ -125,42 +361,80 @@ void updateVoiceMode()
 
 void updateVibratoDepth()
 {
-  for (int n = (int)PwmOut::V1; n < (int)PwmOut::V3; n++)
+  for (int n = (int)PwmOut::V1; n <= (int)PwmOut::V3; n++)
   {
-    state.oscMul[n] = state.vibratoDepth;
-    state.oscOffset[n] = 0xffff - state.oscMul[n];
+    state.osc[n].mul = state.vibratoDepth;
+    state.osc[n].offset = 0xffff - state.osc[n].mul;
   }
 }
 
 void updateLevelsAndTremoloDepth()
 {
-  uint32_t v = (state.volume * state.expression) >> 16;
-  for (int n = (int)PwmOut::L1; n < (int)PwmOut::R3; n++)
+  uint32_t v = (((state.volume * state.expression) >> 16) * state.compressorGain) >> 16;
+  for (int n = (int)PwmOut::L1; n <= (int)PwmOut::R3; n++)
   {
-    state.oscMul[n] = (state.tremoloDepth * v) >> 16;
-    state.oscOffset[n] = (v - state.oscMul[n]) >> 1;
+    state.osc[n].mul = (state.tremoloDepth * v) >> 16;
+    state.osc[n].offset = (v - state.osc[n].mul) >> 1;
   }
 }
 
 void updateDryLevel()
 {
-  uint32_t v = (state.volume * state.expression) >> 16;
+  uint32_t v = (((state.volume * state.expression) >> 16) * state.compressorGain) >> 16;
   state.dryMul = (v * state.dryLevel) >> 16;
 }
 
 void updateLfoRate()
 {
-  lfo.rampFrequency(state.rate, state.rampTimeMs);
+  state.lfoDelta = lfo.phaseDeltaQ16(state.clock.locked ? clockRate : state.rate);
+  state.lfoRetarget++;
+}
+
+// Locks the LFO to the MIDI clock while a division is chosen and the PLL has locked, and hands TimerInterrupt() the
+// beat of the latest tick. The rate is only retargeted when the clock's tempo has moved by more than 1/256, as the
+// interrupt does not pull the phase while ramping. Returns true if the state has changed.
+bool updateClockSync()
+{
+#if MIDI_CLOCK_SYNC
+  bool locked = state.clockTicks != 0 && midiClock.locked();
+  bool changed = locked != state.clock.locked;
+  state.clock.locked = locked;
+  if (!locked)
+  {
+    if (changed)
+    {
+      updateLfoRate();
+    }
+    return changed;
+  }
+  state.clock.time = midiClock.time();
+  state.clock.phase = midiClock.phase(state.clockTicks);
+  state.clock.phasePerUs = midiClock.phasePerUs(state.clockTicks);
+  uint32_t rate = midiClock.rate(state.clockTicks);
+  uint32_t drift = rate > clockRate ? rate - clockRate : clockRate - rate;
+  if (changed || drift > clockRate >> 8)
+  {
+    clockRate = rate;
+    updateLfoRate();
+  }
+  return true;
+#else
+  return false;
+#endif
 }
 
 void updateLfoPhases()
 {
-  lfo.rampPhaseOffset(state.syncDelta - state.stereoDelta, state.rampTimeMs, (int)PwmOut::L1);
-  lfo.rampPhaseOffset(state.syncDelta + state.stereoDelta, state.rampTimeMs, (int)PwmOut::R1);
-  lfo.rampPhaseOffset(PhaseOffset2 + state.syncDelta - state.stereoDelta, state.rampTimeMs, (int)PwmOut::L2);
-  lfo.rampPhaseOffset(PhaseOffset2 + state.syncDelta + state.stereoDelta, state.rampTimeMs, (int)PwmOut::R2);
-  lfo.rampPhaseOffset(PhaseOffset3 + state.syncDelta - state.stereoDelta, state.rampTimeMs, (int)PwmOut::L3);
-  lfo.rampPhaseOffset(PhaseOffset3 + state.syncDelta + state.stereoDelta, state.rampTimeMs, (int)PwmOut::R3);
+  state.lfoOffset[(int)PwmOut::L1] = state.syncDelta - state.stereoDelta;
+  state.lfoOffset[(int)PwmOut::R1] = state.syncDelta + state.stereoDelta;
+  state.lfoOffset[(int)PwmOut::L2] = PhaseOffset2 + state.syncDelta - state.stereoDelta;
+  state.lfoOffset[(int)PwmOut::R2] = PhaseOffset2 + state.syncDelta + state.stereoDelta;
+  state.lfoOffset[(int)PwmOut::L3] = PhaseOffset3 + state.syncDelta - state.stereoDelta;
+  state.lfoOffset[(int)PwmOut::R3] = PhaseOffset3 + state.syncDelta + state.stereoDelta;
+  state.lfoOffset[(int)PwmOut::V1] = 0;
+  state.lfoOffset[(int)PwmOut::V2] = PhaseOffset2;
+  state.lfoOffset[(int)PwmOut::V3] = PhaseOffset3;
+  state.lfoRetarget++;
 }
 
 void updateRampTime()
@@ -172,28 +446,28 @@ void updateRampTime()
 void initState()
 {
   updateBypass();
-  handleControlValue(MidiCC::Rate, 24);
-  handleControlValue(MidiCC::RampTime, 75);
-  handleControlValue(MidiCC::Volume, 100);
-  handleControlValue(MidiCC::Expression, 100);
-  handleControlValue(MidiCC::VoiceMode, 0);
-  handleControlValue(MidiCC::AutopanWidth, 32);
-  handleControlValue(MidiCC::Tremolo, 127);
-  handleControlValue(MidiCC::Vibrato, 127);
-  handleControlValue(MidiCC::RotaryPhase, 0);
-  handleControlValue(MidiCC::Phaser, 0);
-  lfo.setPhaseOffset(0, (int)PwmOut::V1);
-  lfo.setPhaseOffset(PhaseOffset2, (int)PwmOut::V2);
-  lfo.setPhaseOffset(PhaseOffset3, (int)PwmOut::V3);
-  lfo.setFrequency(lfo.frequency());
-  for (int n = 0; n < OscCount; n++)
-  {
-    lfo.setPhaseOffset(lfo.phaseOffset(n), n);
+  settings = DefaultSettings;
+#if SETTINGS_PERSISTENCE
+  settingsLog.restore(settings);
+#endif
+  settingsChanged = false;
+  // The compressor starts from silence, at unity gain
+  compressor = Compressor();
+  state.compressorGain = compressor.gain();
+  for (int i = 0; i < SavedControlCount; i++)
+  {
+    applyControlValue(SavedControls[i], settings.controls[i] & 0x7f);
   }
+  stateBuffer.publish(state);
+  // The timer interrupt is not running yet, so start the LFO on its targets rather than ramping to them
+  lfo.setPhases(state.lfoDelta, state.lfoOffset);
 }
 
 void setup()
 {
+#if TRACE_PROBES
+  traceBegin();
+#endif
   pinMode(PinStatusLed, OUTPUT);
   pinMode(PinVoice, OUTPUT);
   pinMode(PinBypass, OUTPUT);
@@ -202,35 +476,94 @@ void setup()
 
   initState();
   setupPwms();
+  analogDma.begin();
+  analogFrame = 0;
+  pots.reset();
+  midiClock.reset();
 
   delay(200);
   setupUsb();
 
 #if OLED_DISPLAY
   display.init();
-  display.clear();
-  display.drawString(0, 0, "MIDI Controller");
-  display.show();
+  // InternalFlash will not write over the image, so presets and settings cannot be saved once it reaches their pages
+  status.set("MIDI Controller", InternalFlash::firstFreePage() > PresetFirstPage ? "Flash full: no saving" : "");
   displayRealtimeChanges = true;
 #endif
 }
 
+// Takes the latest state for the next sample: the LFO ramps to new targets and is kept on the MIDI clock's beat
+const State& acquireSample()
+{
+#if TRACE_PROBES
+  // Read before the state, as loop() writes it after publishing, so that it is never ahead of the state
+  traceControlSampled = traceControlPublished.load(std::memory_order_acquire);
+#endif
+  static uint32_t lfoRetarget = 0;
+  const State& frame = stateBuffer.acquire();
+  if (frame.lfoRetarget != lfoRetarget)
+  {
+    lfo.rampPhases(frame.lfoDelta, frame.lfoOffset, frame.rampTimeMs);
+    lfoRetarget = frame.lfoRetarget;
+  }
+#if MIDI_CLOCK_SYNC
+  if (frame.clock.locked && !lfo.ramping())
+  {
+    // Pull the phase due after this sample a sixteenth of the way towards the clock's beat
+    int32_t since = (int32_t)(micros() - frame.clock.time);
+    uint32_t target = frame.clock.phase + (uint32_t)(((int64_t)since * frame.clock.phasePerUs) >> 8);
+    int32_t error = (int32_t)(target - (lfo.basePhase() + frame.lfoDelta)) >> 4;
+    lfo.nudgePhase(error > ClockMaxNudge ? ClockMaxNudge : error < -ClockMaxNudge ? -ClockMaxNudge : error);
+  }
+#endif
+  return frame;
+}
+
 void TimerInterrupt()
 {
+#if !SAMPLE_RATE_TIMER && !PWM_DITHER
   static int counter = 0;
-  if (counter % DownSample == 0)
+  if (counter++ % DownSample != 0)
   {
-    lfo.advance();
-    int n = 0;
-    for (; n <= (int)PwmOut::V3; n++)
-    {
-      auto v = ((lfo.sampleIP(n) * state.oscMul[n]) >> 16) + state.oscOffset[n];
-      timer_set_compare(Pwms[n].timer, Pwms[n].channel, v >> (16 - PwmBits));
-    }
-    n = (int)PwmOut::Dry;
-    timer_set_compare(Pwms[n].timer, Pwms[n].channel, state.dryLevel >> (16 - PwmBits));
+    return;
+  }
+#endif
+#if TRACE_PROBES
+  uint32_t traceStart = traceCycles();
+#endif
+  uint16_t compare[PwmOutCount];
+#if PWM_DITHER
+  // A new sample every DownSample periods; every period carries the bits the PWM cannot show over to the next
+  static int period = 0;
+  static uint16_t levels[PwmOutCount];
+  if (period == 0)
+  {
+    const State& frame = acquireSample();
+    lfo.renderFrame<0>(frame.osc, levels);
+    levels[(int)PwmOut::Dry] = frame.dryMul;
   }
-  counter++;
+  period = period + 1 == DownSample ? 0 : period + 1;
+  pwmDither.next(levels, compare);
+#else
+  const State& frame = acquireSample();
+  lfo.renderFrame<16 - PwmBits>(frame.osc, compare);
+  compare[(int)PwmOut::Dry] = frame.dryMul >> (16 - PwmBits);
+#endif
+  for (int n = 0; n < PwmOutCount; n++)
+  {
+    timer_set_compare(Pwms[n].timer, Pwms[n].channel, compare[n]);
+  }
+#if TRACE_PROBES
+  static uint32_t traceControlSeen = 0;
+  uint32_t traceEnd = traceCycles();
+  if (traceControlSampled != traceControlSeen)
+  {
+    trace.probes[(int)TraceProbe::ControlToPwm].record(traceEnd - traceControlSampled);
+    traceControlSeen = traceControlSampled;
+  }
+  trace.probes[(int)TraceProbe::Interrupt].record(traceEnd - traceStart);
+  trace.overruns += traceEnd - traceStart > InterruptDeadline;
+#endif
 }
 
 String noteName(int pitch) { return String() + kNotes[pitch % 12] + String(pitch / 12 - 1); }
@@ -246,10 +579,7 @@ void sendNoteOn(int chan, int pitch, int vel)
   s += "ch:" + String(chan + 1);
   s += " note:" + noteName(pitch);
   s += " vel:" + String(vel);
-  display.clear();
-  display.drawString(0, 0, "Note On");
-  display.drawString(0, 16, s.c_str());
-  display.show();
+  status.set("Note On", s.c_str());
 #endif
 }
 
@@ -259,76 +589,50 @@ void sendControlChange(int chan, int ctl, int val)
   midi.sendControlChange(chan, ctl, val);
 #endif
 #if OLED_DISPLAY
-  display.clear();
   String s;
   s += "ch:" + String(chan + 1);
   s += " ctl:" + String(ctl);
   s += " val:" + String(val);
-  display.drawString(0, 0, "Control Change");
-  display.drawString(0, 16, s.c_str());
-  display.show();
+  status.set("Control Change", s.c_str());
 #endif
 }
-
-void sendPot1Value()
-{
-  // sendControlChange(channel, pot1Control, TremoloPot.value());
-}
-
-void sendPot2Value()
-{
-  sendControlChange(channel, pot2Control, VibratoPot.value());
-  float v = static_cast<float>(VibratoPot.value()) / 127;
-  v = pow(2, v);
-  Lfo.rampFrequency(v * 880, 1000);
-}
 */
 
 void setRate(int val)
 {
-  float rate = val * 3.f / 127;
-  state.rate = rate + rate * rate * rate;
+  state.rate = RateCurve[val];
   updateLfoRate();
 #if OLED_DISPLAY
   if (!displayRealtimeChanges)
   {
     return;
   }
-  String oledStr;
-  oledStr += String((int)(state.rate * 60)) + " rpm";
-  display.clear();
-  display.drawString(0, 0, "Speed:");
-  display.drawString(0, 16, oledStr.c_str());
-  display.show();
+  DisplayText value;
+  value += RateRpmCurve[val];
+  value += " rpm";
+  status.set("Speed:", value.c_str());
 #endif
 }
 
 void setRampTime(int val)
 {
-  state.rampTimeMs = ((1001 * val) >> 7) + ((4071 * val * val) >> 14);
+  state.rampTimeMs = RampTimeCurve[val];
   updateRampTime();
 #if OLED_DISPLAY
   if (!displayRealtimeChanges)
   {
     return;
   }
-  String oledStr;
-  oledStr += String(state.rampTimeMs) + " ms";
-  display.clear();
-  display.drawString(0, 0, "Ramp Time:");
-  display.drawString(0, 16, oledStr.c_str());
-  display.show();
+  DisplayText value;
+  value += state.rampTimeMs;
+  value += " ms";
+  status.set("Ramp Time:", value.c_str());
 #endif
 }
 
-uint16_t volume(int val)
-{
-  return ((val * val) << 1) + val * 262;
-}
-
 void setVolume(int val)
 {
-  state.volume = volume(val);
+  state.volume = VolumeCurve[val];
   updateLevelsAndTremoloDepth();
   updateDryLevel();
 #if OLED_DISPLAY
@@ -336,18 +640,15 @@ void setVolume(int val)
   {
     return;
   }
-  String oledStr;
-  oledStr += String(val);
-  display.clear();
-  display.drawString(0, 0, "Volume:");
-  display.drawString(0, 16, oledStr.c_str());
-  display.show();
+  DisplayText value;
+  value += val;
+  status.set("Volume:", value.c_str());
 #endif
 }
 
 void setExpression(int val)
 {
-  state.expression = volume(val);
+  state.expression = VolumeCurve[val];
   updateLevelsAndTremoloDepth();
   updateDryLevel();
 #if OLED_DISPLAY
@@ -355,12 +656,9 @@ void setExpression(int val)
   {
     return;
   }
-  String oledStr;
-  oledStr += String(val);
-  display.clear();
-  display.drawString(0, 0, "Expression:");
-  display.drawString(0, 16, oledStr.c_str());
-  display.show();
+  DisplayText value;
+  value += val;
+  status.set("Expression:", value.c_str());
 #endif
 }
 
@@ -373,108 +671,164 @@ void setVoiceMode(int val)
   {
     return;
   }
-  display.clear();
-  display.drawString(0, 0, "Mode:");
-  display.drawString(0, 16, state.voiceMode == VoiceMode::Vibrato ? "Vibrato" : "Chorus");
-  display.show();
+  status.set("Mode:", state.voiceMode == VoiceMode::Vibrato ? "Vibrato" : "Chorus");
 #endif
 }
 
 void setAutopanWidth(int val)
 {
-  state.stereoDelta = val * 0x8000 / 128;
-  state.stereoDelta = state.stereoDelta << 16 + state.stereoDelta;
+  state.stereoDelta = AutopanWidthCurve[val];
   updateLfoPhases();
 #if OLED_DISPLAY
   if (!displayRealtimeChanges)
   {
     return;
   }
-  String oledStr;
-  int p = val * 200 / 128;
-  oledStr += String(p > 100 ? p - 200 : p) + "%";
-  display.clear();
-  display.drawString(0, 0, "Auto-pan Width:");
-  display.drawString(0, 16, oledStr.c_str());
-  display.show();
+  DisplayText value;
+  value += SignedPercentCurve[val];
+  value += "%";
+  status.set("Auto-pan Width:", value.c_str());
 #endif
 }
 
 void setRotaryPhase(int val)
 {
-  state.syncDelta = val * 0x10000 / 128;
-  state.syncDelta = state.syncDelta << 16 + state.syncDelta;
+  state.syncDelta = RotaryPhaseCurve[val];
   updateLfoPhases();
 #if OLED_DISPLAY
   if (!displayRealtimeChanges)
   {
     return;
   }
-  String oledStr;
-  int p = val * 200 / 128;
-  oledStr += String(p > 100 ? p - 200 : p) + "%";
-  display.clear();
-  display.drawString(0, 0, "Rotary Phase:");
-  display.drawString(0, 16, oledStr.c_str());
-  display.show();
+  DisplayText value;
+  value += SignedPercentCurve[val];
+  value += "%";
+  status.set("Rotary Phase:", value.c_str());
 #endif
 }
 
 void setTremolo(int val)
 {
-  state.tremoloDepth = (val << 9) + (val << 2);
+  state.tremoloDepth = DepthCurve[val];
   updateLevelsAndTremoloDepth();
 #if OLED_DISPLAY
   if (!displayRealtimeChanges)
   {
     return;
   }
-  String oledStr;
-  oledStr += String(val * 100 / 127) + "%";
-  display.clear();
-  display.drawString(0, 0, "Tremolo/Auto-pan:");
-  display.drawString(0, 16, oledStr.c_str());
-  display.show();
+  DisplayText value;
+  value += PercentCurve[val];
+  value += "%";
+  status.set("Tremolo/Auto-pan:", value.c_str());
 #endif
 }
 
 void setVibrato(int val)
 {
-  state.vibratoDepth = (val << 9) + (val << 2);
+  state.vibratoDepth = DepthCurve[val];
   updateVibratoDepth();
 #if OLED_DISPLAY
   if (!displayRealtimeChanges)
   {
     return;
   }
-  String oledStr;
-  oledStr += String(val * 100 / 127) + "%";
-  display.clear();
-  display.drawString(0, 0, "Vibrato/Chorus:");
-  display.drawString(0, 16, oledStr.c_str());
-  display.show();
+  DisplayText value;
+  value += PercentCurve[val];
+  value += "%";
+  status.set("Vibrato/Chorus:", value.c_str());
 #endif
 }
 
 void setPhaser(int val)
 {
-  state.dryLevel = (val << 9) + (val << 2);
+  state.dryLevel = DepthCurve[val];
   updateDryLevel();
 #if OLED_DISPLAY
   if (!displayRealtimeChanges)
   {
     return;
   }
-  String oledStr;
-  oledStr += String(val * 100 / 127) + "%";
-  display.clear();
-  display.drawString(0, 0, "Phaser:");
-  display.drawString(0, 16, oledStr.c_str());
-  display.show();
+  DisplayText value;
+  value += PercentCurve[val];
+  value += "%";
+  status.set("Phaser:", value.c_str());
 #endif
 }
 
-void handleControlValue(MidiCC cc, int val)
+void setCompressorRelease(int val)
+{
+  state.compressor.release = Compressor::coefficient(CompressorReleaseCurve[val], CompressorRate);
+#if OLED_DISPLAY
+  if (!displayRealtimeChanges)
+  {
+    return;
+  }
+  DisplayText value;
+  value += CompressorReleaseCurve[val];
+  value += " ms";
+  status.set("Comp. Release:", value.c_str());
+#endif
+}
+
+void setCompressorAttack(int val)
+{
+  state.compressor.attack = Compressor::coefficient(CompressorAttackCurve[val], CompressorRate);
+#if OLED_DISPLAY
+  if (!displayRealtimeChanges)
+  {
+    return;
+  }
+  DisplayText value;
+  value += CompressorAttackCurve[val];
+  value += " ms";
+  status.set("Comp. Attack:", value.c_str());
+#endif
+}
+
+void setCompressorThreshold(int val)
+{
+  state.compressor.threshold = CompressorThresholdCurve[val];
+#if OLED_DISPLAY
+  if (!displayRealtimeChanges)
+  {
+    return;
+  }
+  DisplayText value;
+  value += CompressorThresholdDbCurve[val];
+  value += " dB";
+  status.set("Comp. Threshold:", value.c_str());
+#endif
+}
+
+void setCompressorAmount(int val)
+{
+  state.compressor.amount = CompressorAmountCurve[val];
+#if OLED_DISPLAY
+  if (!displayRealtimeChanges)
+  {
+    return;
+  }
+  DisplayText value;
+  value += PercentCurve[val];
+  value += "%";
+  status.set("Comp. Amount:", value.c_str());
+#endif
+}
+
+void setClockDivision(int val)
+{
+  state.clockTicks = ClockDivisionCurve[val];
+  updateClockSync();
+#if OLED_DISPLAY
+  if (!displayRealtimeChanges)
+  {
+    return;
+  }
+  status.set("Clock Sync:", kDivisions[val >> 4]);
+#endif
+}
+
+void applyControlValue(MidiCC cc, int val)
 {
   switch (cc)
   {
@@ -483,58 +837,217 @@ void handleControlValue(MidiCC cc, int val)
     case MidiCC::Volume: setVolume(val); break;
     case MidiCC::Expression: setExpression(val); break;
     case MidiCC::VoiceMode: setVoiceMode(val); break;
+    case MidiCC::CompressorRelease: setCompressorRelease(val); break;
+    case MidiCC::CompressorAttack: setCompressorAttack(val); break;
+    case MidiCC::CompressorThreshold: setCompressorThreshold(val); break;
+    case MidiCC::CompressorAmount: setCompressorAmount(val); break;
+    case MidiCC::ClockDivision: setClockDivision(val); break;
     case MidiCC::AutopanWidth: setAutopanWidth(val); break;
     case MidiCC::Tremolo: setTremolo(val); break;
     case MidiCC::Vibrato: setVibrato(val); break;
     case MidiCC::RotaryPhase: setRotaryPhase(val); break;
     case MidiCC::Phaser: setPhaser(val); break;
   }
+  recordSetting(cc, val);
 }
 
-void receiveMidiByte(int byte)
+void recordSetting(MidiCC cc, int val)
 {
-  static bool expectCC = false;
-  static bool expectValue = false;
-  static MidiCC cc;
+  for (int i = 0; i < SavedControlCount; i++)
+  {
+    if (SavedControls[i] == cc && settings.controls[i] != val)
+    {
+      settings.controls[i] = val;
+      settingsChanged = true;
+      settingsChangedAt = millis();
+    }
+  }
+}
 
-  if (byte & 0x80)
+// Called from loop() rather than the MIDI handlers, and only once the settings have not changed for a while, so that
+// sweeping a control costs one flash write and no write stalls the handling of incoming MIDI
+void saveSettings()
+{
+#if SETTINGS_PERSISTENCE
+  if (settingsChanged && millis() - settingsChangedAt >= SettingsSaveDelayMs)
   {
-    expectCC = ((byte & 0xf0) == 0xb0);
-    expectValue = false;
-    return;
+    settingsChanged = false;
+    settingsLog.append(settings);
   }
+#endif
+}
 
-  if (expectCC)
+bool recallPreset(int program)
+{
+  Preset preset;
+  if (!presets.read(program, preset))
   {
-    setMidiStatus(MidiStatus::Receiving);
-    cc = (MidiCC)byte;
-    expectCC = false;
-    expectValue = true;
-    return;
+    return false;
+  }
+  applyPreset(preset);
+#if OLED_DISPLAY
+  if (displayRealtimeChanges)
+  {
+    DisplayText value;
+    value += program + 1;
+    status.set("Program:", value.c_str());
   }
+#endif
+  return true;
+}
 
-  if (expectValue)
+// Swaps in a preset: its controls are applied in one pass without status messages, then published with a single LFO
+// retarget, instead of each control change publishing and retargeting on its own
+void applyPreset(const Preset& preset)
+{
+  // Control changes received before the program change are all overridden by it
+  controlChanges.discard();
+#if TRACE_PROBES
+  traceControlPending = false;
+#endif
+  uint32_t lfoRetarget = state.lfoRetarget;
+  bool realtime = displayRealtimeChanges;
+  displayRealtimeChanges = false;
+  for (int i = 0; i < SavedControlCount; i++)
   {
-    handleControlValue(cc, byte);
-    expectValue = false;
-    expectCC = true;
+    applyControlValue(SavedControls[i], preset.settings.controls[i] & 0x7f);
   }
+  displayRealtimeChanges = realtime;
+  state.lfoRetarget = lfoRetarget + 1;
+  stateBuffer.publish(state);
 }
 
-void loop()
+// Stores the current settings as preset `program`
+bool storePreset(int program)
+{
+  applyControlChanges();
+  Preset preset;
+  preset.settings = settings;
+  return presets.write(program, preset);
+}
+
+void handleControlValue(MidiCC cc, int val)
 {
-  while (Serial3.available())
+  applyControlValue(cc, val);
+  stateBuffer.publish(state);
+}
+
+void applyControlChanges()
+{
+#if TRACE_PROBES
+  uint32_t traceStart = traceCycles();
+#endif
+  int applied = controlChanges.apply([](uint8_t controller, uint8_t value) {
+    applyControlValue((MidiCC)controller, value);
+  });
+  if (applied > 0)
   {
-    receiveMidiByte(Serial3.read());
+    stateBuffer.publish(state);
+#if TRACE_PROBES
+    if (traceControlPending)
+    {
+      traceControlPublished.store(traceControlParsed, std::memory_order_release);
+      traceControlPending = false;
+    }
+    trace.probes[(int)TraceProbe::Controls].record(traceCycles() - traceStart);
+#endif
   }
-  midi.poll();
-  updateMidiStatus();
-  /*
-  if (TremoloPot.update()) {
-    sendPot1Value();
+}
+
+#if TRACE_PROBES
+// A consistent copy of the probes, which TimerInterrupt() updates as well, cleared after it if `clear`
+TraceReport readTrace(bool clear)
+{
+  noInterrupts();
+  TraceReport report = trace;
+  if (clear)
+  {
+    trace = TraceReport();
   }
-  if (VibratoPot.update()) {
-    sendPot2Value();
+  interrupts();
+  return report;
+}
+
+// Every TraceReportMs, the probes since the last report as text on the USB serial port
+void reportTrace()
+{
+#if USB_SERIAL_LOGGING
+  if (millis() - traceReportedAt < TraceReportMs)
+  {
+    return;
+  }
+  traceReportedAt = millis();
+  TraceReport report = readTrace(true);
+  String s = String() + "Trace: " + String(report.overruns) + " interrupt overruns\n";
+  for (int i = 0; i < TraceProbeCount; i++)
+  {
+    const TraceStats& probe = report.probes[i];
+    s += String(TraceProbeNames[i]) + ": " + String(probe.count) + " min " + String(probe.count ? probe.min : 0) +
+         " mean " + String(probe.mean()) + " max " + String(probe.max) + " cycles, log2";
+    for (int n = 0; n < TraceStats::Buckets; n++)
+    {
+      if (probe.histogram[n])
+      {
+        s += " " + String(n) + ":" + String(probe.histogram[n]);
+      }
+    }
+    s += "\n";
+  }
+  CompositeSerial.write(s.c_str());
+#endif
+}
+#endif
+
+// Called from loop(): takes every whole block of analog input that the DMA has written since the last call. The
+// compressor rescales the outputs when its gain moves, and a pot that has been turned queues a control change just
+// as MIDI does. The ring holds 7 ms of input, so after a longer stall, such as a flash erase, some of the blocks read
+// have already been overwritten with newer input.
+void updateAnalogInputs()
+{
+  int written = analogDma.frame();
+  while ((written - analogFrame + AnalogFrames) % AnalogFrames >= AnalogBlock)
+  {
+    const uint16_t* block = analogDma.samples(analogFrame, 0);
+    compressor.processBlock(block + AnalogEnvelope, AnalogBlock, state.compressor, AnalogPinCount);
+#if POT_CONTROLS
+    uint32_t turned = pots.process(block, AnalogBlock);
+    for (int i = 0; turned != 0; i++, turned >>= 1)
+    {
+      if (turned & 1)
+      {
+        controlChanges.set((uint8_t)PotControls[i], pots.value(i));
+      }
+    }
+#endif
+    analogFrame = (analogFrame + AnalogBlock) % AnalogFrames;
+  }
+  if (compressor.gain() != state.compressorGain)
+  {
+    state.compressorGain = compressor.gain();
+    updateLevelsAndTremoloDepth();
+    updateDryLevel();
+    stateBuffer.publish(state);
   }
-  */
+}
+
+void loop()
+{
+#if TRACE_PROBES
+  uint32_t traceStart = traceCycles();
+#endif
+  receiveDinMidi();
+  midi.poll();
+  updateAnalogInputs();
+  checkClockTimeout();
+  applyControlChanges();
+  sendSysExReplies();
+#if OLED_DISPLAY
+  status.update(millis());
+#endif
+  updateMidiStatus();
+  saveSettings();
+#if TRACE_PROBES
+  trace.probes[(int)TraceProbe::Loop].record(traceCycles() - traceStart);
+  reportTrace();
+#endif
 }
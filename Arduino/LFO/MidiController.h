@@ -1,4 +1,4 @@
-#pragma once;
+#pragma once
 
 #include <USBMIDI.h>
 
@@ -18,12 +18,32 @@ public:
     _sysExEndCallback = end;
   }
 
+  void setClockCallbacks(void (*clock)(), void (*start)()) {
+    _clockCallback = clock;
+    _startCallback = start;
+  }
+
   void handleControlChange(unsigned int channel, unsigned int controller, unsigned int value) override {
     if (_controlChangeCallback) {
       _controlChangeCallback(channel, controller, value);
     }
   }
 
+  // A whole SysEx message, F0 to F7, as USB MIDI event packets of three bytes; the code index of the last packet
+  // tells how many of its bytes end the message
+  void sendSysEx(const uint8_t* message, uint32_t length) {
+    while (length > 3) {
+      writePacket(0x04 | message[0] << 8 | message[1] << 16 | (uint32)message[2] << 24);
+      message += 3;
+      length -= 3;
+    }
+    uint32 packet = 0x04 + length;
+    for (uint32_t i = 0; i < length; i++) {
+      packet |= (uint32)message[i] << (8 * (i + 1));
+    }
+    writePacket(packet);
+  }
+
   void handleProgramChange(unsigned int channel, unsigned int program) override {
     if (_programChangeCallback) {
       _programChangeCallback(channel, program);
@@ -41,10 +61,24 @@ public:
       _sysExEndCallback();
     }
   }
+
+  void handleSync(void) override {
+    if (_clockCallback) {
+      _clockCallback();
+    }
+  }
+
+  void handleStart(void) override {
+    if (_startCallback) {
+      _startCallback();
+    }
+  }
   
 private:
   void (*_controlChangeCallback)(unsigned int, unsigned int, unsigned int) = nullptr;
   void (*_programChangeCallback)(unsigned int, unsigned int) = nullptr;
   void (*_sysExDataCallback)(unsigned char) = nullptr;
   void (*_sysExEndCallback)() = nullptr;
+  void (*_clockCallback)() = nullptr;
+  void (*_startCallback)() = nullptr;
 };
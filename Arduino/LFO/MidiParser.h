@@ -0,0 +1,47 @@
+/**
+ * @file MidiParser.h
+ * @author Gino Bollaert
+ * @brief Inclusion of the bundled stmlib MIDI stream parser
+ * @details midi.h expects stmlib's integer types and DISALLOW_COPY_AND_ASSIGN macro to be defined before it is
+ * included. MidiParserHandler provides no-op versions of every handler callback, so a handler derives from it
+ * and declares only the messages it cares about.
+ * @date 2023-06-19
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+#ifndef DISALLOW_COPY_AND_ASSIGN
+#define DISALLOW_COPY_AND_ASSIGN(TypeName) \
+  TypeName(const TypeName&) = delete;      \
+  void operator=(const TypeName&) = delete
+#endif
+
+#include "midi.h"
+
+struct MidiParserHandler
+{
+  static void RawByte(uint8_t /* byte */) {}
+  static bool CheckChannel(uint8_t /* channel */) { return true; }
+  static void RawMidiData(uint8_t /* status */, uint8_t* /* data */, uint8_t /* size */, uint8_t /* acceptedChannel */)
+  {
+  }
+  static void BozoByte(uint8_t /* byte */) {}
+  static void NoteOn(uint8_t /* channel */, uint8_t /* note */, uint8_t /* velocity */) {}
+  static void NoteOff(uint8_t /* channel */, uint8_t /* note */, uint8_t /* velocity */) {}
+  static void Aftertouch(uint8_t /* channel */, uint8_t /* note */, uint8_t /* velocity */) {}
+  static void Aftertouch(uint8_t /* channel */, uint8_t /* velocity */) {}
+  static void ControlChange(uint8_t /* channel */, uint8_t /* controller */, uint8_t /* value */) {}
+  static void ProgramChange(uint8_t /* channel */, uint8_t /* program */) {}
+  static void PitchBend(uint8_t /* channel */, uint16_t /* pitchBend */) {}
+  static void SysExStart() {}
+  static void SysExByte(uint8_t /* byte */) {}
+  static void SysExEnd() {}
+  static void Clock() {}
+  static void Start() {}
+  static void Continue() {}
+  static void Stop() {}
+  static void Reset() {}
+};
@@ -2,6 +2,7 @@
 
 #include "DisplayInterface.h"
 #include <U8g2lib.h>
+#include <string.h>
 
 #ifdef U8X8_HAVE_HW_SPI
 #include <SPI.h>
@@ -17,24 +18,60 @@ public:
 
   void init() {
     _display.begin();
+    memset(_shown, 0, sizeof(_shown));
     _display.setFontMode(1);
     _display.setFont(u8g2_font_crox1h_tf);
     _display.clearBuffer();    
   }
   
-  void clear() override { _display.clear(); }
+  // U8g2's clear() also sends the blank buffer, so only clear the buffer here
+  void clear() override { _display.clearBuffer(); }
+  void clearRect(int x, int y, int w, int h) override {
+    _display.setDrawColor(0);
+    _display.drawBox(x, y, w, h);
+    _display.setDrawColor(1);
+  }
   void show() override {
-    _display.sendBuffer();
-    _display.clearBuffer();
+    for (int page = 0; page < pageCount(); page++) {
+      showPage(page);
+    }
+  }
+  int pageCount() override { return _display.getBufferTileHeight(); }
+
+  // Sends only the 8x8 tiles of the page that differ from what the panel shows, merging adjacent ones into a
+  // single area update
+  void showPage(int page) override {
+    const int tiles = _display.getBufferTileWidth();
+    const uint8_t* frame = _display.getBufferPtr() + page * tiles * kTileBytes;
+    uint8_t* shown = _shown + page * tiles * kTileBytes;
+    int tx = 0;
+    while (tx < tiles) {
+      if (memcmp(frame + tx * kTileBytes, shown + tx * kTileBytes, kTileBytes) == 0) {
+        tx++;
+        continue;
+      }
+      int first = tx;
+      while (tx < tiles && memcmp(frame + tx * kTileBytes, shown + tx * kTileBytes, kTileBytes) != 0) {
+        memcpy(shown + tx * kTileBytes, frame + tx * kTileBytes, kTileBytes);
+        tx++;
+      }
+      _display.updateDisplayArea(first, page, tx - first, 1);
+    }
   }
   int width() override { return _display.getDisplayWidth(); }
   int height() override { return _display.getDisplayHeight(); }
   void requestFontHeight(int hgt) override { _display.setFont(u8g2_font_crox1h_tf); }
   int fontHeight() override { return _display.getMaxCharHeight(); }
-  void drawString(int x, int y, String s, Align align = Align::kLeft) override {
-    _display.drawStr(align == Align::kLeft ? x : x - _display.getStrWidth(s.c_str()), y + fontHeight(), s.c_str());
+  void drawString(int x, int y, const char* s, Align align = Align::kLeft) override {
+    _display.drawStr(align == Align::kLeft ? x : x - _display.getStrWidth(s), y + fontHeight(), s);
   }
 
+  U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C& driver() { return _display; }
+
 private:
+  static constexpr int kTileBytes = 8;
+  static constexpr int kFrameBytes = 128 * 32 / 8;
+
   U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C _display;
+  uint8_t _shown[kFrameBytes] = {}; // what the panel shows; begin() blanks it
 };
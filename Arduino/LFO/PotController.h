@@ -1,20 +1,23 @@
 #pragma once
 
-#include <Arduino.h>
-
 
+// Schmitt hysteresis turning a pot's 12-bit readings into a 7-bit value. The readings come from PotFilter, which
+// takes them from the ADC's DMA buffer, so nothing here waits for a conversion.
 class PotController {
 public:
-  PotController(int pin, int halfSchmitt = 32)
-  : _pin(pin)
-  , _halfSchmitt(halfSchmitt) {
-    pinMode(pin, INPUT_ANALOG);
-    _pinReading = analogRead(pin);
-    _value = _pinReading / 32;
+  explicit PotController(int halfSchmitt = 32)
+  : _halfSchmitt(halfSchmitt) {
+  }
+
+  // Starts from `reading` without counting it as a change
+  void reset(int reading) {
+    _pinReading = reading;
+    _value = reading / 32;
+    _direction = 0;
   }
 
-  bool update() {
-     return update(analogRead(_pin), _pinReading - 16 - _halfSchmitt - _direction * _halfSchmitt, _pinReading + 16 + _halfSchmitt - _direction * _halfSchmitt);
+  bool update(int reading) {
+     return update(reading, _pinReading - 16 - _halfSchmitt - _direction * _halfSchmitt, _pinReading + 16 + _halfSchmitt - _direction * _halfSchmitt);
   }
 
   bool update(int reading, int min, int max) {
@@ -39,7 +42,6 @@ public:
   int value() const { return _value; }
 
 private:
-  int _pin;
   int _value = 0;
   int _pinReading = 0;
   int _direction = 0;
@@ -0,0 +1,84 @@
+/**
+ * @file PotFilter.h
+ * @author Gino Bollaert
+ * @brief Oversampling, decimation and hysteresis for the pots, a block of ADC frames at a time
+ * @details The ADC scan writes frames of one sample per analog pin. Every pot's samples are summed over
+ * 2^OversampleBits frames and the sum, shifted back to 12 bits, is one reading: a boxcar decimation that averages out
+ * the converter's noise before the Schmitt hysteresis of PotController sees it. A pot only reports a change when its
+ * 7-bit value moves. The first reading after reset() sets where the pots are without reporting them, so that the
+ * values restored at power-on stand until a pot is turned.
+ * @date 2023-07-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include "PotController.h"
+#include <cinttypes>
+
+template <int Pots, int OversampleBits>
+class PotFilter
+{
+  static_assert(Pots <= 32, "changes are reported as a bit mask");
+
+public:
+  static constexpr int Oversample = 1 << OversampleBits;
+
+  /** Pot n is sample `channels[n]` of frames `stride` samples long */
+  PotFilter(const uint8_t* channels, int stride) : _channels(channels), _stride(stride) {}
+
+  /** Forgets the pots' positions; the next reading of each sets it again */
+  void reset()
+  {
+    _count = 0;
+    _started = false;
+    for (int n = 0; n < Pots; n++)
+    {
+      _sums[n] = 0;
+    }
+  }
+
+  /** Takes `count` frames and returns a mask of the pots whose value has changed, bit n for pot n */
+  uint32_t process(const uint16_t* frames, int count)
+  {
+    uint32_t changed = 0;
+    for (int i = 0; i < count; i++, frames += _stride)
+    {
+      for (int n = 0; n < Pots; n++)
+      {
+        _sums[n] += frames[_channels[n]];
+      }
+      if (++_count < Oversample)
+      {
+        continue;
+      }
+      for (int n = 0; n < Pots; n++)
+      {
+        int reading = static_cast<int>(_sums[n] >> OversampleBits);
+        _sums[n] = 0;
+        if (!_started)
+        {
+          _pots[n].reset(reading);
+        }
+        else if (_pots[n].update(reading))
+        {
+          changed |= 1u << n;
+        }
+      }
+      _count = 0;
+      _started = true;
+    }
+    return changed;
+  }
+
+  /** 7-bit value of pot `n` */
+  int value(int n) const { return _pots[n].value(); }
+
+private:
+  const uint8_t* _channels;
+  int _stride;
+  PotController _pots[Pots];
+  uint32_t _sums[Pots] = {};
+  int _count = 0;
+  bool _started = false;
+};
@@ -0,0 +1,164 @@
+/**
+ * @file PresetBank.h
+ * @author Gino Bollaert
+ * @brief Fixed array of checksummed preset slots in flash
+ * @details Slot `index` lives at a fixed place, several to a page, so reading a preset is a single read of one slot.
+ * Writing to a blank slot programs it in place; overwriting a slot rewrites its page from a copy in RAM, since flash
+ * can only be erased a page at a time, dropping any slot on that page that is not valid. Each slot carries the
+ * bank's format, the version of T's layout: a slot that is blank, fails its checksum or holds another format reads
+ * as empty, so a preset is never read with a layout other than the one it was stored with.
+ * @date 2023-06-28
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include "FlashDevice.h"
+#include <string.h>
+#include <type_traits>
+
+template <typename T>
+class PresetBank
+{
+  static_assert(std::is_trivially_copyable<T>::value, "presets are stored as raw bytes");
+
+  struct Header
+  {
+    uint16_t magic;
+    uint16_t size;
+    uint16_t format;
+  };
+
+public:
+  static constexpr uint16_t Magic = 0x5250;
+  static constexpr uint32_t PayloadBytes = (sizeof(T) + 1) & ~1u;
+  static constexpr uint32_t SlotBytes = sizeof(Header) + PayloadBytes + 4;
+  static constexpr uint32_t MaxPageSize = 1024; // size of the page copy on the stack when a slot is overwritten
+
+  /** Pages taken by `count` slots on a flash with `pageSize` pages */
+  static constexpr int pagesFor(int count, uint32_t pageSize)
+  {
+    return (count + pageSize / SlotBytes - 1) / (pageSize / SlotBytes);
+  }
+
+  PresetBank(FlashDevice& flash, int count, uint16_t format = 0)
+      : _flash(flash), _count(count), _format(format), _slotsPerPage(flash.pageSize() / SlotBytes)
+  {
+  }
+
+  int count() const { return _count; }
+
+  /** Copies preset `index` to `value`; returns false, leaving `value` alone, if the slot is empty */
+  bool read(int index, T& value)
+  {
+    if (index < 0 || index >= _count)
+    {
+      return false;
+    }
+    Slot slot;
+    _flash.read(page(index), offset(index), &slot, sizeof(Slot));
+    if (!slot.valid(_format))
+    {
+      return false;
+    }
+    memcpy(&value, slot.payload, sizeof(T));
+    return true;
+  }
+
+  /** Stores `value` as preset `index`, rewriting its page unless the slot is still blank or already holds `value` */
+  bool write(int index, const T& value)
+  {
+    if (index < 0 || index >= _count || _flash.pageSize() > MaxPageSize)
+    {
+      return false;
+    }
+    Slot slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.header.magic = Magic;
+    slot.header.size = sizeof(T);
+    slot.header.format = _format;
+    memcpy(slot.payload, &value, sizeof(T));
+    uint32_t checksum = slot.sum();
+    slot.checksum[0] = static_cast<uint16_t>(checksum);
+    slot.checksum[1] = static_cast<uint16_t>(checksum >> 16);
+
+    Slot current;
+    _flash.read(page(index), offset(index), &current, sizeof(Slot));
+    if (current.blank())
+    {
+      return program(page(index), offset(index), slot);
+    }
+    if (memcmp(&current, &slot, sizeof(Slot)) == 0)
+    {
+      return true;
+    }
+
+    Slot copy[MaxPageSize / SlotBytes];
+    int first = index - index % _slotsPerPage;
+    int slots = _count - first < _slotsPerPage ? _count - first : _slotsPerPage;
+    _flash.read(page(index), 0, copy, slots * SlotBytes);
+    copy[index - first] = slot;
+    if (!_flash.erasePage(page(index)))
+    {
+      return false;
+    }
+    bool ok = true;
+    for (int i = 0; i < slots; i++)
+    {
+      if (copy[i].valid(_format))
+      {
+        ok = program(page(index), i * SlotBytes, copy[i]) && ok;
+      }
+    }
+    return ok;
+  }
+
+private:
+  struct Slot
+  {
+    Header header;
+    uint8_t payload[PayloadBytes];
+    uint16_t checksum[2];
+
+    uint32_t sum() const
+    {
+      return fletcher32(reinterpret_cast<const uint16_t*>(this), (sizeof(Header) + PayloadBytes) / 2);
+    }
+
+    bool valid(uint16_t format) const
+    {
+      uint32_t stored = checksum[0] | (static_cast<uint32_t>(checksum[1]) << 16);
+      return header.magic == Magic && header.size == sizeof(T) && header.format == format && stored == sum();
+    }
+
+    bool blank() const
+    {
+      const uint16_t* words = reinterpret_cast<const uint16_t*>(this);
+      for (uint32_t i = 0; i < SlotBytes / 2; i++)
+      {
+        if (words[i] != 0xffff)
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+  };
+  static_assert(sizeof(Slot) == SlotBytes, "slots are packed");
+
+  int page(int index) const { return index / _slotsPerPage; }
+  uint32_t offset(int index) const { return (index % _slotsPerPage) * SlotBytes; }
+
+  // The checksum goes last, so a slot cut short by a power loss reads as empty
+  bool program(int page, uint32_t offset, const Slot& slot)
+  {
+    const uint16_t* words = reinterpret_cast<const uint16_t*>(&slot);
+    return _flash.program(page, offset, words, SlotBytes / 2 - 2) &&
+           _flash.program(page, offset + SlotBytes - 4, slot.checksum, 2);
+  }
+
+  FlashDevice& _flash;
+  int _count;
+  uint16_t _format;
+  int _slotsPerPage;
+};
@@ -0,0 +1,46 @@
+/**
+ * @file PwmDither.h
+ * @author Gino Bollaert
+ * @brief Error-feedback requantization of 16-bit output levels to PWM compare values
+ * @details The LFO renders 16-bit levels but the PWM has fewer bits. Truncating the low bits leaves stairs in slow,
+ * shallow modulation. Instead, every PWM period each level is added to the bits its channel lost in the previous
+ * period, the sum is shifted down for the compare value, and the bits shifted out are kept as the next error: a
+ * first-order sigma-delta modulator. The compare values average to the 16-bit level over 2^Shift periods, and the
+ * requantization noise is shaped by (1 - z^-1), away from the LFO's frequencies and up towards the PWM rate, where the
+ * output filters take it out. It costs an add, a shift and a mask per channel and period.
+ * @date 2023-07-10
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+template <int N, int Shift>
+class PwmDither
+{
+public:
+  static constexpr uint32_t Mask = (1u << Shift) - 1;
+
+  void reset()
+  {
+    for (int n = 0; n < N; n++)
+    {
+      _error[n] = 0;
+    }
+  }
+
+  /** Compare values for the next PWM period of the 16-bit `levels`, from 0 to 2^(16 - Shift) inclusive */
+  void next(const uint16_t* levels, uint16_t* out)
+  {
+    for (int n = 0; n < N; n++)
+    {
+      uint32_t v = levels[n] + _error[n];
+      out[n] = static_cast<uint16_t>(v >> Shift);
+      _error[n] = static_cast<uint16_t>(v & Mask);
+    }
+  }
+
+private:
+  uint16_t _error[N] = {};
+};
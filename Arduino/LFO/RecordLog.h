@@ -0,0 +1,167 @@
+/**
+ * @file RecordLog.h
+ * @author Gino Bollaert
+ * @brief Append-only, wear-levelled log of fixed-size records in flash
+ * @details Every append() writes a new record after the previous one, so a page is only erased once all its slots
+ * have been used, and pages are reused in turn. Each record carries a sequence number and ends with a checksum,
+ * which is programmed last: a record cut short by a power loss fails the check and is skipped. restore() reads the
+ * first record of each page to find the newest page and then scans only that page.
+ * @date 2023-06-26
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include "FlashDevice.h"
+#include <string.h>
+#include <type_traits>
+
+template <typename T>
+class RecordLog
+{
+  static_assert(std::is_trivially_copyable<T>::value, "records are stored as raw bytes");
+
+  // Half-word fields only, so that records pack without padding
+  struct Header
+  {
+    uint16_t magic;
+    uint16_t size;
+    uint16_t sequence[2];
+
+    uint32_t number() const { return sequence[0] | (static_cast<uint32_t>(sequence[1]) << 16); }
+  };
+
+public:
+  static constexpr uint16_t Magic = 0x4c52;
+  static constexpr uint32_t PayloadBytes = (sizeof(T) + 1) & ~1u;
+  static constexpr uint32_t RecordBytes = sizeof(Header) + PayloadBytes + 4;
+
+  explicit RecordLog(FlashDevice& flash) : _flash(flash), _slotsPerPage(flash.pageSize() / RecordBytes) {}
+
+  /** Finds the newest valid record and copies it to `value`; returns false, leaving `value` alone, if there is none */
+  bool restore(T& value)
+  {
+    _scannedBytes = 0;
+    int newest = -1;
+    uint32_t newestSequence = 0;
+    for (int page = 0; page < _flash.pageCount(); page++)
+    {
+      Record record;
+      if (readRecord(page, 0, record) == Slot::Valid && (newest < 0 || record.header.number() > newestSequence))
+      {
+        newest = page;
+        newestSequence = record.header.number();
+      }
+    }
+    if (newest < 0)
+    {
+      _page = 0;
+      _slot = 0;
+      _sequence = 0;
+      return false;
+    }
+
+    Record latest = {};
+    _page = newest;
+    _slot = 0;
+    while (_slot < _slotsPerPage)
+    {
+      Record record;
+      Slot slot = readRecord(_page, _slot, record);
+      if (slot == Slot::Blank)
+      {
+        break;
+      }
+      if (slot == Slot::Valid)
+      {
+        latest = record;
+      }
+      _slot++;
+    }
+    _sequence = latest.header.number();
+    memcpy(&value, latest.payload, sizeof(T));
+    return true;
+  }
+
+  /** Writes `value` as the newest record, erasing the next page first when the current one is full */
+  bool append(const T& value)
+  {
+    if (_slot >= _slotsPerPage)
+    {
+      _page = (_page + 1) % _flash.pageCount();
+      _slot = 0;
+    }
+    if (_slot == 0 && !_flash.erasePage(_page))
+    {
+      return false;
+    }
+
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.header.magic = Magic;
+    record.header.size = sizeof(T);
+    _sequence++;
+    record.header.sequence[0] = static_cast<uint16_t>(_sequence);
+    record.header.sequence[1] = static_cast<uint16_t>(_sequence >> 16);
+    memcpy(record.payload, &value, sizeof(T));
+    uint32_t checksum = record.sum();
+    record.checksum[0] = static_cast<uint16_t>(checksum);
+    record.checksum[1] = static_cast<uint16_t>(checksum >> 16);
+
+    const uint16_t* words = reinterpret_cast<const uint16_t*>(&record);
+    uint32_t offset = _slot * RecordBytes;
+    _slot++;
+    return _flash.program(_page, offset, words, RecordBytes / 2 - 2) &&
+           _flash.program(_page, offset + RecordBytes - 4, record.checksum, 2);
+  }
+
+  uint32_t sequence() const { return _sequence; }
+  int slotsPerPage() const { return _slotsPerPage; }
+  /** Bytes read by the last restore() */
+  uint32_t scannedBytes() const { return _scannedBytes; }
+
+private:
+  enum class Slot
+  {
+    Blank,
+    Valid,
+    Invalid,
+  };
+
+  struct Record
+  {
+    Header header;
+    uint8_t payload[PayloadBytes];
+    uint16_t checksum[2];
+
+    /** Fletcher-32 of the header and payload */
+    uint32_t sum() const
+    {
+      return fletcher32(reinterpret_cast<const uint16_t*>(this), (sizeof(Header) + PayloadBytes) / 2);
+    }
+  };
+  static_assert(sizeof(Record) == RecordBytes, "records are packed");
+
+  Slot readRecord(int page, int slot, Record& record)
+  {
+    _flash.read(page, slot * RecordBytes, &record, sizeof(Record));
+    _scannedBytes += sizeof(Record);
+    if (record.header.magic == 0xffff)
+    {
+      return Slot::Blank;
+    }
+    uint32_t checksum = record.checksum[0] | (static_cast<uint32_t>(record.checksum[1]) << 16);
+    if (record.header.magic != Magic || record.header.size != sizeof(T) || checksum != record.sum())
+    {
+      return Slot::Invalid;
+    }
+    return Slot::Valid;
+  }
+
+  FlashDevice& _flash;
+  int _slotsPerPage;
+  int _page = 0;
+  int _slot = 0;
+  uint32_t _sequence = 0;
+  uint32_t _scannedBytes = 0;
+};
@@ -38,7 +38,7 @@ SettingsItem* SettingsItem::get(int pos) const {
 int SettingsItem::countSiblings() const {
   int count = 1;
   const SettingsItem* sibling = head();
-  while (sibling = sibling->_next) {
+  while ((sibling = sibling->_next)) {
     ++count;
   }
   return count;
@@ -143,23 +143,71 @@ SettingsMenu::SettingsMenu(DisplayInterface* display, RotaryButton& rotary)
   _maxLines = display->height() / display->fontHeight();
 }
 
+void SettingsMenu::setTree(const MenuNode* nodes, int count) {
+  _nodes = nodes;
+  _nodeCount = count;
+  for (int i = 0; i < count; i++) {
+    nodes[i].item->_node = i;
+  }
+}
+
+static int countDescendants(const SettingsItem* item) {
+  int count = 0;
+  for (const SettingsItem* child = item->_firstChild; child; child = child->_next) {
+    count += 1 + countDescendants(child);
+  }
+  return count;
+}
+
+// Lays the linked items out breadth first, so that the children of each item are adjacent
+void SettingsMenu::flatten() {
+  int count = 1 + countDescendants(this);
+  if (count > _ownedCapacity) {
+    delete[] _ownedNodes;
+    _ownedNodes = new MenuNode[count];
+    _ownedCapacity = count;
+  }
+
+  _ownedNodes[0] = { this, MenuNode::kNone, 0, 0 };
+  int end = 1;
+  for (int i = 0; i < end; i++) {
+    MenuNode& node = _ownedNodes[i];
+    node.item->_node = i;
+    node.firstChild = end;
+    for (SettingsItem* child = node.item->_firstChild; child; child = child->_next) {
+      _ownedNodes[end++] = { child, static_cast<uint16_t>(i), 0, 0 };
+    }
+    node.childCount = end - node.firstChild;
+  }
+  _nodes = _ownedNodes;
+  _nodeCount = count;
+}
+
 void SettingsMenu::show() {
   if (_isHidden) {
+    if (!_nodes || _nodes == _ownedNodes) {
+      flatten();
+    }
     _rotary.saveState(_savedRotaryState);
-    setContext(this);
+    setContext(0);
+    invalidate();
   }
 
-  if (!_context || !_selectedItem) {
+  if (_context == MenuNode::kNone || _selected == MenuNode::kNone) {
     return;
   }
   
-  switch(_context->type()) {
+  if (_fullRedraw) {
+    _display->clear();
+  }
+
+  switch(context()->type()) {
   case SettingsItem::Type::kMenu:
-    displayMenu(static_cast<const Menu*>(_context));
+    displayMenu(static_cast<const Menu*>(context()));
     break;
     
   case SettingsItem::Type::kChoice:
-    displayChoiceSetting(static_cast<const ChoiceSetting*>(_context));
+    displayChoiceSetting(static_cast<const ChoiceSetting*>(context()));
     break;
 
   default:
@@ -167,11 +215,13 @@ void SettingsMenu::show() {
   }
 
   _isHidden = false;
+  _fullRedraw = false;
+  _dirtyLines = 0;
   _display->show();
 }
 
 void SettingsMenu::hide() {
-  setContext(nullptr);
+  setContext(MenuNode::kNone);
   _display->clear();
   _isHidden = true;
   _isDirty = false;
@@ -228,7 +278,7 @@ void SettingsMenu::updateRotary() {
   
   applyTurns();
   applyButton();
-  if (!_isHidden) {
+  if (!_isHidden && (_fullRedraw || _dirtyLines)) {
     show();
   }
 }
@@ -236,59 +286,83 @@ void SettingsMenu::updateRotary() {
 void SettingsMenu::navigateBack() {
   if (_editing) {
     _editing = false;
-    navigateToItem(_selectedItem);
-    _rotary.setCounterRange(0, _context->countChildren() - 1);
-    _rotary.resetCounter(_selectedItem->position());
+    invalidatePos(position(_selected));
+    navigateToNode(_selected);
+    _rotary.setCounterRange(0, childCount(_context) - 1);
+    _rotary.resetCounter(position(_selected));
   }
   else {
-    navigateToItem(_selectedItem->_parent);
+    navigateToNode(_nodes[_selected].parent);
   }
 }
-  
+
 void SettingsMenu::navigateToItem(SettingsItem* item) {
-  if (item == this) {
-    setContext(this);
+  if (item && item->_node < _nodeCount && _nodes[item->_node].item == item) {
+    navigateToNode(item->_node);
+  }
+}
+  
+void SettingsMenu::navigateToNode(int node) {
+  if (node == 0) {
+    setContext(0);
     return;
   }
 
-  if (!item || !item->_parent) {
+  if (node >= _nodeCount || _nodes[node].parent == MenuNode::kNone) {
     return;
   }
   
-  setContext(item->_parent);
-  _selectedItem = item;
-  scrollToPos(item->position());
+  setContext(_nodes[node].parent);
+  if (node != _selected) {
+    if (_selected != MenuNode::kNone) {
+      invalidatePos(position(_selected));
+    }
+    _selected = node;
+    invalidatePos(position(node));
+  }
+  scrollToPos(position(node));
+}
+
+void SettingsMenu::invalidatePos(long pos) {
+  long line = pos - _contextScrollPos;
+  if (line >= 0 && line < _maxLines) {
+    _dirtyLines |= 1u << line;
+  }
 }
 
-void SettingsMenu::setContext(SettingsItem* context) {
+void SettingsMenu::prepareLine(int line, int lineHeight) {
+  if (!_fullRedraw) {
+    _display->clearRect(0, line * lineHeight, _display->width(), lineHeight);
+  }
+}
+
+void SettingsMenu::setContext(int context) {
   if (context == _context) {
     return;
   }
 
-  if (!context) {
-    _context = nullptr;
+  if (context == MenuNode::kNone) {
+    _context = MenuNode::kNone;
     return;
   }
   
-  switch (context->type()) {
+  switch (item(context)->type()) {
   case SettingsItem::Type::kMenu:
-    {
-      const Menu* menu = static_cast<const Menu*>(context);
-      _rotary.setCounterRange(0, menu->countChildren() - 1);
-      _rotary.resetCounter();
-      _editing = false;
-      _selectedItem = menu->_firstChild;
-      _contextScrollPos = 0;
-    }
+    _rotary.setCounterRange(0, childCount(context) - 1);
+    _rotary.resetCounter();
+    _editing = false;
+    _selected = childCount(context) ? _nodes[context].firstChild : MenuNode::kNone;
+    _contextScrollPos = 0;
     break;
     
   case SettingsItem::Type::kChoice:
     {
-      const ChoiceSetting* setting = static_cast<const ChoiceSetting*>(context);
+      const ChoiceSetting* setting = static_cast<const ChoiceSetting*>(item(context));
       _rotary.setCounterRange(setting->minimum(), setting->maximum() + 1);
       _rotary.resetCounter(setting->value());
       _editing = true;
-      _selectedItem = context;
+      _selected = context;
+      _choiceCursor = setting->value();
       _contextScrollPos = 0;
       scrollToPos(setting->value());
     }
@@ -299,32 +373,45 @@ void SettingsMenu::setContext(SettingsItem* context) {
   }
   
   _context = context;
+  invalidate();
 }
 
 void SettingsMenu::scrollToPos(int pos) {
+  int scrollPos = _contextScrollPos;
   if (pos >= _contextScrollPos + _maxLines) {
     _contextScrollPos = pos - _maxLines + 1;
   }
   else if (pos < _contextScrollPos) {
     _contextScrollPos = pos;
   }
+  if (_contextScrollPos != scrollPos) {
+    invalidate();
+  }
 }
 
 void SettingsMenu::applyTurns() {
-  switch (_context->type()) {
+  switch (context()->type()) {
   case SettingsItem::Type::kMenu:
     if (_editing) {
-      IntSetting* setting = static_cast<IntSetting*>(_selectedItem);
+      IntSetting* setting = static_cast<IntSetting*>(selectedItem());
       if (setting->setValue(_rotary.counter())) {
+        invalidatePos(position(_selected));
         onSettingChanged(setting);
       }
     }
     else {
-      navigateToItem(_context->getChild(_rotary.counter()));
+      long pos = _rotary.counter();
+      int last = childCount(_context) - 1;
+      navigateToNode(_nodes[_context].firstChild + (pos < 0 ? 0 : (pos > last ? last : pos)));
     }
     break;
     
   case SettingsItem::Type::kChoice:
+    if (_rotary.counter() != _choiceCursor) {
+      invalidatePos(_choiceCursor);
+      invalidatePos(_rotary.counter());
+      _choiceCursor = _rotary.counter();
+    }
     scrollToPos(_rotary.counter());
     break;
     
@@ -336,8 +423,8 @@ void SettingsMenu::applyTurns() {
 void SettingsMenu::applyButton() {
   if (_rotary.triggered(SINGLE_TAP)) {
     if (_editing) {
-      if (_selectedItem->type() == SettingsItem::Type::kChoice) {
-        ChoiceSetting* setting = static_cast<ChoiceSetting*>(_selectedItem);
+      if (selectedItem()->type() == SettingsItem::Type::kChoice) {
+        ChoiceSetting* setting = static_cast<ChoiceSetting*>(selectedItem());
         if (_rotary.counter() <= setting->maximum()) {
           if (setting->setValue(_rotary.counter())) {
             onSettingChanged(setting);
@@ -347,7 +434,7 @@ void SettingsMenu::applyButton() {
       navigateBack();
     }
     else {
-      switch(_context->type()) {
+      switch(context()->type()) {
       case SettingsItem::Type::kMenu:
         applyMenuTap();
         break;
@@ -360,25 +447,26 @@ void SettingsMenu::applyButton() {
 }
   
 void SettingsMenu::applyMenuTap() {
-  switch(_selectedItem->type()) {
+  switch(selectedItem()->type()) {
   case SettingsItem::Type::kMenu:
   case SettingsItem::Type::kChoice:
-    setContext(_selectedItem);
+    setContext(_selected);
     break;
 
   case SettingsItem::Type::kAction:
     {
-      Action* action = static_cast<Action*>(_selectedItem);
+      Action* action = static_cast<Action*>(selectedItem());
       action->perform();
     }
     break;
 
   case SettingsItem::Type::kInt:
     {
-      const IntSetting* setting = static_cast<const IntSetting*>(_selectedItem);
+      const IntSetting* setting = static_cast<const IntSetting*>(selectedItem());
       _rotary.setCounterRange(setting->minimum(), setting->maximum());
       _rotary.resetCounter(setting->value());
       _editing = true;
+      invalidatePos(position(_selected));
       break;
     }
   }
@@ -392,33 +480,48 @@ void SettingsMenu::onSettingChanged(SettingBase* setting) {
 }
 
 void SettingsMenu::displayMenu(const Menu* menu) {
-  SettingsItem* item = menu->_firstChild->get(_contextScrollPos);
-  for (int i = 0; i < _maxLines && item; i++) {
+  int first = _nodes[_context].firstChild;
+  int end = first + childCount(_context);
+  for (int i = 0, node = first + _contextScrollPos; i < _maxLines && node < end; i++, node++) {
+    if (!isLineDirty(i)) {
+      continue;
+    }
+    prepareLine(i, _display->fontHeight());
     int y = i * _display->fontHeight();
+    const SettingsItem* item = this->item(node);
     
-    if (_selectedItem == item && !_editing) {
+    if (_selected == node && !_editing) {
       _display->drawString(0, y, ">");
     }
     _display->drawString(kInset, y, item->name());
     
-    if (_selectedItem == item && _editing) {
-      _display->drawString(_display->width(), y, String("< ") + item->description() + " >", Align::kRight);
+    if (_selected == node && _editing) {
+      DisplayText s("< ");
+      s += item->description();
+      s += " >";
+      _display->drawString(_display->width(), y, s.c_str(), Align::kRight);
     }
     else {
-      _display->drawString(_display->width(), y, item->description(), Align::kRight);
+      _display->drawString(_display->width(), y, item->description().c_str(), Align::kRight);
     }
-    item = item->_next;
   }
 }
 
 void SettingsMenu::displayChoiceSetting(const ChoiceSetting* choice) {
-  _display->drawString(kInset, 0, choice->name());
   int index = _contextScrollPos;
-  for (int i = 0; i < _maxLines && index <= _rotary.counterMaximum(); i++) {
+  for (int i = 0; i < _maxLines && index <= _rotary.counterMaximum(); i++, index++) {
+    if (!isLineDirty(i)) {
+      continue;
+    }
+    prepareLine(i, kFontHeight);
+    if (i == 0) {
+      _display->drawString(kInset, 0, choice->name());
+    }
     int y = i * kFontHeight;
     if (index <= choice->maximum()) {
-      String s = choice->toString(index) + (index == choice->value() ? " [x]" : " [  ]");
-      _display->drawString(_display->width() - kInset, y, s, Align::kRight);
+      DisplayText s = choice->toString(index);
+      s += index == choice->value() ? " [x]" : " [  ]";
+      _display->drawString(_display->width() - kInset, y, s.c_str(), Align::kRight);
     }
     else {
       _display->drawString(_display->width() - kInset, y, "Back", Align::kRight);
@@ -426,20 +529,23 @@ void SettingsMenu::displayChoiceSetting(const ChoiceSetting* choice) {
     if (index == _rotary.counter()) {
       _display->drawString(_display->width(), y, "<", Align::kRight);
     }
-    index++;
   }
 }
 
 void SettingsMenu::resetToDefaults() {
-  resetToDefaults(this);
+  if (!_nodes || _nodes == _ownedNodes) {
+    flatten();
+  }
+  resetToDefaults(0);
+  invalidate();
 }
 
-void SettingsMenu::resetToDefaults(SettingsItem* item) {
-  switch (item->type()) {
+void SettingsMenu::resetToDefaults(int node) {
+  switch (item(node)->type()) {
   case SettingsItem::Type::kInt:
   case SettingsItem::Type::kChoice:
     {
-      SettingBase* setting = static_cast<SettingBase*>(item);
+      SettingBase* setting = static_cast<SettingBase*>(item(node));
       if (setting->reset()) {
         onSettingChanged(setting);
       }
@@ -448,12 +554,11 @@ void SettingsMenu::resetToDefaults(SettingsItem* item) {
 
   default:
     {
-      int children = item->countChildren();
-      for (int i = 0; i < children; i++) {
-        resetToDefaults(item->getChild(i));
+      int first = _nodes[node].firstChild;
+      for (int child = first; child < first + childCount(node); child++) {
+        resetToDefaults(child);
       }
     }
     break;
   }
 }
-
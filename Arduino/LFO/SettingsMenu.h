@@ -14,8 +14,8 @@ public:
 
   SettingsItem(const char* name) : _name(name) {}
 
-  String name() const { return _name; }
-  virtual String description() const = 0;
+  const char* name() const { return _name; }
+  virtual DisplayText description() const = 0;
   virtual Type type() const = 0;
 
   void addChild(SettingsItem* child);
@@ -33,6 +33,7 @@ public:
   SettingsItem* _previous = 0;
   SettingsItem* _next = 0;
   SettingsItem* _firstChild = 0;
+  uint16_t _node = 0;
   
 private:
   const char* _name;
@@ -43,7 +44,7 @@ public:
   Action(const char* name)
   : SettingsItem(name) {}
   
-  String description() const override { return ""; }
+  DisplayText description() const override { return ""; }
   Type type() const override { return Type::kAction; }
 
   virtual void perform() = 0;
@@ -54,7 +55,7 @@ public:
   Menu(const char* name)
   : SettingsItem(name) {}
   
-  String description() const override { return "..."; }
+  DisplayText description() const override { return "..."; }
   Type type() const override { return Type::kMenu; }
 };
 
@@ -73,7 +74,7 @@ public:
   , _value(val)
   , _default(def) {}
 
-  String description() const override { return toString(); }
+  DisplayText description() const override { return toString(); }
   T value() const { return _value; }
   T defaultValue() const { return _default; }
   virtual bool setValue(T val) {
@@ -84,8 +85,12 @@ public:
     return true;
   }
   bool reset() override { return setValue(_default); }
-  String toString() const { return toString(value()); }
-  virtual String toString(T val) const { return String(val); }
+  DisplayText toString() const { return toString(value()); }
+  virtual DisplayText toString(T val) const {
+    DisplayText text;
+    text += val;
+    return text;
+  }
 
 private:
   T& _value;
@@ -111,41 +116,65 @@ public:
   ChoiceSetting(const char* name, int& val, const char* values[], int count, int def);
 
   Type type() const override { return Type::kChoice; }
-  String toString(int val) const override { return _values[val]; }
+  DisplayText toString(int val) const override { return _values[val]; }
 
 private:
   const char** _values;
 };
 
-class SettingsMenu : public Menu {
-public:
+// One item of a flattened settings tree: the children of a node are the `childCount` nodes from `firstChild` on, and
+// the root is node 0. A tree declared as a constexpr array of these lives in flash and is navigated by index.
+struct MenuNode {
+  static constexpr uint16_t kNone = 0xffff;
 
-  class DisplayInterface {
-  public:
-    virtual void clear() = 0;
-    virtual void show() = 0;
-    virtual int width() = 0;
-    virtual int height() = 0;
-    virtual void requestFontHeight(int hgt) = 0;
-    virtual int fontHeight() = 0;
-    virtual void drawString(int x, int y, String s, Align align = Align::kLeft) = 0;
-  };
+  SettingsItem* item;
+  uint16_t parent;
+  uint16_t firstChild;
+  uint16_t childCount;
+};
 
+// True if every child range lies after its parent and points back to it, for use in a static_assert
+template<int N>
+constexpr bool isValidMenuTree(const MenuNode (&nodes)[N]) {
+  if (nodes[0].parent != MenuNode::kNone) {
+    return false;
+  }
+  for (int i = 0; i < N; i++) {
+    for (int child = nodes[i].firstChild; child < nodes[i].firstChild + nodes[i].childCount; child++) {
+      if (child <= i || child >= N || nodes[child].parent != i) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+class SettingsMenu : public Menu {
+public:
   typedef void (*Callback)();
   typedef void (*SettingChangedCallback)(SettingBase*);
   
   SettingsMenu(DisplayInterface* display, RotaryButton& rotary);
+  ~SettingsMenu() { delete[] _ownedNodes; }
+
+  // Uses a prebuilt tree instead of flattening the items added with addChild() each time the menu is shown
+  template<int N>
+  void setTree(const MenuNode (&nodes)[N]) { setTree(nodes, N); }
+  void setTree(const MenuNode* nodes, int count);
   
   void show();
   void hide();
   bool isVisible() { return !_isHidden; }
   void updateRotary();
   void navigateBack();
-  void navigateToStart() { navigateToItem(this); }
+  void navigateToStart() { navigateToNode(0); }
   void navigateToItem(SettingsItem* item);
+  void navigateToNode(int node);
   void resetToDefaults();
   void setSettingChangedCallback(SettingChangedCallback callback) { _settingChangedCallback = callback; }
   void onSettingChanged(SettingBase* setting);
+  // Redraws the whole menu on the next update, e.g. after a setting was changed from elsewhere
+  void invalidate() { _fullRedraw = true; }
   
   Action* createBackAction();
   Action* createSaveAndExitAction(Callback saveCallback, Callback onHiddenCallback = nullptr);
@@ -153,7 +182,16 @@ public:
   Action* createResetToDefaultsAction();
 
 protected:
-  void setContext(SettingsItem* context);
+  SettingsItem* item(int node) const { return _nodes[node].item; }
+  SettingsItem* context() const { return item(_context); }
+  SettingsItem* selectedItem() const { return item(_selected); }
+  int childCount(int node) const { return _nodes[node].childCount; }
+  int position(int node) const { return node - _nodes[_nodes[node].parent].firstChild; }
+  void flatten();
+  void invalidatePos(long pos);
+  bool isLineDirty(int line) const { return _fullRedraw || (_dirtyLines & (1u << line)); }
+  void prepareLine(int line, int lineHeight);
+  void setContext(int context);
   void scrollToPos(int pos);
   void applyTurns();
   void applyButton();
@@ -162,7 +200,7 @@ protected:
   void displayChoiceSetting(const ChoiceSetting* choice);
   void saveAndExit();
   void cancel();
-  void resetToDefaults(SettingsItem* item);
+  void resetToDefaults(int node);
   
 private:
   class BuiltInAction : public Action {
@@ -190,8 +228,12 @@ private:
 
   DisplayInterface* _display;
   RotaryButton& _rotary;
-  SettingsItem* _context = nullptr;
-  SettingsItem* _selectedItem = nullptr;
+  const MenuNode* _nodes = nullptr;
+  int _nodeCount = 0;
+  MenuNode* _ownedNodes = nullptr;
+  int _ownedCapacity = 0;
+  int _context = MenuNode::kNone;
+  int _selected = MenuNode::kNone;
   int _contextScrollPos = 0;
   bool _editing = false;
   int _maxLines;
@@ -203,4 +245,8 @@ private:
   Callback _onHiddenAfterCancelCallback = nullptr;
   SettingChangedCallback _settingChangedCallback = nullptr;
   bool _isDirty = false;
+  // Lines to redraw on the next show(), by position on screen; a full redraw also clears the display
+  uint32_t _dirtyLines = 0;
+  bool _fullRedraw = false;
+  long _choiceCursor = 0;
 };
@@ -0,0 +1,49 @@
+/**
+ * @file SinePolynomial.h
+ * @author Gino Bollaert
+ * @brief Table-free raised cosine evaluator for WaveTable
+ * @details PolynomialSine has the same interface and 16-bit output as the interpolation policies in SineTable.h but
+ * ignores the table. It uses (1 - cos(2 pi p)) / 2 = sin(pi p)^2: the phase is folded about its midpoint with an XOR,
+ * sin(pi u / 2) is evaluated on [0, 1] by a degree 7 odd minimax polynomial in Q30, and the result is squared.
+ * There are no loads and no branches, and every operand fits in 32 bits, so that each product is a single 32 x 32 ->
+ * 64 bit multiply (SMULL on the Cortex-M3). The polynomial's error is below 6e-7, so the output stays within one LSB
+ * of the ideal curve.
+ * @date 2023-06-16
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+struct PolynomialSine
+{
+  template <typename Table> static inline uint16_t sample(uint32_t phase) { return evaluate(phase); }
+
+  static inline uint16_t evaluate(uint32_t phase)
+  {
+    // Twice the distance from the nearest zero of sin(pi p), as u in [0, 1) in Q31
+    int32_t u = static_cast<int32_t>(phase ^ static_cast<uint32_t>(static_cast<int32_t>(phase) >> 31));
+    int32_t u2 = mulQ31(u, u);
+    int32_t p = C7;
+    p = C5 + mulQ31(p, u2);
+    p = C3 + mulQ31(p, u2);
+    p = C1 + mulQ31(p, u2);
+    int32_t s = mulQ31(p, u); // sin(pi u / 2) in Q30
+    int32_t s2 = static_cast<int32_t>((static_cast<int64_t>(s) * s) >> 30);
+    int64_t v = (static_cast<int64_t>(s2) * 0xffff + (1 << 29)) >> 30; // its square scaled to 0 to 0xffff, rounded
+    return static_cast<uint16_t>(v > 0xffff ? 0xffff : v);
+  }
+
+private:
+  static inline int32_t mulQ31(int32_t a, int32_t b)
+  {
+    return static_cast<int32_t>((static_cast<int64_t>(a) * b) >> 31);
+  }
+
+  // Minimax coefficients of sin(pi u / 2) ~ u (C1 + C3 u^2 + C5 u^4 + C7 u^6) on [0, 1], in Q30
+  static constexpr int32_t C1 = 1686624005;
+  static constexpr int32_t C3 = -693522166;
+  static constexpr int32_t C5 = 85291978;
+  static constexpr int32_t C7 = -4652626;
+};
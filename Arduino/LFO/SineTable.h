@@ -0,0 +1,175 @@
+/**
+ * @file SineTable.h
+ * @author Gino Bollaert
+ * @brief Compile-time generated 16-bit raised cosine tables and interpolation policies
+ * @details RaisedCosineTable<IndexBits, QuarterWave> holds one period of (1 - cos(2 pi x)) / 2 scaled to 0..0xffff,
+ * generated by the compiler and shared by every user of the same configuration. With QuarterWave only the first
+ * quarter period (plus its end point) is stored and the rest is folded at lookup time. The interpolation policies
+ * turn a 32-bit phase into a sample from any such table.
+ * @date 2023-06-14
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+namespace sine_table_detail
+{
+constexpr double Pi = 3.14159265358979323846;
+
+// Taylor series, accurate to double precision for |x| <= pi / 4
+constexpr double taylorCos(double x)
+{
+  double term = 1;
+  double sum = 1;
+  for (int k = 1; k < 12; k++)
+  {
+    term *= -x * x / ((2 * k - 1) * (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double taylorSin(double x)
+{
+  double term = x;
+  double sum = x;
+  for (int k = 1; k < 12; k++)
+  {
+    term *= -x * x / ((2 * k) * (2 * k + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+/** cos(2 pi i / size) for 0 <= i <= size / 4 */
+constexpr double quarterCos(uint32_t i, uint32_t size)
+{
+  return 8 * i <= size ? taylorCos(2 * Pi * i / size) : taylorSin(2 * Pi * (size / 4 - i) / size);
+}
+} // namespace sine_table_detail
+
+template <int Bits, bool QuarterWave = false> class RaisedCosineTable
+{
+public:
+  static_assert(Bits >= 2 && Bits <= 16, "table index must be 2 to 16 bits");
+
+  static constexpr uint32_t IndexBits = Bits;
+  static constexpr uint32_t Size = 1 << IndexBits;
+  static constexpr uint32_t StoredSize = QuarterWave ? Size / 4 + 1 : Size;
+  static constexpr uint16_t MaxValue = 0xffff;
+
+  /** Value at `index` in [0, Size) */
+  static constexpr uint16_t at(uint32_t index)
+  {
+    if constexpr (QuarterWave)
+    {
+      constexpr uint32_t Half = Size / 2;
+      constexpr uint32_t Quarter = Size / 4;
+      // The second half period is the first one inverted, and the first is symmetric about its middle
+      uint16_t invert = index < Half ? 0 : MaxValue;
+      uint32_t i = index & (Half - 1);
+      return invert ^ (i <= Quarter ? Table.values[i] : MaxValue - Table.values[Half - i]);
+    }
+    else
+    {
+      return Table.values[index];
+    }
+  }
+
+private:
+  struct Values
+  {
+    uint16_t values[StoredSize];
+  };
+
+  /** Quarter period value; the midpoint 0x7fff.8 rounds down so that the folded table stays antisymmetric */
+  static constexpr uint16_t quarterValue(uint32_t i)
+  {
+    if (4 * i == Size)
+    {
+      return MaxValue / 2;
+    }
+    double v = (1 - sine_table_detail::quarterCos(i, Size)) / 2;
+    return static_cast<uint16_t>(v * MaxValue + 0.5);
+  }
+
+  static constexpr Values generate()
+  {
+    Values t = {};
+    for (uint32_t i = 0; i < StoredSize; i++)
+    {
+      if (i <= Size / 4)
+      {
+        t.values[i] = quarterValue(i);
+      }
+      else if (i <= Size / 2)
+      {
+        t.values[i] = MaxValue - quarterValue(Size / 2 - i);
+      }
+      else if (i <= 3 * Size / 4)
+      {
+        t.values[i] = MaxValue - quarterValue(i - Size / 2);
+      }
+      else
+      {
+        t.values[i] = quarterValue(Size - i);
+      }
+    }
+    return t;
+  }
+
+  static constexpr Values Table = generate();
+};
+
+/** Nearest lower table entry */
+struct NoInterpolation
+{
+  template <typename Table> static inline uint16_t sample(uint32_t phase)
+  {
+    return Table::at(phase >> (32 - Table::IndexBits));
+  }
+};
+
+/** Linear interpolation between neighbouring entries with a 16-bit fraction */
+struct LinearInterpolation
+{
+  template <typename Table> static inline uint16_t sample(uint32_t phase)
+  {
+    constexpr uint32_t FractionBits = 32 - Table::IndexBits;
+    constexpr uint32_t InterpolateBits = 16;
+    constexpr uint32_t InterpolateSum = 1 << InterpolateBits;
+    uint32_t index0 = phase >> FractionBits;
+    uint32_t index1 = (index0 + 1) % Table::Size;
+    uint32_t mul1 = (phase >> (FractionBits - InterpolateBits)) & (InterpolateSum - 1);
+    uint32_t mul0 = InterpolateSum - mul1;
+    return static_cast<uint16_t>((Table::at(index0) * mul0 + Table::at(index1) * mul1) >> InterpolateBits);
+  }
+};
+
+/** Cubic Hermite (Catmull-Rom) interpolation through four neighbouring entries with a 16-bit fraction */
+struct CubicInterpolation
+{
+  template <typename Table> static inline uint16_t sample(uint32_t phase)
+  {
+    constexpr uint32_t FractionBits = 32 - Table::IndexBits;
+    constexpr uint32_t Mask = Table::Size - 1;
+    uint32_t index = phase >> FractionBits;
+    int32_t p0 = Table::at((index - 1) & Mask);
+    int32_t p1 = Table::at(index);
+    int32_t p2 = Table::at((index + 1) & Mask);
+    int32_t p3 = Table::at((index + 2) & Mask);
+    int32_t t = static_cast<int32_t>((phase >> (FractionBits - 16)) & 0xffff);
+
+    // Coefficients are kept at twice their value to stay in integers. They take up to 20 bits, so only their products
+    // with t are widened, each a single 32 x 32 -> 64 bit multiply.
+    int32_t c1 = p2 - p0;
+    int32_t c2 = 2 * p0 - 5 * p1 + 4 * p2 - p3;
+    int32_t c3 = (p3 - p0) + 3 * (p1 - p2);
+    int32_t v = static_cast<int32_t>((static_cast<int64_t>(c3) * t + 0x8000) >> 16) + c2;
+    v = static_cast<int32_t>((static_cast<int64_t>(v) * t + 0x8000) >> 16) + c1;
+    v = static_cast<int32_t>((static_cast<int64_t>(v) * t + 0x10000) >> 17) + p1;
+    return static_cast<uint16_t>(v < 0 ? 0 : (v > 0xffff ? 0xffff : v));
+  }
+};
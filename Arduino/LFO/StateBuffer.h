@@ -0,0 +1,54 @@
+/**
+ * @file StateBuffer.h
+ * @author Gino Bollaert
+ * @brief Lock-free snapshot hand-over from loop() to the timer interrupt
+ * @details The control side builds a complete new value and publishes it with one atomic exchange of a slot index;
+ * the interrupt side picks up the newest published value with one atomic exchange, and only when there is a new one.
+ * Three slots mean neither side ever waits for the other and the interrupt never sees a partially written value, even
+ * if a publish lands while it is still reading its current snapshot.
+ * @date 2023-06-07
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+
+template <typename T> class StateBuffer
+{
+public:
+  StateBuffer(const T& initial = T())
+  {
+    for (T& slot : _slots)
+    {
+      slot = initial;
+    }
+  }
+
+  /** Control side: copies `value` into the back slot and swaps it in as the latest snapshot */
+  void publish(const T& value)
+  {
+    _slots[_back] = value;
+    _back = _middle.exchange(_back | FreshBit, std::memory_order_acq_rel) & IndexMask;
+  }
+
+  /** Interrupt side: returns the latest published snapshot, valid until the next call */
+  const T& acquire()
+  {
+    if (_middle.load(std::memory_order_relaxed) & FreshBit)
+    {
+      _front = _middle.exchange(_front, std::memory_order_acq_rel) & IndexMask;
+    }
+    return _slots[_front];
+  }
+
+private:
+  static constexpr uint8_t FreshBit = 0x4;
+  static constexpr uint8_t IndexMask = 0x3;
+
+  T _slots[3];
+  uint8_t _front = 0;
+  uint8_t _back = 1;
+  std::atomic<uint8_t> _middle{2};
+};
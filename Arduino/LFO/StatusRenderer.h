@@ -0,0 +1,82 @@
+/**
+ * @file StatusRenderer.h
+ * @author Gino Bollaert
+ * @brief Rate-limited, non-blocking two-line status display
+ * @details MIDI handlers call set() with a title and a value, which only records them. update(), called once per
+ * loop(), draws a new frame at most every FrameIntervalMs and sends it one page per call, so that no single
+ * loop() iteration waits for more than one page on the display bus.
+ * @date 2023-06-21
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include "DisplayInterface.h"
+#include <string.h>
+
+class StatusRenderer
+{
+public:
+  static constexpr uint32_t FrameIntervalMs = 30;
+  static constexpr int MaxTextLength = DisplayText::Capacity;
+  static constexpr int ValueLine = 16;
+
+  explicit StatusRenderer(DisplayInterface& display) : _display(display) {}
+
+  /** Shows `title` above `value` from the next frame on; does nothing if neither changed */
+  void set(const char* title, const char* value)
+  {
+    if (strncmp(title, _title, MaxTextLength) == 0 && strncmp(value, _value, MaxTextLength) == 0)
+    {
+      return;
+    }
+    copy(_title, title);
+    copy(_value, value);
+    _dirty = true;
+  }
+
+  /** Sends the next page of a frame in progress, or starts a new frame if one is due */
+  void update(uint32_t now)
+  {
+    if (_page < _pageCount)
+    {
+      _display.showPage(_page++);
+      return;
+    }
+    if (!_dirty || now - _frameStart < FrameIntervalMs)
+    {
+      return;
+    }
+    _frameStart = now;
+    _dirty = false;
+    _display.clear();
+    _display.drawString(0, 0, _title);
+    _display.drawString(0, ValueLine, _value);
+    _pageCount = _display.pageCount();
+    _page = 0;
+    _display.showPage(_page++);
+  }
+
+  /** True while a frame is being sent or a changed status is waiting for one */
+  bool busy() const { return _dirty || _page < _pageCount; }
+
+private:
+  static void copy(char* to, const char* from)
+  {
+    int length = 0;
+    while (length < MaxTextLength && from[length])
+    {
+      to[length] = from[length];
+      length++;
+    }
+    to[length] = '\0';
+  }
+
+  DisplayInterface& _display;
+  char _title[MaxTextLength + 1] = {};
+  char _value[MaxTextLength + 1] = {};
+  bool _dirty = false;
+  int _page = 0;
+  int _pageCount = 0;
+  uint32_t _frameStart = 0;
+};
@@ -0,0 +1,201 @@
+/**
+ * @file SysEx.h
+ * @author Gino Bollaert
+ * @brief SysEx bulk dump and load messages, read and written a byte at a time
+ * @details A message is F0, the non-commercial manufacturer ID 7D, the model ID, a format, a command, an index, the
+ * payload packed seven bits to a byte, a checksum and F7. The format is the version of the payload's layout, which
+ * the receiver checks before taking the payload as its own. Packing puts the top bits of up to seven bytes in a leading byte,
+ * bit n for byte n. The checksum makes the 7-bit sum of everything from the command on zero.
+ *
+ * SysExReader unpacks the payload straight into a fixed buffer as the bytes arrive, so nothing but the payload is
+ * kept, and gives up on a message as soon as its header or length shows it is not one it can take. SysExWriter packs
+ * a message into a caller's buffer.
+ * @date 2023-06-30
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+namespace SysEx
+{
+constexpr uint8_t Start = 0xf0;
+constexpr uint8_t End = 0xf7;
+constexpr uint8_t ManufacturerId = 0x7d;
+constexpr uint8_t ModelId = 0x4c;
+
+enum class Command : uint8_t
+{
+  StateRequest = 0x01,  // -> State
+  PresetRequest = 0x02, // index -> Preset, or Nak if the slot is empty
+  BankRequest = 0x03,   // -> Preset for every stored slot, then BankEnd
+  TraceRequest = 0x04,  // index 1 also clears the probes -> Trace, in builds with TRACE_PROBES
+  State = 0x11,         // current settings; loading it applies them, -> Ack or Nak
+  Preset = 0x12,        // index; loading it stores the preset, -> Ack or Nak
+  BankEnd = 0x13,       // one byte, the number of presets sent
+  Trace = 0x14,         // TraceReport (Globals.h)
+  Ack = 0x7e,
+  Nak = 0x7f,
+};
+
+/** Bytes taken by `bytes` bytes once packed seven bits to a byte */
+constexpr uint32_t packedSize(uint32_t bytes) { return bytes / 7 * 8 + (bytes % 7 ? bytes % 7 + 1 : 0); }
+
+/** Length of a whole message, F0 to F7, carrying `payload` bytes */
+constexpr uint32_t messageSize(uint32_t payload) { return 8 + packedSize(payload); }
+} // namespace SysEx
+
+/** Receives the data bytes of one SysEx message at a time, between F0 and F7, with a payload of up to N bytes */
+template <int N>
+class SysExReader
+{
+public:
+  static constexpr int Capacity = N;
+
+  /** Forgets any message in progress, as at F0; the next byte is the first of a new message */
+  void reset()
+  {
+    _position = 0;
+    _sum = 0;
+    _held = -1;
+    _rejected = false;
+  }
+
+  void push(uint8_t byte)
+  {
+    if (_rejected)
+    {
+      return;
+    }
+    if (byte & 0x80)
+    {
+      _rejected = true;
+      return;
+    }
+    // Every byte is held back by one, since the last before F7 is the checksum and not payload
+    if (_held >= 0)
+    {
+      accept(static_cast<uint8_t>(_held));
+    }
+    _held = byte;
+  }
+
+  /**
+   * Ends the message at F7 and readies the reader for the next one; returns true if the message is whole and its
+   * checksum is right, in which case format(), command(), index() and payload() describe it until the next message
+   * starts
+   */
+  bool end()
+  {
+    bool valid = !_rejected && _position >= 5 && _held >= 0 && ((_sum + _held) & 0x7f) == 0 &&
+                 (_position - 5) % 8 != 1;
+    reset();
+    return valid;
+  }
+
+  uint8_t format() const { return _format; }
+  SysEx::Command command() const { return static_cast<SysEx::Command>(_command); }
+  uint8_t index() const { return _index; }
+  const uint8_t* payload() const { return _payload; }
+  /** Payload bytes unpacked so far */
+  int size() const { return _size; }
+
+private:
+  void accept(uint8_t byte)
+  {
+    switch (_position++)
+    {
+      case 0:
+        _size = 0;
+        _rejected = byte != SysEx::ManufacturerId;
+        return;
+      case 1: _rejected = byte != SysEx::ModelId; return;
+      case 2: _format = byte; break;
+      case 3: _command = byte; break;
+      case 4: _index = byte; break;
+      default:
+        if ((_position - 6) % 8 == 0)
+        {
+          _msbs = byte;
+        }
+        else if (_size < N)
+        {
+          _payload[_size++] = byte | ((_msbs << 7) & 0x80);
+          _msbs >>= 1;
+        }
+        else
+        {
+          _rejected = true;
+          return;
+        }
+        break;
+    }
+    _sum += byte;
+  }
+
+  uint8_t _payload[N];
+  uint32_t _position = 0;
+  int _size = 0;
+  int _held = -1;
+  uint8_t _sum = 0;
+  uint8_t _format = 0;
+  uint8_t _command = 0;
+  uint8_t _index = 0;
+  uint8_t _msbs = 0;
+  bool _rejected = false;
+};
+
+/** Builds one SysEx message in a buffer of at least SysEx::messageSize() bytes */
+class SysExWriter
+{
+public:
+  SysExWriter(uint8_t* buffer, uint8_t format, SysEx::Command command, uint8_t index) : _buffer(buffer)
+  {
+    _buffer[_length++] = SysEx::Start;
+    _buffer[_length++] = SysEx::ManufacturerId;
+    _buffer[_length++] = SysEx::ModelId;
+    put(format & 0x7f);
+    put(static_cast<uint8_t>(command));
+    put(index & 0x7f);
+  }
+
+  /** Packs `bytes` bytes of payload; may be called several times */
+  void write(const void* data, uint32_t bytes)
+  {
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+      if (_group == 0)
+      {
+        _msbs = _length;
+        put(0);
+      }
+      _buffer[_msbs] |= (in[i] >> 7) << _group;
+      _sum += (in[i] >> 7) << _group;
+      put(in[i] & 0x7f);
+      _group = _group == 6 ? 0 : _group + 1;
+    }
+  }
+
+  /** Appends the checksum and F7 and returns the length of the message */
+  uint32_t finish()
+  {
+    put((0x80 - (_sum & 0x7f)) & 0x7f);
+    _buffer[_length++] = SysEx::End;
+    return _length;
+  }
+
+private:
+  void put(uint8_t byte)
+  {
+    _buffer[_length++] = byte;
+    _sum += byte;
+  }
+
+  uint8_t* _buffer;
+  uint32_t _length = 0;
+  uint32_t _msbs = 0;
+  uint8_t _sum = 0;
+  int _group = 0;
+};
@@ -0,0 +1,84 @@
+/**
+ * @file TextBuffer.h
+ * @author Gino Bollaert
+ * @brief Fixed-capacity, stack-allocated text for the display and menu paths
+ * @details Replaces Arduino String where text is built on every redraw, so that formatting never touches the heap.
+ * Appending past the capacity truncates silently; the result is always null-terminated.
+ * @date 2023-06-24
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+#include <type_traits>
+
+template <int N>
+class TextBuffer
+{
+public:
+  static constexpr int Capacity = N;
+
+  TextBuffer() = default;
+  TextBuffer(const char* s) { *this += s; }
+
+  const char* c_str() const { return _text; }
+  int length() const { return _length; }
+  void clear()
+  {
+    _length = 0;
+    _text[0] = '\0';
+  }
+
+  TextBuffer& operator+=(const char* s)
+  {
+    while (s && *s && _length < N)
+    {
+      _text[_length++] = *s++;
+    }
+    _text[_length] = '\0';
+    return *this;
+  }
+
+  TextBuffer& operator+=(char c)
+  {
+    if (_length < N)
+    {
+      _text[_length++] = c;
+      _text[_length] = '\0';
+    }
+    return *this;
+  }
+
+  template <int M> TextBuffer& operator+=(const TextBuffer<M>& other) { return *this += other.c_str(); }
+
+  /** Appends an integer in decimal. Values are formatted in 32 bits, which avoids 64-bit division on the target. */
+  template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>> TextBuffer& operator+=(T value)
+  {
+    uint32_t magnitude = static_cast<uint32_t>(value);
+    if (std::is_signed<T>::value && value < 0)
+    {
+      *this += '-';
+      magnitude = 0u - magnitude;
+    }
+    char digits[10];
+    int count = 0;
+    do
+    {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude);
+    while (count)
+    {
+      *this += digits[--count];
+    }
+    return *this;
+  }
+
+private:
+  char _text[N + 1] = {};
+  int _length = 0;
+};
+
+/** Enough for a full line of the 128 pixel wide status display */
+using DisplayText = TextBuffer<23>;
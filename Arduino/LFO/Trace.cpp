@@ -0,0 +1,19 @@
+#include "Trace.h"
+#include <Arduino.h>
+
+// libmaple has no definitions for the Cortex-M3 debug blocks
+#define DEMCR (*(volatile uint32*)0xe000edfc)
+#define DEMCR_TRCENA (1u << 24)
+#define DWT_CTRL (*(volatile uint32*)0xe0001000)
+#define DWT_CTRL_CYCCNTENA (1u << 0)
+#define DWT_CYCCNT (*(volatile uint32*)0xe0001004)
+
+void traceBegin() {
+  DEMCR |= DEMCR_TRCENA;
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+uint32_t traceCycles() {
+  return DWT_CYCCNT;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file Trace.h
+ * @author Gino Bollaert
+ * @brief Cycle counter and timing statistics for the trace probes
+ * @details traceCycles() reads the Cortex-M3 DWT cycle counter on the target (Trace.cpp) and std::chrono, scaled to
+ * F_CPU cycles, on the host (sim/hal/Trace.cpp). Either wraps every 2^32 cycles, about a minute at 72 MHz, so a span
+ * is the unsigned difference of two readings. TraceStats keeps the count, minimum, maximum and total of one probe's
+ * spans and a histogram of their log2, in a fixed size that can be sent as it is.
+ * @date 2023-07-09
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <cinttypes>
+
+/** Starts the cycle counter */
+void traceBegin();
+/** Cycles since traceBegin(), modulo 2^32 */
+uint32_t traceCycles();
+
+struct TraceStats
+{
+  // Bucket 0 counts spans of 0 cycles and bucket n those of 2^(n-1) to 2^n - 1; the last also takes anything longer
+  static constexpr int Buckets = 24;
+
+  uint32_t count = 0;
+  uint32_t min = UINT32_MAX;
+  uint32_t max = 0;
+  uint64_t total = 0;
+  uint32_t histogram[Buckets] = {};
+
+  void reset() { *this = TraceStats(); }
+
+  void record(uint32_t cycles)
+  {
+    count++;
+    min = cycles < min ? cycles : min;
+    max = cycles > max ? cycles : max;
+    total += cycles;
+    int bucket = cycles ? 32 - __builtin_clz(cycles) : 0;
+    histogram[bucket < Buckets ? bucket : Buckets - 1]++;
+  }
+
+  uint32_t mean() const { return count ? static_cast<uint32_t>(total / count) : 0; }
+};
@@ -9,14 +9,29 @@
 
 #pragma once
 
+#include "SineTable.h"
 #include <cinttypes>
 
-template <int N> class WaveTable
+/** Per-phase output scaling for WaveTable::renderFrame(): out = ((sample * mul) >> 16) + offset */
+struct OutputGain
+{
+  uint32_t mul;
+  uint32_t offset;
+};
+
+/**
+ * N phases of one oscillator reading from `Table` (see SineTable.h). sampleIP() and the render functions use
+ * `Interpolation`; sample() always returns the nearest lower table entry.
+ */
+template <int N, typename Table = RaisedCosineTable<8>, typename Interpolation = LinearInterpolation>
+class WaveTable
 {
 public:
   WaveTable(uint32_t sampleRate, float frequency)
   {
     _sampleRate = sampleRate;
+    _deltaPerHz = ((static_cast<uint64_t>(1) << 48) + sampleRate - 1) / sampleRate;
+    _samplesPerMs = ((static_cast<uint64_t>(sampleRate) << 32) + 999) / 1000;
     setFrequency(frequency);
     for (int n = 0; n < N; n++)
     {
@@ -27,17 +42,19 @@ public:
     }
   }
 
-  void setFrequency(float freq)
+  void setFrequency(float freq) { setPhaseDelta(phaseDelta(freq)); }
+  void rampFrequency(float freq, uint32_t ms) { rampPhaseDelta(phaseDelta(freq), ms); }
+
+  /** Sets the phase increment per sample, in units of 2^-32 of a cycle, cancelling any ramp */
+  void setPhaseDelta(uint32_t delta)
   {
-    _frequency = freq;
-    _targetDelta = _phaseDelta = phaseDelta();
+    _targetDelta = _phaseDelta = delta;
     _rampSamples = 0;
   }
 
-  void rampFrequency(float freq, uint32_t ms)
+  void rampPhaseDelta(uint32_t delta, uint32_t ms)
   {
-    _frequency = freq;
-    _targetDelta = phaseDelta();
+    _targetDelta = delta;
     ramp(ms);
   }
 
@@ -47,26 +64,58 @@ public:
     _rampSamples = 0;
   }
 
-  void rampPhaseOffset(float offset, uint32_t ms, int n = 0)
+  void rampPhaseOffset(uint32_t offset, uint32_t ms, int n = 0)
   {
     _targetOffset[n] = offset;
     ramp(ms);
   }
 
-  void resetPhase(uint32_t phase = 0) { _phase = phase; }
-  float frequency() const { return _frequency; }
-  uint32_t phaseOffset(int n = 0) const { return _targetOffset[n]; }
-  uint16_t sample(int n = 0) const { return SineTable[_phasePlusOffset[n] >> FractionBits]; }
+  /** Jumps the phase increment and all N phase offsets to new values, cancelling any ramp */
+  void setPhases(uint32_t delta, const uint32_t* offsets)
+  {
+    _targetDelta = _phaseDelta = delta;
+    for (int n = 0; n < N; n++)
+    {
+      _targetOffset[n] = _phaseOffset[n] = offsets[n];
+    }
+    _rampSamples = 0;
+  }
+
+  /** Ramps the phase increment and all N phase offsets to new targets together */
+  void rampPhases(uint32_t delta, const uint32_t* offsets, uint32_t ms)
+  {
+    _targetDelta = delta;
+    for (int n = 0; n < N; n++)
+    {
+      _targetOffset[n] = offsets[n];
+    }
+    ramp(ms);
+  }
 
-  inline uint16_t sampleIP(int n = 0) const
+  uint32_t phaseDelta(float freq) const
   {
-    uint32_t index0 = _phasePlusOffset[n] >> FractionBits;
-    uint32_t index1 = (index0 + 1) % TableSize;
-    uint32_t mul1 = (_phasePlusOffset[n] >> InterpolateShift) & InterpolateMask;
-    uint32_t mul0 = InterpolateSum - mul1;
-    return static_cast<uint16_t>((SineTable[index0] * mul0 + SineTable[index1] * mul1) >> InterpolateBits);
+    return static_cast<uint32_t>((freq * 0x10000 / _sampleRate) * 0x10000);
   }
 
+  /**
+   * Phase increment for a frequency in Hz as unsigned Q16.16, below half the sample rate. Uses a multiply by the
+   * precomputed 2^48 / rate, rounded up, so no float or divide is involved.
+   */
+  uint32_t phaseDeltaQ16(uint32_t freq) const { return static_cast<uint32_t>((freq * _deltaPerHz) >> 32); }
+
+  void resetPhase(uint32_t phase = 0) { _phase = phase; }
+  /** Moves all N phases by `delta` without touching the frequency or the offsets, to align them to a reference */
+  void nudgePhase(int32_t delta) { _phase += static_cast<uint32_t>(delta); }
+  /** Phase of the oscillator before the per-phase offsets, as of the last advance */
+  uint32_t basePhase() const { return _phase; }
+  float frequency() const { return static_cast<float>(_targetDelta) * _sampleRate / 4294967296.f; }
+  bool ramping() const { return _rampSamples > 0; }
+  uint32_t phaseOffset(int n = 0) const { return _targetOffset[n]; }
+  uint32_t phase(int n = 0) const { return _phasePlusOffset[n]; }
+  uint16_t sample(int n = 0) const { return NoInterpolation::sample<Table>(_phasePlusOffset[n]); }
+
+  inline uint16_t sampleIP(int n = 0) const { return interpolate(_phasePlusOffset[n]); }
+
   void advance()
   {
     if (_rampSamples > 0)
@@ -93,89 +142,106 @@ public:
     }
   }
 
-private:
-  static constexpr uint32_t IndexBits = 8;
-  static constexpr uint32_t FractionBits = 32 - IndexBits;
-  static constexpr uint32_t InterpolateBits = 16;
-  static constexpr uint32_t InterpolateShift = FractionBits - InterpolateBits;
-  static constexpr uint32_t InterpolateSum = (1 << InterpolateBits);
-  static constexpr uint32_t InterpolateMask = InterpolateSum - 1;
-  static constexpr uint32_t TableSize = 1 << IndexBits;
-  /* clang-format off */
-  inline static const uint16_t SineTable[TableSize] = {
-    0x0, 0xa, 0x27, 0x59, 0x9e, 0xf6, 0x163, 0x1e2,
-    0x276, 0x31c, 0x3d6, 0x4a3, 0x583, 0x676, 0x77b, 0x894,
-    0x9be, 0xafb, 0xc4a, 0xdab, 0xf1d, 0x10a1, 0x1236, 0x13dc,
-    0x1592, 0x1759, 0x1930, 0x1b17, 0x1d0e, 0x1f14, 0x2128, 0x234c,
-    0x257d, 0x27bd, 0x2a0a, 0x2c65, 0x2ecc, 0x3140, 0x33c0, 0x364c,
-    0x38e3, 0x3b85, 0x3e32, 0x40e8, 0x43a9, 0x4673, 0x4946, 0x4c21,
-    0x4f04, 0x51ef, 0x54e0, 0x57d9, 0x5ad8, 0x5ddc, 0x60e6, 0x63f4,
-    0x6707, 0x6a1e, 0x6d38, 0x7054, 0x7374, 0x7695, 0x79b8, 0x7cdb,
-    0x7fff, 0x8324, 0x8647, 0x896a, 0x8c8b, 0x8fab, 0x92c7, 0x95e1,
-    0x98f8, 0x9c0b, 0x9f19, 0xa223, 0xa527, 0xa826, 0xab1f, 0xae10,
-    0xb0fb, 0xb3de, 0xb6b9, 0xb98c, 0xbc56, 0xbf17, 0xc1cd, 0xc47a,
-    0xc71c, 0xc9b3, 0xcc3f, 0xcebf, 0xd133, 0xd39a, 0xd5f5, 0xd842,
-    0xda82, 0xdcb3, 0xded7, 0xe0eb, 0xe2f1, 0xe4e8, 0xe6cf, 0xe8a6,
-    0xea6d, 0xec23, 0xedc9, 0xef5e, 0xf0e2, 0xf254, 0xf3b5, 0xf504,
-    0xf641, 0xf76b, 0xf884, 0xf989, 0xfa7c, 0xfb5c, 0xfc29, 0xfce3,
-    0xfd89, 0xfe1d, 0xfe9c, 0xff09, 0xff61, 0xffa6, 0xffd8, 0xfff5,
-    0xffff, 0xfff5, 0xffd8, 0xffa6, 0xff61, 0xff09, 0xfe9c, 0xfe1d,
-    0xfd89, 0xfce3, 0xfc29, 0xfb5c, 0xfa7c, 0xf989, 0xf884, 0xf76b,
-    0xf641, 0xf504, 0xf3b5, 0xf254, 0xf0e2, 0xef5e, 0xedc9, 0xec23,
-    0xea6d, 0xe8a6, 0xe6cf, 0xe4e8, 0xe2f1, 0xe0eb, 0xded7, 0xdcb3,
-    0xda82, 0xd842, 0xd5f5, 0xd39a, 0xd133, 0xcebf, 0xcc3f, 0xc9b3,
-    0xc71c, 0xc47a, 0xc1cd, 0xbf17, 0xbc56, 0xb98c, 0xb6b9, 0xb3de,
-    0xb0fb, 0xae10, 0xab1f, 0xa826, 0xa527, 0xa223, 0x9f19, 0x9c0b,
-    0x98f8, 0x95e1, 0x92c7, 0x8fab, 0x8c8b, 0x896a, 0x8647, 0x8324,
-    0x8000, 0x7cdb, 0x79b8, 0x7695, 0x7374, 0x7054, 0x6d38, 0x6a1e,
-    0x6707, 0x63f4, 0x60e6, 0x5ddc, 0x5ad8, 0x57d9, 0x54e0, 0x51ef,
-    0x4f04, 0x4c21, 0x4946, 0x4673, 0x43a9, 0x40e8, 0x3e32, 0x3b85,
-    0x38e3, 0x364c, 0x33c0, 0x3140, 0x2ecc, 0x2c65, 0x2a0a, 0x27bd,
-    0x257d, 0x234c, 0x2128, 0x1f14, 0x1d0e, 0x1b17, 0x1930, 0x1759,
-    0x1592, 0x13dc, 0x1236, 0x10a1, 0xf1d, 0xdab, 0xc4a, 0xafb,
-    0x9be, 0x894, 0x77b, 0x676, 0x583, 0x4a3, 0x3d6, 0x31c,
-    0x276, 0x1e2, 0x163, 0xf6, 0x9e, 0x59, 0x27, 0xa,
-  };
-  /* clang-format on */
-
-  inline uint32_t phaseDelta() const { return static_cast<uint32_t>((_frequency * 0x10000 / _sampleRate) * 0x10000); }
-  inline uint32_t msToSamples(uint32_t ms) const { return ms * _sampleRate / 1000; }
+  /**
+   * Fused output stage: advances one frame and, in the same pass over the N phases, interpolates, applies
+   * `gains[n]` and drops the low `Shift` bits, writing the result to out[n]. Matches advance() followed by
+   * (((sampleIP(n) * gains[n].mul) >> 16) + gains[n].offset) >> Shift for each phase.
+   */
+  template <int Shift> void renderFrame(const OutputGain* gains, uint16_t* out)
+  {
+    advance();
+    for (int n = 0; n < N; n++)
+    {
+      uint32_t v = ((interpolate(_phasePlusOffset[n]) * gains[n].mul) >> 16) + gains[n].offset;
+      out[n] = static_cast<uint16_t>(v >> Shift);
+    }
+  }
 
-  void ramp(uint32_t ms)
+  /**
+   * Renders `frames` interpolated samples of all N phases into `out`, which is planar: phase n occupies
+   * out[n * frames] to out[n * frames + frames - 1]. The result is identical to calling advance() followed by
+   * sampleIP(n) once per frame.
+   */
+  void renderBlock(uint16_t* out, int frames)
   {
-    _rampSamples = static_cast<int32_t>(msToSamples(ms));
-    if (_rampSamples == 0)
+    int k = 0;
+    for (; k < frames && _rampSamples > 0; k++)
     {
-      _phaseDelta = _targetDelta;
+      advance();
       for (int n = 0; n < N; n++)
       {
-        _phaseOffset[n] = _targetOffset[n];
+        out[n * frames + k] = sampleIP(n);
       }
-      return;
-    }
-    if (_targetDelta >= _phaseDelta)
-    {
-      _frequencyRamp = static_cast<int32_t>(_targetDelta - _phaseDelta) / _rampSamples;
     }
-    else
+    if (k == frames)
     {
-      _frequencyRamp = -static_cast<int32_t>(_phaseDelta - _targetDelta) / _rampSamples;
+      return;
     }
+
+    // Past the ramp the delta and offsets are fixed, so each phase is a plain accumulator
+    _phaseDelta = _targetDelta;
     for (int n = 0; n < N; n++)
     {
-      if (_targetOffset[n] >= _phaseOffset[n])
+      _phaseOffset[n] = _targetOffset[n];
+      uint32_t phase = _phase + _phaseOffset[n];
+      uint16_t* plane = out + n * frames;
+      for (int i = k; i < frames; i++)
       {
-        _offsetRamp[n] = static_cast<int32_t>(_targetOffset[n] - _phaseOffset[n]) / _rampSamples;
+        phase += _phaseDelta;
+        plane[i] = interpolate(phase);
       }
-      else
+      _phasePlusOffset[n] = phase;
+    }
+    _phase += _phaseDelta * static_cast<uint32_t>(frames - k);
+  }
+
+private:
+  static inline uint16_t interpolate(uint32_t phase) { return Interpolation::template sample<Table>(phase); }
+
+  /**
+   * ms * rate / 1000 as a multiply by the precomputed rate / 1000 in Q32, rounded up so whole results are exact. The
+   * product fits in 64 bits for any ramp shorter than 2^32 samples.
+   */
+  inline uint32_t msToSamples(uint32_t ms) const
+  {
+    return static_cast<uint32_t>((ms * _samplesPerMs) >> 32);
+  }
+
+  /** Per-sample step covering the shortest way round from `from` to `to`, given (2^32 - 1) / samples */
+  static inline int32_t rampStep(uint32_t from, uint32_t to, uint32_t reciprocal)
+  {
+    return static_cast<int32_t>((static_cast<int64_t>(static_cast<int32_t>(to - from)) * reciprocal) >> 32);
+  }
+
+  /**
+   * Starts a ramp of `ms` towards the targets. A single 32-bit divide forms (2^32 - 1) / samples; each step is then a
+   * 32 x 32 -> 64 bit multiply, and advance() lands exactly on the targets once the ramp ends. A ramp of one sample
+   * steps straight to the targets, as 2^32 does not fit the reciprocal.
+   */
+  void ramp(uint32_t ms)
+  {
+    _rampSamples = static_cast<int32_t>(msToSamples(ms));
+    if (_rampSamples <= 1)
+    {
+      _phaseDelta = _targetDelta;
+      for (int n = 0; n < N; n++)
       {
-        _offsetRamp[n] = -static_cast<int32_t>(_phaseOffset[n] - _targetOffset[n]) / _rampSamples;
+        _phaseOffset[n] = _targetOffset[n];
       }
+      _rampSamples = 0;
+      return;
+    }
+    uint32_t reciprocal = 0xffffffffu / static_cast<uint32_t>(_rampSamples);
+    _frequencyRamp = rampStep(_phaseDelta, _targetDelta, reciprocal);
+    for (int n = 0; n < N; n++)
+    {
+      _offsetRamp[n] = rampStep(_phaseOffset[n], _targetOffset[n], reciprocal);
     }
   }
 
   uint32_t _sampleRate = 0;
-  float _frequency = 0;
+  uint64_t _deltaPerHz = 0;
+  uint64_t _samplesPerMs = 0;
   uint32_t _phase = 0;
   uint32_t _targetDelta = 0;
   uint32_t _phaseDelta = 0;
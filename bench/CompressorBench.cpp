@@ -0,0 +1,76 @@
+/**
+ * @file CompressorBench.cpp
+ * @author Gino Bollaert
+ * @brief Compressor cost per ADC sample
+ * @details Each iteration runs the compressor over a ring of envelope samples a block at a time, as loop() does.
+ * "per_sample" is the time per ADC sample and "per_block" per control sample. The budget on the STM32 is set by the
+ * ADC rate: a sample arrives every PWM period, 4097 CPU cycles, and loop() has to fit MIDI, the display and the
+ * time taken by the sample interrupt in as well. The per-sample work is one load, compare and select in the peak scan,
+ * a handful of cycles on the Cortex-M3; the per-block work (one 32x32 multiply-shift, a count of leading zeros, a
+ * table lookup) is amortised over CompressorBlock samples. The host times here compare the variants and catch
+ * regressions rather than predict the target's cycle counts.
+ * @date 2023-07-03
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "Compressor.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+constexpr int Block = 16;
+constexpr int Frames = 128;
+constexpr uint32_t ControlRate = 72000000 / 4097 / Block;
+
+std::vector<uint16_t> makeRing(int pinCount)
+{
+    std::vector<uint16_t> ring(Frames * pinCount);
+    for (int i = 0; i < Frames * pinCount; i++)
+    {
+        ring[i] = static_cast<uint16_t>(2048 + 2000 * std::sin(i * 0.05));
+    }
+    return ring;
+}
+
+template <bool Compressing, int PinCount> void BM_CompressorBlock(benchmark::State& state)
+{
+    std::vector<uint16_t> ring = makeRing(PinCount);
+    CompressorParams params;
+    params.attack = Compressor::coefficient(5, ControlRate);
+    params.release = Compressor::coefficient(200, ControlRate);
+    params.threshold = Compressing ? -1024 : 0;
+    params.amount = Compressing ? 0xc000 : 0;
+    Compressor compressor;
+    for (auto _ : state)
+    {
+        for (int frame = 0; frame < Frames; frame += Block)
+        {
+            compressor.processBlock(&ring[frame * PinCount], Block, params, PinCount);
+            benchmark::DoNotOptimize(compressor); // the follower runs even when the gain stays at unity
+        }
+    }
+    const double blocks = static_cast<double>(state.iterations()) * (Frames / Block);
+    state.SetItemsProcessed(static_cast<int64_t>(blocks * Block));
+    state.counters["per_sample"] =
+        benchmark::Counter(blocks * Block, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["per_block"] = benchmark::Counter(blocks, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+void BM_GainComputer(benchmark::State& state)
+{
+    uint32_t x = 1;
+    for (auto _ : state)
+    {
+        x = x * 1664525 + 1013904223;
+        int32_t log = Compressor::log2Q8((x >> 8) | 1);
+        benchmark::DoNotOptimize(Compressor::exp2NegativeQ8(24 * 256 - log));
+    }
+}
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_CompressorBlock, false, 1);
+BENCHMARK_TEMPLATE(BM_CompressorBlock, true, 1);
+BENCHMARK_TEMPLATE(BM_CompressorBlock, true, 4);
+BENCHMARK(BM_GainComputer);
@@ -0,0 +1,110 @@
+/**
+ * @file MenuBench.cpp
+ * @author Gino Bollaert
+ * @brief Settings menu navigation benchmarks
+ * @details Moves the selection across every item of a 200-item menu, one encoder step per iteration.
+ * BM_LinkedListNavigation repeats the list walks the linked SettingsItem API needs for one step: getChild() to find
+ * the new selection, position() to scroll to it and get() for the first visible line. BM_FlatNavigation and
+ * BM_FlatRender run the same step and the redraw of the visible lines through SettingsMenu on its flattened tree.
+ * @date 2023-06-25
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "SettingsMenu.h"
+#include <benchmark/benchmark.h>
+
+namespace
+{
+constexpr int MenuItems = 200;
+
+class NullDisplay : public DisplayInterface
+{
+public:
+    void clear() override {}
+    void clearRect(int x, int y, int w, int h) override {}
+    void show() override {}
+    int width() override { return 128; }
+    int height() override { return 32; }
+    void requestFontHeight(int hgt) override {}
+    int fontHeight() override { return 16; }
+    void drawString(int x, int y, const char* s, Align align = Align::kLeft) override { benchmark::DoNotOptimize(s); }
+};
+
+class BenchMenu : public SettingsMenu
+{
+public:
+    BenchMenu(DisplayInterface* display, RotaryButton& rotary) : SettingsMenu(display, rotary), _rotary(rotary)
+    {
+        for (int i = 0; i < MenuItems; i++)
+        {
+            addChild(new IntSetting("Item", _values[i], 0, 127, i % 128));
+        }
+        show();
+    }
+
+    void step(long pos)
+    {
+        _rotary.resetCounter(pos);
+        applyTurns();
+    }
+
+    void render() { displayMenu(this); }
+    const SettingsItem* selected() const { return selectedItem(); }
+
+private:
+    RotaryButton& _rotary;
+    int _values[MenuItems] = {};
+};
+
+BenchMenu& benchMenu()
+{
+    static NullDisplay display;
+    static RotaryButton rotary(PB12, PB13, PB14, INPUT_PULLUP, false);
+    static BenchMenu menu(&display, rotary);
+    return menu;
+}
+
+void BM_LinkedListNavigation(benchmark::State& state)
+{
+    BenchMenu& menu = benchMenu();
+    int pos = 0;
+    for (auto _ : state)
+    {
+        SettingsItem* item = menu.getChild(pos);
+        int position = item->position();
+        SettingsItem* firstVisible = item->get(position > 0 ? position - 1 : 0);
+        benchmark::DoNotOptimize(firstVisible);
+        pos = pos + 1 < MenuItems ? pos + 1 : 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LinkedListNavigation);
+
+void BM_FlatNavigation(benchmark::State& state)
+{
+    BenchMenu& menu = benchMenu();
+    int pos = 0;
+    for (auto _ : state)
+    {
+        menu.step(pos);
+        benchmark::DoNotOptimize(menu.selected());
+        pos = pos + 1 < MenuItems ? pos + 1 : 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FlatNavigation);
+
+void BM_FlatRender(benchmark::State& state)
+{
+    BenchMenu& menu = benchMenu();
+    int pos = 0;
+    for (auto _ : state)
+    {
+        menu.step(pos);
+        menu.render();
+        pos = pos + 1 < MenuItems ? pos + 1 : 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FlatRender);
+} // namespace
@@ -0,0 +1,85 @@
+/**
+ * @file MidiBench.cpp
+ * @author Gino Bollaert
+ * @brief DIN MIDI parser throughput benchmarks
+ * @details Feeds dense control change streams through MidiStreamParser with the firmware's channel filter.
+ * items_per_second is the rate of parsed control changes and bytes_per_second the raw input rate; a DIN port
+ * delivers at most 3125 bytes/s.
+ * @date 2023-06-19
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "MidiParser.h"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+namespace
+{
+struct CountingHandler : MidiParserHandler
+{
+    static bool CheckChannel(uint8_t channel) { return channel == 0; }
+    static void ControlChange(uint8_t channel, uint8_t controller, uint8_t value)
+    {
+        controlChanges++;
+        checksum += controller ^ value;
+    }
+
+    inline static uint64_t controlChanges = 0;
+    inline static uint32_t checksum = 0;
+};
+
+enum class Stream
+{
+    FullStatus,    // every CC carries its status byte
+    RunningStatus, // one status byte, then controller/value pairs
+    WithClock,     // full status with a 0xf8 clock after every message and inside some, as a DAW sends them
+    MixedChannels, // alternating channels 1 and 2, so half the messages are filtered out
+};
+
+std::vector<uint8_t> makeStream(Stream kind, int messages)
+{
+    std::vector<uint8_t> bytes;
+    for (int i = 0; i < messages; i++)
+    {
+        uint8_t controller = 70 + i % 12;
+        uint8_t value = (i * 37) & 0x7f;
+        if (kind != Stream::RunningStatus || i == 0)
+        {
+            bytes.push_back(kind == Stream::MixedChannels ? 0xb0 | (i & 1) : 0xb0);
+        }
+        bytes.push_back(controller);
+        if (kind == Stream::WithClock && i % 4 == 0)
+        {
+            bytes.push_back(0xf8);
+        }
+        bytes.push_back(value);
+        if (kind == Stream::WithClock)
+        {
+            bytes.push_back(0xf8);
+        }
+    }
+    return bytes;
+}
+
+template <Stream Kind> void BM_MidiStreamParser(benchmark::State& state)
+{
+    const std::vector<uint8_t> stream = makeStream(Kind, 4096);
+    stmlib_midi::MidiStreamParser<CountingHandler> parser;
+    CountingHandler::controlChanges = 0;
+    for (auto _ : state)
+    {
+        for (uint8_t byte : stream)
+        {
+            parser.PushByte(byte);
+        }
+        benchmark::DoNotOptimize(CountingHandler::checksum);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(CountingHandler::controlChanges));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(stream.size()));
+}
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_MidiStreamParser, Stream::FullStatus);
+BENCHMARK_TEMPLATE(BM_MidiStreamParser, Stream::RunningStatus);
+BENCHMARK_TEMPLATE(BM_MidiStreamParser, Stream::WithClock);
+BENCHMARK_TEMPLATE(BM_MidiStreamParser, Stream::MixedChannels);
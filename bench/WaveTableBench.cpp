@@ -0,0 +1,262 @@
+/**
+ * @file WaveTableBench.cpp
+ * @author Gino Bollaert
+ * @brief WaveTable oscillator hot path benchmarks
+ * @details Each iteration processes a batch of frames. "per_sample" is the time per output sample (one phase of
+ * one frame) and items_per_second is the matching sample throughput; the output stage benchmarks report "per_frame",
+ * the time to produce all PWM compare values for one sample.
+ * @date 2023-06-02
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "SinePolynomial.h"
+#include "WaveTable.h"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t SampleRate = 502;
+constexpr int Batch = 64;
+
+// Long enough that a ramp outlasts millions of frames and only rarely needs re-arming
+constexpr uint32_t LongRampMs = 4000000;
+
+template <int N, typename... Policy> void arm(WaveTable<N, Policy...>& lfo, bool ramping)
+{
+    lfo.setFrequency(0.75f);
+    for (int n = 0; n < N; n++)
+    {
+        lfo.setPhaseOffset(n * (0xffffffffu / N), n);
+    }
+    if (ramping)
+    {
+        for (int n = 0; n < N; n++)
+        {
+            lfo.rampPhaseOffset((N - n) * (0xffffffffu / N), LongRampMs, n);
+        }
+        lfo.rampFrequency(6.6f, LongRampMs);
+    }
+}
+
+template <int N, typename... Policy>
+void rearmIfSteady(benchmark::State& state, WaveTable<N, Policy...>& lfo, bool ramping)
+{
+    if (ramping && !lfo.ramping())
+    {
+        state.PauseTiming();
+        arm(lfo, true);
+        state.ResumeTiming();
+    }
+}
+
+void setCounters(benchmark::State& state, int channels)
+{
+    int64_t samples = state.iterations() * Batch * channels;
+    state.SetItemsProcessed(samples);
+    state.counters["per_sample"] =
+        benchmark::Counter(static_cast<double>(samples), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+void setFrameCounters(benchmark::State& state)
+{
+    int64_t frames = state.iterations() * Batch;
+    state.counters["per_frame"] =
+        benchmark::Counter(static_cast<double>(frames), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+template <int N, bool Ramping> void BM_AdvanceSample(benchmark::State& state)
+{
+    WaveTable<N> lfo(SampleRate, 0.75f);
+    arm(lfo, Ramping);
+    for (auto _ : state)
+    {
+        for (int k = 0; k < Batch; k++)
+        {
+            lfo.advance();
+            for (int n = 0; n < N; n++)
+            {
+                benchmark::DoNotOptimize(lfo.sample(n));
+            }
+        }
+        rearmIfSteady(state, lfo, Ramping);
+    }
+    setCounters(state, N);
+}
+
+template <int N, bool Ramping> void BM_AdvanceSampleIP(benchmark::State& state)
+{
+    WaveTable<N> lfo(SampleRate, 0.75f);
+    arm(lfo, Ramping);
+    for (auto _ : state)
+    {
+        for (int k = 0; k < Batch; k++)
+        {
+            lfo.advance();
+            for (int n = 0; n < N; n++)
+            {
+                benchmark::DoNotOptimize(lfo.sampleIP(n));
+            }
+        }
+        rearmIfSteady(state, lfo, Ramping);
+    }
+    setCounters(state, N);
+}
+
+template <int N, bool Ramping> void BM_RenderBlock(benchmark::State& state)
+{
+    WaveTable<N> lfo(SampleRate, 0.75f);
+    std::vector<uint16_t> out(N * Batch);
+    arm(lfo, Ramping);
+    for (auto _ : state)
+    {
+        lfo.renderBlock(out.data(), Batch);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+        rearmIfSteady(state, lfo, Ramping);
+    }
+    setCounters(state, N);
+}
+
+// The ISR output stage before and after fusing: advance, interpolate, gain and PWM quantisation per frame
+constexpr int PwmShift = 4;
+
+template <int N> void initGains(OutputGain* gains)
+{
+    for (int n = 0; n < N; n++)
+    {
+        gains[n] = {0x8000u + n, 0x3fffu - n};
+    }
+}
+
+template <int N> void BM_SeparateOutputStage(benchmark::State& state)
+{
+    WaveTable<N> lfo(SampleRate, 0.75f);
+    uint32_t mul[N];
+    uint32_t offset[N];
+    uint16_t out[N];
+    OutputGain gains[N];
+    initGains<N>(gains);
+    for (int n = 0; n < N; n++)
+    {
+        mul[n] = gains[n].mul;
+        offset[n] = gains[n].offset;
+    }
+    // Like the ISR, which reads them from the State snapshot, the gains must not be constant-folded
+    benchmark::DoNotOptimize(mul);
+    benchmark::DoNotOptimize(offset);
+    arm(lfo, false);
+    for (auto _ : state)
+    {
+        for (int k = 0; k < Batch; k++)
+        {
+            lfo.advance();
+            for (int n = 0; n < N; n++)
+            {
+                auto v = ((lfo.sampleIP(n) * mul[n]) >> 16) + offset[n];
+                out[n] = static_cast<uint16_t>(v >> PwmShift);
+            }
+            benchmark::DoNotOptimize(out);
+            benchmark::ClobberMemory();
+        }
+    }
+    setFrameCounters(state);
+}
+
+template <int N> void BM_FusedOutputStage(benchmark::State& state)
+{
+    WaveTable<N> lfo(SampleRate, 0.75f);
+    uint16_t out[N];
+    OutputGain gains[N];
+    initGains<N>(gains);
+    benchmark::DoNotOptimize(gains);
+    arm(lfo, false);
+    for (auto _ : state)
+    {
+        for (int k = 0; k < Batch; k++)
+        {
+            lfo.template renderFrame<PwmShift>(gains, out);
+            benchmark::DoNotOptimize(out);
+            benchmark::ClobberMemory();
+        }
+    }
+    setFrameCounters(state);
+}
+
+using Table256 = RaisedCosineTable<8>;
+using QuarterTable64 = RaisedCosineTable<6, true>;
+
+// Sample evaluators compared on the same steady-state oscillator: table plus interpolation, or PolynomialSine
+template <int N, typename Table, typename Interpolation> void BM_EvaluatorSampleIP(benchmark::State& state)
+{
+    WaveTable<N, Table, Interpolation> lfo(SampleRate, 0.75f);
+    arm(lfo, false);
+    for (auto _ : state)
+    {
+        for (int k = 0; k < Batch; k++)
+        {
+            lfo.advance();
+            for (int n = 0; n < N; n++)
+            {
+                benchmark::DoNotOptimize(lfo.sampleIP(n));
+            }
+        }
+    }
+    setCounters(state, N);
+}
+
+template <int N, typename Table, typename Interpolation> void BM_EvaluatorRenderBlock(benchmark::State& state)
+{
+    WaveTable<N, Table, Interpolation> lfo(SampleRate, 0.75f);
+    std::vector<uint16_t> out(N * Batch);
+    arm(lfo, false);
+    for (auto _ : state)
+    {
+        lfo.renderBlock(out.data(), Batch);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    setCounters(state, N);
+}
+
+template <int N> void BM_Ramp(benchmark::State& state)
+{
+    WaveTable<N> lfo(SampleRate, 0.75f);
+    float freq[2] = {0.75f, 6.6f};
+    int i = 0;
+    for (auto _ : state)
+    {
+        lfo.rampFrequency(freq[i ^= 1], 2000);
+        benchmark::DoNotOptimize(lfo);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+#define LFO_BENCHMARK_PHASES(N)                                 \
+    BENCHMARK_TEMPLATE(BM_AdvanceSample, N, false);             \
+    BENCHMARK_TEMPLATE(BM_AdvanceSample, N, true);              \
+    BENCHMARK_TEMPLATE(BM_AdvanceSampleIP, N, false);           \
+    BENCHMARK_TEMPLATE(BM_AdvanceSampleIP, N, true);            \
+    BENCHMARK_TEMPLATE(BM_RenderBlock, N, false);               \
+    BENCHMARK_TEMPLATE(BM_RenderBlock, N, true);                \
+    BENCHMARK_TEMPLATE(BM_Ramp, N)
+
+LFO_BENCHMARK_PHASES(1);
+LFO_BENCHMARK_PHASES(9);
+LFO_BENCHMARK_PHASES(32);
+LFO_BENCHMARK_PHASES(128);
+
+BENCHMARK_TEMPLATE(BM_SeparateOutputStage, 9);
+BENCHMARK_TEMPLATE(BM_FusedOutputStage, 9);
+
+#define LFO_BENCHMARK_EVALUATOR(N, Table, Interpolation)                    \
+    BENCHMARK_TEMPLATE(BM_EvaluatorSampleIP, N, Table, Interpolation);     \
+    BENCHMARK_TEMPLATE(BM_EvaluatorRenderBlock, N, Table, Interpolation)
+
+LFO_BENCHMARK_EVALUATOR(9, Table256, LinearInterpolation);
+LFO_BENCHMARK_EVALUATOR(9, QuarterTable64, CubicInterpolation);
+LFO_BENCHMARK_EVALUATOR(9, Table256, PolynomialSine);
+LFO_BENCHMARK_EVALUATOR(128, Table256, LinearInterpolation);
+LFO_BENCHMARK_EVALUATOR(128, QuarterTable64, CubicInterpolation);
+LFO_BENCHMARK_EVALUATOR(128, Table256, PolynomialSine);
@@ -0,0 +1,22 @@
+/**
+ * @file main.cpp
+ * @author Gino Bollaert
+ * @brief Benchmarks entry point
+ * @details
+ * @date 2023-06-02
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include <benchmark/benchmark.h>
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
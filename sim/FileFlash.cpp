@@ -0,0 +1,119 @@
+/**
+ * @file FileFlash.cpp
+ * @author Gino Bollaert
+ * @brief File-backed model of the STM32F1 embedded flash
+ * @details
+ * @date 2023-06-26
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "FileFlash.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace sim
+{
+
+FileFlash::FileFlash(uint32_t pageSize, int pageCount, const std::string& path)
+    : _pageSize(pageSize), _pageCount(pageCount), _image(pageSize * pageCount, 0xff), _erases(pageCount, 0)
+{
+    if (!path.empty())
+    {
+        open(path);
+    }
+}
+
+bool FileFlash::open(const std::string& path)
+{
+    _file.close();
+    _file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (_file)
+    {
+        _file.seekg(0, std::ios::end);
+        if (_file.tellg() == static_cast<std::streamoff>(_image.size()))
+        {
+            _file.seekg(0);
+            _file.read(reinterpret_cast<char*>(_image.data()), _image.size());
+            return static_cast<bool>(_file);
+        }
+        _file.close();
+    }
+    _file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    store(0, static_cast<uint32_t>(_image.size()));
+    return static_cast<bool>(_file);
+}
+
+void FileFlash::read(int page, uint32_t offset, void* data, uint32_t bytes)
+{
+    memcpy(data, &_image[page * _pageSize + offset], bytes);
+    _bytesRead += bytes;
+}
+
+bool FileFlash::erasePage(int page)
+{
+    if (page < 0 || page >= _pageCount)
+    {
+        return false;
+    }
+    std::fill_n(_image.begin() + page * _pageSize, _pageSize, 0xff);
+    _erases[page]++;
+    store(page * _pageSize, _pageSize);
+    return true;
+}
+
+bool FileFlash::program(int page, uint32_t offset, const uint16_t* data, uint32_t count)
+{
+    uint32_t address = page * _pageSize + offset;
+    if ((offset & 1) || page < 0 || page >= _pageCount || offset + 2 * count > _pageSize)
+    {
+        _programErrors++;
+        return false;
+    }
+    bool ok = true;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint16_t current;
+        memcpy(&current, &_image[address + 2 * i], 2);
+        if (current != 0xffff && data[i] != 0)
+        {
+            // Only an erased half-word can be programmed (writing zero is the one exception on the STM32F1)
+            _programErrors++;
+            ok = false;
+            continue;
+        }
+        memcpy(&_image[address + 2 * i], &data[i], 2);
+    }
+    _bytesProgrammed += 2 * count;
+    store(address, 2 * count);
+    return ok;
+}
+
+void FileFlash::eraseAll()
+{
+    std::fill(_image.begin(), _image.end(), 0xff);
+    store(0, static_cast<uint32_t>(_image.size()));
+}
+
+void FileFlash::resetStatistics()
+{
+    std::fill(_erases.begin(), _erases.end(), 0);
+    _bytesProgrammed = 0;
+    _bytesRead = 0;
+    _programErrors = 0;
+}
+
+uint64_t FileFlash::totalErases() const { return std::accumulate(_erases.begin(), _erases.end(), uint64_t(0)); }
+
+void FileFlash::store(uint32_t address, uint32_t bytes)
+{
+    if (!_file.is_open())
+    {
+        return;
+    }
+    _file.seekp(address);
+    _file.write(reinterpret_cast<const char*>(&_image[address]), bytes);
+    _file.flush();
+}
+
+} // namespace sim
@@ -0,0 +1,61 @@
+/**
+ * @file FileFlash.h
+ * @author Gino Bollaert
+ * @brief File-backed model of the STM32F1 embedded flash
+ * @details Keeps an image of the flash in memory and, when given a path, mirrors every erase and program to that
+ * file, so that the contents survive from one run to the next like the real flash survives a power cycle. Programming
+ * a half-word that is not erased fails as it does on the STM32. Erases per page and bytes programmed and read are
+ * counted to measure write amplification and wear.
+ * @date 2023-06-26
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include "FlashDevice.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace sim
+{
+
+class FileFlash : public FlashDevice
+{
+public:
+    FileFlash(uint32_t pageSize, int pageCount, const std::string& path = "");
+
+    /** Mirrors the flash to `path` from now on, loading the file first if it holds an image of the right size */
+    bool open(const std::string& path);
+
+    uint32_t pageSize() const override { return _pageSize; }
+    int pageCount() const override { return _pageCount; }
+    void read(int page, uint32_t offset, void* data, uint32_t bytes) override;
+    bool erasePage(int page) override;
+    bool program(int page, uint32_t offset, const uint16_t* data, uint32_t count) override;
+
+    /** Erases every page without counting it, as the programmer would before flashing a new image */
+    void eraseAll();
+    void resetStatistics();
+
+    uint32_t erases(int page) const { return _erases[page]; }
+    uint64_t totalErases() const;
+    uint64_t bytesProgrammed() const { return _bytesProgrammed; }
+    uint64_t bytesRead() const { return _bytesRead; }
+    uint32_t programErrors() const { return _programErrors; }
+
+private:
+    void store(uint32_t address, uint32_t bytes);
+
+    uint32_t _pageSize;
+    int _pageCount;
+    std::vector<uint8_t> _image;
+    std::fstream _file;
+    std::vector<uint32_t> _erases;
+    uint64_t _bytesProgrammed = 0;
+    uint64_t _bytesRead = 0;
+    uint32_t _programErrors = 0;
+};
+
+} // namespace sim
@@ -0,0 +1,29 @@
+/**
+ * @file Firmware.cpp
+ * @author Gino Bollaert
+ * @brief Builds the LFO sketch for the host
+ * @details The Arduino builder includes <Arduino.h> and generates prototypes for every function in the sketch
+ * before compiling it. This file does the same by hand so that LFO.ino compiles unmodified against the stub HAL.
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include <Arduino.h>
+#include "Globals.h"
+#include "Firmware.h"
+
+void applyControlValue(MidiCC cc, int val);
+void handleControlValue(MidiCC cc, int val);
+void recordSetting(MidiCC cc, int val);
+void saveSettings();
+void applyPreset(const Preset& preset);
+void handleSysExMessage(SysExPort& port);
+void setSysExReply(SysExPort& port, SysEx::Command command, uint8_t index, const void* payload, uint32_t bytes);
+void continueBankDump(SysExPort& port);
+void sendSysExReplies();
+bool updateClockSync();
+#if TRACE_PROBES
+TraceReport readTrace(bool clear);
+#endif
+
+#include "LFO.ino"
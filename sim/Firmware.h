@@ -0,0 +1,17 @@
+/**
+ * @file Firmware.h
+ * @author Gino Bollaert
+ * @brief Entry points of the firmware sketch built for the host
+ * @details
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+void setup();
+void loop();
+void TimerInterrupt();
+void applyControlChanges();
+bool recallPreset(int program);
+bool storePreset(int program);
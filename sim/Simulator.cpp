@@ -0,0 +1,337 @@
+/**
+ * @file Simulator.cpp
+ * @author Gino Bollaert
+ * @brief Virtual clock and peripheral model behind the stub HAL
+ * @details
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "Simulator.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+namespace sim
+{
+
+Simulator& Simulator::instance()
+{
+    static Simulator simulator;
+    return simulator;
+}
+
+Simulator::Simulator() { reset(); }
+
+void Simulator::reset()
+{
+    _cycles = 0;
+    _inInterrupt = false;
+    _interruptsEnabled = true;
+    timer_dev* timers[TimerCount] = {TIMER1, TIMER2, TIMER3, TIMER4};
+    for (int i = 0; i < TimerCount; i++)
+    {
+        *timers[i]->regs.gen = timer_reg_map();
+        std::fill(std::begin(timers[i]->handlers), std::end(timers[i]->handlers), nullptr);
+        _timers[i] = Timer();
+    }
+    _dinQueue.clear();
+    _lastDinArrival = 0;
+    _serialBuffer.clear();
+    _serialOverruns = 0;
+    _usbQueue.clear();
+    _dinTransmitEnd = 0;
+    clearOutput();
+    std::fill(std::begin(_pins), std::end(_pins), 0);
+    std::fill(std::begin(_analog), std::end(_analog), 0);
+    _analogScan = AnalogScan();
+}
+
+int Simulator::indexOf(const timer_dev* dev)
+{
+    const timer_dev* timers[TimerCount] = {TIMER1, TIMER2, TIMER3, TIMER4};
+    for (int i = 0; i < TimerCount; i++)
+    {
+        if (timers[i] == dev)
+        {
+            return i;
+        }
+    }
+    assert(false && "unknown timer");
+    return 0;
+}
+
+uint64_t Simulator::periodCycles(const timer_dev* dev)
+{
+    return static_cast<uint64_t>(dev->regs.gen->PSC + 1) * (dev->regs.gen->ARR + 1);
+}
+
+void Simulator::advance(uint64_t cycles)
+{
+    assert(!_inInterrupt && "the virtual clock cannot be advanced from an interrupt handler");
+    const timer_dev* timers[TimerCount] = {TIMER1, TIMER2, TIMER3, TIMER4};
+    uint64_t target = _cycles + cycles;
+    for (;;)
+    {
+        uint64_t next = target + 1;
+        for (int i = 0; i < TimerCount; i++)
+        {
+            if ((timers[i]->regs.gen->CR1 & TIMER_CR1_CEN) && _timers[i].nextOverflow < next)
+            {
+                next = _timers[i].nextOverflow;
+            }
+        }
+        if (!_dinQueue.empty() && _dinQueue.front().first < next)
+        {
+            next = _dinQueue.front().first;
+        }
+        if (next > target)
+        {
+            break;
+        }
+
+        _cycles = next;
+        while (!_dinQueue.empty() && _dinQueue.front().first <= _cycles)
+        {
+            if (_serialBuffer.size() < SerialBufferSize)
+            {
+                _serialBuffer.push_back(_dinQueue.front().second);
+            }
+            else
+            {
+                _serialOverruns++;
+            }
+            _dinQueue.pop_front();
+        }
+        for (int i = 0; i < TimerCount; i++)
+        {
+            if ((timers[i]->regs.gen->CR1 & TIMER_CR1_CEN) && _timers[i].nextOverflow == _cycles)
+            {
+                overflow(i);
+            }
+        }
+    }
+    _cycles = target;
+}
+
+void Simulator::overflow(int index)
+{
+    timer_dev* timers[TimerCount] = {TIMER1, TIMER2, TIMER3, TIMER4};
+    timer_dev* dev = timers[index];
+    Timer& timer = _timers[index];
+    timer.overflows++;
+    timer.nextOverflow += periodCycles(dev);
+    if (dev == TIMER1 && timer.repetition > 0)
+    {
+        timer.repetition--;
+    }
+    else
+    {
+        timer.repetition = dev->regs.adv->RCR & 0xff;
+        timer.updates++;
+        for (int c = 0; c < 4; c++)
+        {
+            timer.active[c] = static_cast<uint16_t>(dev->regs.gen->CCR[c]);
+        }
+        if (dev == TIMER3)
+        {
+            convertAnalogScan();
+        }
+        if (dev == TIMER1 && (dev->regs.adv->CR2 & TIMER_CR2_MMS) == TIMER_CR2_MMS_UPDATE)
+        {
+            resetSlaves();
+        }
+        fireUpdate(index);
+    }
+    if (_periodCallback)
+    {
+        _periodCallback(dev);
+    }
+}
+
+void Simulator::resetSlaves()
+{
+    // ITR0 of TIMER2 to TIMER4 is TIMER1's trigger output. The reset reinitializes the counter and generates an
+    // update event, which is modelled as an overflow that falls due now.
+    timer_dev* timers[TimerCount] = {TIMER1, TIMER2, TIMER3, TIMER4};
+    for (int i = 1; i < TimerCount; i++)
+    {
+        const timer_reg_map* regs = timers[i]->regs.gen;
+        if ((regs->CR1 & TIMER_CR1_CEN) && (regs->SMCR & TIMER_SMCR_TS) == TIMER_SMCR_TS_ITR0 &&
+            (regs->SMCR & TIMER_SMCR_SMS) == TIMER_SMCR_SMS_RESET)
+        {
+            _timers[i].nextOverflow = _cycles;
+            overflow(i);
+        }
+    }
+}
+
+void Simulator::startAnalogScan(const uint8_t* pins, int pinCount, uint16_t* buffer, int frames)
+{
+    _analogScan.pins.assign(pins, pins + pinCount);
+    _analogScan.buffer = buffer;
+    _analogScan.frames = frames;
+    _analogScan.frame = 0;
+}
+
+int Simulator::analogScanRemaining() const
+{
+    const int pinCount = static_cast<int>(_analogScan.pins.size());
+    return (_analogScan.frames - _analogScan.frame) * pinCount;
+}
+
+void Simulator::convertAnalogScan()
+{
+    if (_analogScan.buffer == nullptr)
+    {
+        return;
+    }
+    const int pinCount = static_cast<int>(_analogScan.pins.size());
+    for (int i = 0; i < pinCount; i++)
+    {
+        _analogScan.buffer[_analogScan.frame * pinCount + i] = _analog[_analogScan.pins[i]] & 0xfff;
+    }
+    _analogScan.frame = (_analogScan.frame + 1) % _analogScan.frames;
+}
+
+void Simulator::fireUpdate(int index)
+{
+    timer_dev* timers[TimerCount] = {TIMER1, TIMER2, TIMER3, TIMER4};
+    voidFuncPtr handler = timers[index]->handlers[TIMER_UPDATE_INTERRUPT];
+    if (!handler)
+    {
+        return;
+    }
+    Timer& timer = _timers[index];
+    if (!_interruptsEnabled || _inInterrupt)
+    {
+        timer.pending = true;
+        return;
+    }
+    timer.pending = false;
+    _inInterrupt = true;
+    auto start = std::chrono::steady_clock::now();
+    handler();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    _inInterrupt = false;
+    timer.stats.count++;
+    timer.stats.totalNs += static_cast<uint64_t>(ns);
+    timer.stats.maxNs = std::max(timer.stats.maxNs, static_cast<uint64_t>(ns));
+}
+
+void Simulator::sendDin(uint64_t at, const uint8_t* bytes, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        _lastDinArrival = std::max(at, _lastDinArrival) + DinByteCycles;
+        _dinQueue.emplace_back(_lastDinArrival, bytes[i]);
+    }
+}
+
+void Simulator::sendUsb(uint64_t at, const uint8_t* bytes, size_t length)
+{
+    auto it = std::upper_bound(
+        _usbQueue.begin(), _usbQueue.end(), at, [](uint64_t t, const Arrival& arrival) { return t < arrival.at; });
+    _usbQueue.insert(it, Arrival{at, std::vector<uint8_t>(bytes, bytes + length)});
+}
+
+uint16_t Simulator::activeCompare(const timer_dev* dev, uint8_t channel) const
+{
+    return _timers[indexOf(dev)].active[channel - 1];
+}
+
+uint64_t Simulator::overflows(const timer_dev* dev) const { return _timers[indexOf(dev)].overflows; }
+uint64_t Simulator::updates(const timer_dev* dev) const { return _timers[indexOf(dev)].updates; }
+
+const Simulator::InterruptStats& Simulator::interruptStats(const timer_dev* dev) const
+{
+    return _timers[indexOf(dev)].stats;
+}
+
+Simulator::InterruptStats Simulator::totalInterruptStats() const
+{
+    InterruptStats total;
+    for (const Timer& timer : _timers)
+    {
+        total.count += timer.stats.count;
+        total.totalNs += timer.stats.totalNs;
+        total.maxNs = std::max(total.maxNs, timer.stats.maxNs);
+    }
+    return total;
+}
+
+int Simulator::serialRead()
+{
+    if (_serialBuffer.empty())
+    {
+        return -1;
+    }
+    uint8_t byte = _serialBuffer.front();
+    _serialBuffer.pop_front();
+    return byte;
+}
+
+void Simulator::clearOutput()
+{
+    _dinOutput.clear();
+    _usbOutput.clear();
+}
+
+size_t Simulator::transmitDin(const uint8_t* bytes, size_t length)
+{
+    size_t sent = 0;
+    while (sent < length && _dinTransmitEnd <= _cycles + DinByteCycles)
+    {
+        _dinTransmitEnd = std::max(_dinTransmitEnd, _cycles) + DinByteCycles;
+        _dinOutput.emplace_back(_dinTransmitEnd, bytes[sent++]);
+    }
+    return sent;
+}
+
+bool Simulator::receiveUsb(std::vector<uint8_t>& message)
+{
+    if (_usbQueue.empty() || _usbQueue.front().at > _cycles)
+    {
+        return false;
+    }
+    message = std::move(_usbQueue.front().bytes);
+    _usbQueue.pop_front();
+    return true;
+}
+
+void Simulator::timerRestarted(timer_dev* dev)
+{
+    Timer& timer = _timers[indexOf(dev)];
+    timer.nextOverflow = _cycles + periodCycles(dev);
+    timer.repetition = dev == TIMER1 ? dev->regs.adv->RCR & 0xff : 0;
+    for (int c = 0; c < 4; c++)
+    {
+        timer.active[c] = static_cast<uint16_t>(dev->regs.gen->CCR[c]);
+    }
+}
+
+void Simulator::stall(uint64_t cycles)
+{
+    bool enabled = _interruptsEnabled;
+    setInterruptsEnabled(false);
+    advance(cycles);
+    setInterruptsEnabled(enabled);
+}
+
+void Simulator::setInterruptsEnabled(bool enabled)
+{
+    _interruptsEnabled = enabled;
+    if (!enabled || _inInterrupt)
+    {
+        return;
+    }
+    for (int i = 0; i < TimerCount; i++)
+    {
+        if (_timers[i].pending)
+        {
+            fireUpdate(i);
+        }
+    }
+}
+
+} // namespace sim
@@ -0,0 +1,172 @@
+/**
+ * @file Simulator.h
+ * @author Gino Bollaert
+ * @brief Virtual clock and peripheral model behind the stub HAL
+ * @details Time advances only through advance(), which walks the timer overflows and MIDI arrivals that fall due in
+ * order, latching compare values and firing update interrupts exactly as the STM32 timers would. TIMER1, the only
+ * advanced timer, honours its repetition counter: an update event (compare preload and interrupt) is generated only
+ * once every RCR + 1 overflows. With its trigger output on update, each of those update events resets the other
+ * timers that are slaves of it in reset mode, as an update event of their own. Host time spent
+ * inside each interrupt handler is measured so the ISR cost can be profiled.
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include "FileFlash.h"
+#include <Arduino.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace sim
+{
+
+class Simulator
+{
+public:
+    static constexpr uint64_t CyclesPerMs = F_CPU / 1000;
+    static constexpr uint64_t CyclesPerUs = F_CPU / 1000000;
+    static constexpr uint64_t DinByteCycles = F_CPU / 31250 * 10;
+    static constexpr int TimerCount = 4;
+    static constexpr size_t SerialBufferSize = 64;
+    // Estimated Cortex-M3 cost of taking one timer interrupt: exception entry (12) and exit (10) plus the libmaple
+    // dispatcher reading and clearing the status flags before calling the handler (~20)
+    static constexpr uint64_t InterruptOverheadCycles = 42;
+    // STM32F103C8: 64 pages of 1 KB
+    static constexpr uint32_t FlashPageSize = 1024;
+    static constexpr int FlashPages = 64;
+
+    struct InterruptStats
+    {
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+    };
+
+    using PeriodCallback = std::function<void(timer_dev*)>;
+
+    static Simulator& instance();
+
+    /**
+     * Returns the model to power-on state: time zero, timers stopped, input and output queues empty. Flash and the
+     * image size are kept.
+     */
+    void reset();
+
+    uint64_t cycles() const { return _cycles; }
+    uint32_t millis() const { return static_cast<uint32_t>(_cycles / CyclesPerMs); }
+    uint32_t micros() const { return static_cast<uint32_t>(_cycles / CyclesPerUs); }
+    static uint64_t msToCycles(double ms) { return static_cast<uint64_t>(ms * CyclesPerMs); }
+
+    /** Runs the peripherals for `cycles` CPU cycles */
+    void advance(uint64_t cycles);
+    void advanceMs(double ms) { advance(msToCycles(ms)); }
+
+    /** Queues bytes on the DIN input (Serial3); they arrive back to back at 31250 baud starting at `at` */
+    void sendDin(uint64_t at, const uint8_t* bytes, size_t length);
+    /** Queues one USB MIDI message, delivered by the next USBMIDI::poll() after `at` */
+    void sendUsb(uint64_t at, const uint8_t* bytes, size_t length);
+
+    /** Bytes the firmware sent on the DIN output (Serial3), each with the time its stop bit ends */
+    const std::vector<std::pair<uint64_t, uint8_t>>& dinOutput() const { return _dinOutput; }
+    /** USB MIDI event packets the firmware sent, four bytes each */
+    const std::vector<uint32_t>& usbOutput() const { return _usbOutput; }
+    void clearOutput();
+
+    /** Called after every counter overflow of a running timer, once its compare values are latched */
+    void setPeriodCallback(PeriodCallback callback) { _periodCallback = std::move(callback); }
+
+    uint16_t activeCompare(const timer_dev* dev, uint8_t channel) const;
+    uint64_t overflows(const timer_dev* dev) const;
+    uint64_t updates(const timer_dev* dev) const;
+    const InterruptStats& interruptStats(const timer_dev* dev) const;
+    InterruptStats totalInterruptStats() const;
+    uint32_t serialOverruns() const { return _serialOverruns; }
+    FileFlash& flash() { return _flash; }
+    /** Size of the sketch's image at the start of the flash, 0 by default so that every page is free for data */
+    uint32_t imageBytes() const { return _imageBytes; }
+    void setImageBytes(uint32_t bytes) { _imageBytes = bytes; }
+
+    uint8_t pin(uint8_t pin) const { return _pins[pin]; }
+    void setPin(uint8_t pin, uint8_t value) { _pins[pin] = value; }
+    uint16_t analog(uint8_t pin) const { return _analog[pin]; }
+    void setAnalog(uint8_t pin, uint16_t value) { _analog[pin] = value; }
+    /**
+     * ADC1 in scan mode, triggered by TIMER3's update event, with DMA into a circular buffer: from now on every TIMER3
+     * overflow converts `pins` in order into the next frame of `buffer`, wrapping after `frames` frames. The
+     * conversions complete at the overflow rather than a few microseconds after it.
+     */
+    void startAnalogScan(const uint8_t* pins, int pinCount, uint16_t* buffer, int frames);
+    /** Transfers left before the DMA channel wraps, as its CNDTR register counts them down */
+    int analogScanRemaining() const;
+
+    /* HAL side */
+    int serialAvailable() const { return static_cast<int>(_serialBuffer.size()); }
+    int serialRead();
+    bool receiveUsb(std::vector<uint8_t>& message);
+    /** Takes as many bytes as the USART can buffer right now: one shifting out and one in the data register */
+    size_t transmitDin(const uint8_t* bytes, size_t length);
+    void transmitUsb(uint32_t packet) { _usbOutput.push_back(packet); }
+    void timerRestarted(timer_dev* dev);
+    void setInterruptsEnabled(bool enabled);
+    /** Advances the clock with interrupts held off, as while the CPU waits for a flash operation */
+    void stall(uint64_t cycles);
+
+private:
+    struct Timer
+    {
+        uint64_t nextOverflow = 0;
+        uint64_t overflows = 0;
+        uint64_t updates = 0;
+        uint32_t repetition = 0;
+        uint16_t active[4] = {};
+        bool pending = false;
+        InterruptStats stats;
+    };
+
+    struct AnalogScan
+    {
+        std::vector<uint8_t> pins;
+        uint16_t* buffer = nullptr;
+        int frames = 0;
+        int frame = 0;
+    };
+
+    struct Arrival
+    {
+        uint64_t at;
+        std::vector<uint8_t> bytes;
+    };
+
+    Simulator();
+    static int indexOf(const timer_dev* dev);
+    static uint64_t periodCycles(const timer_dev* dev);
+    void overflow(int index);
+    void resetSlaves();
+    void fireUpdate(int index);
+    void convertAnalogScan();
+
+    uint64_t _cycles = 0;
+    bool _inInterrupt = false;
+    bool _interruptsEnabled = true;
+    Timer _timers[TimerCount];
+    PeriodCallback _periodCallback;
+    std::deque<std::pair<uint64_t, uint8_t>> _dinQueue;
+    uint64_t _lastDinArrival = 0;
+    std::deque<uint8_t> _serialBuffer;
+    uint32_t _serialOverruns = 0;
+    std::deque<Arrival> _usbQueue;
+    uint64_t _dinTransmitEnd = 0;
+    std::vector<std::pair<uint64_t, uint8_t>> _dinOutput;
+    std::vector<uint32_t> _usbOutput;
+    uint8_t _pins[BOARD_NR_GPIO_PINS] = {};
+    uint16_t _analog[BOARD_NR_GPIO_PINS] = {};
+    AnalogScan _analogScan;
+    FileFlash _flash{FlashPageSize, FlashPages};
+    uint32_t _imageBytes = 0;
+};
+
+} // namespace sim
@@ -0,0 +1,21 @@
+/**
+ * @file AnalogDma.cpp
+ * @author Gino Bollaert
+ * @brief Host implementation of AnalogDma on the simulator's ADC model
+ * @details The simulator converts the pins' analog values into the buffer on every TIMER3 overflow and counts the
+ * transfers down as the DMA channel does, so frame() reads the same as on the STM32.
+ * @date 2023-07-03
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "AnalogDma.h"
+#include "Simulator.h"
+
+using sim::Simulator;
+
+void AnalogDma::begin() { Simulator::instance().startAnalogScan(_pins, _pinCount, _buffer, _frames); }
+
+int AnalogDma::frame() const
+{
+    return (_pinCount * _frames - Simulator::instance().analogScanRemaining()) / _pinCount;
+}
@@ -0,0 +1,250 @@
+/**
+ * @file Arduino.h
+ * @author Gino Bollaert
+ * @brief Host stub of the STM32 (libmaple) Arduino core used by the firmware simulator
+ * @details Only the subset of the API used by the firmware is provided. Time is virtual: millis(), micros() and
+ * delay() are driven by sim::Simulator, and timers are modelled at register level so that compare values and update
+ * interrupts behave as on the board.
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#define F_CPU 72000000UL
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef void (*voidFuncPtr)();
+
+#define HIGH 0x1
+#define LOW 0x0
+
+// Arduino binary literals (binary.h)
+#define B10 2
+#define B11 3
+
+enum WiringPinMode
+{
+    OUTPUT,
+    OUTPUT_OPEN_DRAIN,
+    INPUT,
+    INPUT_ANALOG,
+    INPUT_PULLUP,
+    INPUT_PULLDOWN,
+    INPUT_FLOATING,
+    PWM,
+    PWM_OPEN_DRAIN,
+};
+
+enum ExtIntTriggerMode
+{
+    RISING,
+    FALLING,
+    CHANGE,
+};
+
+/* clang-format off */
+enum
+{
+    PA0, PA1, PA2, PA3, PA4, PA5, PA6, PA7, PA8, PA9, PA10, PA11, PA12, PA13, PA14, PA15,
+    PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7, PB8, PB9, PB10, PB11, PB12, PB13, PB14, PB15,
+    PC13, PC14, PC15,
+    BOARD_NR_GPIO_PINS
+};
+/* clang-format on */
+
+/* Timers */
+
+enum timer_interrupt_id
+{
+    TIMER_UPDATE_INTERRUPT,
+    TIMER_CC1_INTERRUPT,
+    TIMER_CC2_INTERRUPT,
+    TIMER_CC3_INTERRUPT,
+    TIMER_CC4_INTERRUPT,
+    TIMER_COM_INTERRUPT,
+    TIMER_TRG_INTERRUPT,
+    TIMER_BREAK_INTERRUPT,
+};
+
+struct timer_reg_map
+{
+    uint32_t CR1;
+    uint32_t CR2;
+    uint32_t SMCR;
+    uint32_t DIER;
+    uint32_t EGR;
+    uint32_t CNT;
+    uint32_t PSC;
+    uint32_t ARR;
+    uint32_t RCR;
+    uint32_t CCR[4];
+};
+typedef timer_reg_map timer_adv_reg_map;
+typedef timer_reg_map timer_gen_reg_map;
+
+#define TIMER_CR1_CEN (1U << 0)
+#define TIMER_CR2_MMS (0x7U << 4)
+#define TIMER_CR2_MMS_UPDATE (0x2U << 4)
+#define TIMER_SMCR_TS (0x7U << 4)
+#define TIMER_SMCR_TS_ITR0 (0x0U << 4)
+#define TIMER_SMCR_SMS 0x7U
+#define TIMER_SMCR_SMS_RESET 0x4U
+#define TIMER_EGR_UG (1U << 0)
+
+struct timer_dev
+{
+    union
+    {
+        timer_adv_reg_map* adv;
+        timer_gen_reg_map* gen;
+    } regs;
+    voidFuncPtr handlers[8];
+};
+
+extern timer_dev* const TIMER1;
+extern timer_dev* const TIMER2;
+extern timer_dev* const TIMER3;
+extern timer_dev* const TIMER4;
+
+void timer_pause(timer_dev* dev);
+void timer_resume(timer_dev* dev);
+void timer_set_prescaler(timer_dev* dev, uint16_t psc);
+void timer_set_reload(timer_dev* dev, uint16_t arr);
+void timer_set_compare(timer_dev* dev, uint8_t channel, uint16_t value);
+uint16_t timer_get_compare(timer_dev* dev, uint8_t channel);
+void timer_cc_enable(timer_dev* dev, uint8_t channel);
+void timer_generate_update(timer_dev* dev);
+void timer_attach_interrupt(timer_dev* dev, uint8_t interrupt, voidFuncPtr handler);
+void timer_detach_interrupt(timer_dev* dev, uint8_t interrupt);
+
+struct stm32_pin_info
+{
+    timer_dev* timer_device;
+    uint8_t timer_channel;
+};
+
+extern const stm32_pin_info PIN_MAP[BOARD_NR_GPIO_PINS];
+
+/* GPIO, time and interrupts */
+
+void pinMode(uint8_t pin, WiringPinMode mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+uint32_t digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void noInterrupts();
+void interrupts();
+inline int digitalPinToInterrupt(int pin) { return pin; }
+void attachInterrupt(uint8_t pin, voidFuncPtr handler, ExtIntTriggerMode mode);
+void detachInterrupt(uint8_t pin);
+
+/* String */
+
+// Like the core's String, a non-empty string always owns a heap buffer. std::string would keep short text in its
+// small-string buffer and hide those allocations from the host tests.
+class String
+{
+public:
+    String() = default;
+    String(const char* s) : _s(s ? s : "") { own(); }
+    String(const std::string& s) : _s(s) { own(); }
+    String(const String& other) : _s(other._s) { own(); }
+    String(String&& other) = default;
+    explicit String(char c) : _s(1, c) { own(); }
+    explicit String(int value, unsigned char base = 10) : _s(toString(value, base)) { own(); }
+    explicit String(unsigned int value, unsigned char base = 10) : _s(toString(value, base)) { own(); }
+    explicit String(long value, unsigned char base = 10) : _s(toString(value, base)) { own(); }
+    explicit String(unsigned long value, unsigned char base = 10) : _s(toString(value, base)) { own(); }
+    explicit String(unsigned char value, unsigned char base = 10) : _s(toString(value, base)) { own(); }
+    explicit String(float value, unsigned char decimals = 2);
+
+    String& operator=(const String& other)
+    {
+        _s = other._s;
+        own();
+        return *this;
+    }
+    String& operator=(String&& other) = default;
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return static_cast<unsigned int>(_s.size()); }
+
+    String& operator+=(const String& rhs)
+    {
+        _s += rhs._s;
+        own();
+        return *this;
+    }
+    String& operator+=(const char* rhs)
+    {
+        _s += rhs;
+        own();
+        return *this;
+    }
+    String& operator+=(char rhs)
+    {
+        _s += rhs;
+        own();
+        return *this;
+    }
+
+    friend String operator+(const String& lhs, const String& rhs) { return String(lhs._s + rhs._s); }
+    friend String operator+(const String& lhs, const char* rhs) { return String(lhs._s + rhs); }
+    friend bool operator==(const String& lhs, const String& rhs) { return lhs._s == rhs._s; }
+
+private:
+    static std::string toString(long long value, unsigned char base);
+
+    void own()
+    {
+        if (!_s.empty())
+        {
+            _s.reserve(std::max<size_t>(_s.size(), sizeof(std::string)));
+        }
+    }
+
+    std::string _s;
+};
+
+/* Serial */
+
+struct usart_dev
+{
+    int port;
+};
+
+/** Non-blocking: writes only what the USART can take without waiting and returns how many bytes that was */
+uint32 usart_tx(usart_dev* dev, const uint8* buf, uint32 len);
+
+class HardwareSerial
+{
+public:
+    explicit HardwareSerial(int port) : _port(port), _dev{port} {}
+
+    void begin(uint32_t baud);
+    int available();
+    int read();
+    size_t write(uint8_t byte);
+    size_t write(const char* s);
+    usart_dev* c_dev() { return &_dev; }
+
+private:
+    int _port;
+    usart_dev _dev;
+};
+
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
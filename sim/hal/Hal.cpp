@@ -0,0 +1,361 @@
+/**
+ * @file Hal.cpp
+ * @author Gino Bollaert
+ * @brief Host implementation of the stub Arduino, USBComposite and U8g2 APIs
+ * @details
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <USBMIDI.h>
+#include "Simulator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using sim::Simulator;
+
+/* Timers */
+
+namespace
+{
+timer_reg_map timerRegisters[Simulator::TimerCount] = {};
+timer_dev timerDevices[Simulator::TimerCount] = {
+    {{&timerRegisters[0]}, {}},
+    {{&timerRegisters[1]}, {}},
+    {{&timerRegisters[2]}, {}},
+    {{&timerRegisters[3]}, {}},
+};
+} // namespace
+
+timer_dev* const TIMER1 = &timerDevices[0];
+timer_dev* const TIMER2 = &timerDevices[1];
+timer_dev* const TIMER3 = &timerDevices[2];
+timer_dev* const TIMER4 = &timerDevices[3];
+
+/* clang-format off */
+const stm32_pin_info PIN_MAP[BOARD_NR_GPIO_PINS] = {
+    {&timerDevices[1], 1}, // PA0
+    {&timerDevices[1], 2}, // PA1
+    {&timerDevices[1], 3}, // PA2
+    {&timerDevices[1], 4}, // PA3
+    {nullptr, 0},          // PA4
+    {nullptr, 0},          // PA5
+    {&timerDevices[2], 1}, // PA6
+    {&timerDevices[2], 2}, // PA7
+    {&timerDevices[0], 1}, // PA8
+    {&timerDevices[0], 2}, // PA9
+    {&timerDevices[0], 3}, // PA10
+    {nullptr, 0},          // PA11
+    {nullptr, 0},          // PA12
+    {nullptr, 0},          // PA13
+    {nullptr, 0},          // PA14
+    {nullptr, 0},          // PA15
+    {&timerDevices[2], 3}, // PB0
+    {&timerDevices[2], 4}, // PB1
+    {nullptr, 0},          // PB2
+    {nullptr, 0},          // PB3
+    {nullptr, 0},          // PB4
+    {nullptr, 0},          // PB5
+    {&timerDevices[3], 1}, // PB6
+    {&timerDevices[3], 2}, // PB7
+    {&timerDevices[3], 3}, // PB8
+    {&timerDevices[3], 4}, // PB9
+    {nullptr, 0},          // PB10
+    {nullptr, 0},          // PB11
+    {nullptr, 0},          // PB12
+    {nullptr, 0},          // PB13
+    {nullptr, 0},          // PB14
+    {nullptr, 0},          // PB15
+    {nullptr, 0},          // PC13
+    {nullptr, 0},          // PC14
+    {nullptr, 0},          // PC15
+};
+/* clang-format on */
+
+void timer_pause(timer_dev* dev) { dev->regs.gen->CR1 &= ~TIMER_CR1_CEN; }
+
+void timer_resume(timer_dev* dev)
+{
+    dev->regs.gen->CR1 |= TIMER_CR1_CEN;
+    Simulator::instance().timerRestarted(dev);
+}
+
+void timer_set_prescaler(timer_dev* dev, uint16_t psc) { dev->regs.gen->PSC = psc; }
+void timer_set_reload(timer_dev* dev, uint16_t arr) { dev->regs.gen->ARR = arr; }
+void timer_set_compare(timer_dev* dev, uint8_t channel, uint16_t value) { dev->regs.gen->CCR[channel - 1] = value; }
+uint16_t timer_get_compare(timer_dev* dev, uint8_t channel) { return dev->regs.gen->CCR[channel - 1]; }
+void timer_cc_enable(timer_dev* dev, uint8_t channel) {}
+
+void timer_generate_update(timer_dev* dev)
+{
+    dev->regs.gen->CNT = 0;
+    Simulator::instance().timerRestarted(dev);
+}
+
+void timer_attach_interrupt(timer_dev* dev, uint8_t interrupt, voidFuncPtr handler)
+{
+    dev->handlers[interrupt] = handler;
+    dev->regs.gen->DIER |= 1U << interrupt;
+}
+
+void timer_detach_interrupt(timer_dev* dev, uint8_t interrupt)
+{
+    dev->regs.gen->DIER &= ~(1U << interrupt);
+    dev->handlers[interrupt] = nullptr;
+}
+
+/* GPIO, time and interrupts */
+
+void pinMode(uint8_t pin, WiringPinMode mode)
+{
+    if (mode == INPUT_PULLUP)
+    {
+        Simulator::instance().setPin(pin, HIGH);
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) { Simulator::instance().setPin(pin, value ? HIGH : LOW); }
+uint32_t digitalRead(uint8_t pin) { return Simulator::instance().pin(pin); }
+uint16_t analogRead(uint8_t pin) { return Simulator::instance().analog(pin); }
+uint32_t millis() { return Simulator::instance().millis(); }
+uint32_t micros() { return Simulator::instance().micros(); }
+void delay(uint32_t ms) { Simulator::instance().advance(ms * Simulator::CyclesPerMs); }
+void delayMicroseconds(uint32_t us) { Simulator::instance().advance(us * Simulator::CyclesPerUs); }
+void noInterrupts() { Simulator::instance().setInterruptsEnabled(false); }
+void interrupts() { Simulator::instance().setInterruptsEnabled(true); }
+void attachInterrupt(uint8_t pin, voidFuncPtr handler, ExtIntTriggerMode mode) {}
+void detachInterrupt(uint8_t pin) {}
+
+/* String */
+
+String::String(float value, unsigned char decimals)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, static_cast<double>(value));
+    _s = buffer;
+    own();
+}
+
+std::string String::toString(long long value, unsigned char base)
+{
+    if (base == 10)
+    {
+        return std::to_string(value);
+    }
+    unsigned long long v = static_cast<unsigned long long>(value);
+    if (value < 0)
+    {
+        v &= 0xffffffffULL;
+    }
+    std::string s;
+    do
+    {
+        s.insert(s.begin(), "0123456789abcdef"[v % base]);
+        v /= base;
+    } while (v);
+    return s;
+}
+
+/* Serial */
+
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+HardwareSerial Serial3(3);
+
+void HardwareSerial::begin(uint32_t baud) {}
+int HardwareSerial::available() { return _port == 3 ? Simulator::instance().serialAvailable() : 0; }
+int HardwareSerial::read() { return _port == 3 ? Simulator::instance().serialRead() : -1; }
+size_t HardwareSerial::write(uint8_t byte) { return 1; }
+size_t HardwareSerial::write(const char* s) { return strlen(s); }
+
+uint32 usart_tx(usart_dev* dev, const uint8* buf, uint32 len)
+{
+    return dev->port == 3 ? static_cast<uint32>(Simulator::instance().transmitDin(buf, len)) : len;
+}
+
+/* USB */
+
+USBCompositeDevice USBComposite;
+
+size_t USBCompositeSerial::write(const char* s)
+{
+    fputs(s, stderr);
+    return strlen(s);
+}
+
+void USBMIDI::poll()
+{
+    std::vector<uint8_t> message;
+    while (Simulator::instance().receiveUsb(message))
+    {
+        dispatch(message.data(), message.size());
+    }
+}
+
+void USBMIDI::dispatch(const uint8_t* bytes, size_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+    unsigned int channel = bytes[0] & 0x0f;
+    auto data = [&](size_t i) { return i < length ? static_cast<unsigned int>(bytes[i]) : 0u; };
+    switch (bytes[0] & 0xf0)
+    {
+        case 0x80: handleNoteOff(channel, data(1), data(2)); break;
+        case 0x90: handleNoteOn(channel, data(1), data(2)); break;
+        case 0xa0: handleVelocityChange(channel, data(1), data(2)); break;
+        case 0xb0: handleControlChange(channel, data(1), data(2)); break;
+        case 0xc0: handleProgramChange(channel, data(1)); break;
+        case 0xd0: handleAfterTouch(channel, data(1)); break;
+        case 0xe0: handlePitchChange((data(2) << 7) | data(1)); break;
+        case 0xf0:
+            if (bytes[0] == 0xf0)
+            {
+                size_t i = 1;
+                for (; i < length && bytes[i] != 0xf7; i++)
+                {
+                    handleSysExData(bytes[i]);
+                }
+                if (i < length)
+                {
+                    handleSysExEnd();
+                }
+            }
+            else if (bytes[0] == 0xf8)
+            {
+                handleSync();
+            }
+            else if (bytes[0] == 0xfa)
+            {
+                handleStart();
+            }
+            else if (bytes[0] == 0xfb)
+            {
+                handleContinue();
+            }
+            else if (bytes[0] == 0xfc)
+            {
+                handleStop();
+            }
+            break;
+    }
+}
+
+void USBMIDI::sendNoteOn(unsigned int channel, unsigned int note, unsigned int velocity) {}
+void USBMIDI::sendNoteOff(unsigned int channel, unsigned int note, unsigned int velocity) {}
+void USBMIDI::sendControlChange(unsigned int channel, unsigned int controller, unsigned int value) {}
+void USBMIDI::sendProgramChange(unsigned int channel, unsigned int program) {}
+void USBMIDI::writePacket(uint32 packet) { Simulator::instance().transmitUsb(packet); }
+
+/* U8g2 */
+
+namespace
+{
+const u8g2_cb_t rotation0 = {};
+
+// I2C at 400 kHz moves 9 bits per byte; each tile row also costs a few command bytes to address the page
+constexpr uint64_t I2cByteCycles = F_CPU / 400000 * 9;
+constexpr int RowOverheadBytes = 4;
+} // namespace
+
+const u8g2_cb_t* const U8G2_R0 = &rotation0;
+const uint8_t u8g2_font_crox1h_tf[] = {0};
+
+bool U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::begin()
+{
+    clearBuffer();
+    sendBuffer();
+    return true;
+}
+
+void U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::clearBuffer() { memset(_buffer, 0, sizeof(_buffer)); }
+
+void U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::clear()
+{
+    clearBuffer();
+    sendBuffer();
+}
+
+void U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::sendBuffer() { updateDisplayArea(0, 0, TileWidth, TileHeight); }
+
+void U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::updateDisplayArea(uint8_t tx, uint8_t ty, uint8_t tw, uint8_t th)
+{
+    int bytes = 0;
+    for (int row = ty; row < ty + th && row < TileHeight; row++)
+    {
+        int first = tx * 8;
+        int count = std::min(tw * 8, Width - first);
+        memcpy(_panel + row * Width + first, _buffer + row * Width + first, count);
+        bytes += count;
+        transfer(count + RowOverheadBytes);
+    }
+    _bytesSent += bytes;
+    _transfers++;
+}
+
+void U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::transfer(int bytes)
+{
+    Simulator::instance().advance(static_cast<uint64_t>(bytes) * I2cByteCycles);
+}
+
+int U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::getStrWidth(const char* s) const
+{
+    return static_cast<int>(strlen(s)) * GlyphAdvance;
+}
+
+int U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::drawStr(int x, int y, const char* s)
+{
+    int start = x;
+    for (; *s; s++, x += GlyphAdvance)
+    {
+        uint8_t c = static_cast<uint8_t>(*s);
+        if (c == ' ')
+        {
+            continue;
+        }
+        for (int column = 0; column < GlyphAdvance - 1; column++)
+        {
+            uint8_t bits = static_cast<uint8_t>(c * 37 + column * 101 + (c >> 3)) | 0x01;
+            for (int row = 0; row < GlyphHeight; row++)
+            {
+                if (bits & (1 << row))
+                {
+                    drawPixel(x + column, y - GlyphHeight + row);
+                }
+            }
+        }
+    }
+    return x - start;
+}
+
+void U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::drawPixel(int x, int y)
+{
+    if (x < 0 || x >= Width || y < 0 || y >= Height)
+    {
+        return;
+    }
+    uint8_t bit = static_cast<uint8_t>(1 << (y % 8));
+    if (_drawColor)
+    {
+        _buffer[(y / 8) * Width + x] |= bit;
+    }
+    else
+    {
+        _buffer[(y / 8) * Width + x] &= static_cast<uint8_t>(~bit);
+    }
+}
+
+void U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C::drawBox(int x, int y, int w, int h)
+{
+    for (int row = y; row < y + h; row++)
+    {
+        for (int column = x; column < x + w; column++)
+        {
+            drawPixel(column, row);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/**
+ * @file InternalFlash.cpp
+ * @author Gino Bollaert
+ * @brief Host implementation of InternalFlash on the simulator's file-backed flash
+ * @details Code runs from flash on the STM32, so the CPU, interrupts included, stalls for as long as an erase or a
+ * program takes. The typical times from the STM32F103 datasheet are charged to the virtual clock that way. The
+ * sketch's image takes the first Simulator::imageBytes() of the flash.
+ * @date 2023-06-26
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "InternalFlash.h"
+#include "Simulator.h"
+
+using sim::Simulator;
+
+namespace
+{
+constexpr uint64_t ProgramHalfWordCycles = 52 * Simulator::CyclesPerUs;
+constexpr uint64_t ErasePageCycles = 20 * Simulator::CyclesPerMs;
+} // namespace
+
+void InternalFlash::read(int page, uint32_t offset, void* data, uint32_t bytes)
+{
+    Simulator::instance().flash().read(_firstPage + page, offset, data, bytes);
+}
+
+int InternalFlash::firstFreePage()
+{
+    return static_cast<int>((Simulator::instance().imageBytes() + PageSize - 1) / PageSize);
+}
+
+bool InternalFlash::erasePage(int page)
+{
+    if (!writable(page))
+    {
+        return false;
+    }
+    Simulator::instance().stall(ErasePageCycles);
+    return Simulator::instance().flash().erasePage(_firstPage + page);
+}
+
+bool InternalFlash::program(int page, uint32_t offset, const uint16_t* data, uint32_t count)
+{
+    if (!writable(page))
+    {
+        return false;
+    }
+    Simulator::instance().stall(count * ProgramHalfWordCycles);
+    return Simulator::instance().flash().program(_firstPage + page, offset, data, count);
+}
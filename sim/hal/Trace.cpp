@@ -0,0 +1,26 @@
+/**
+ * @file Trace.cpp
+ * @author Gino Bollaert
+ * @brief Host implementation of the trace cycle counter
+ * @details Host time, not the simulator's virtual clock, scaled to F_CPU cycles: the probes time the firmware code as
+ * the host runs it, like the simulator's interrupt statistics.
+ * @date 2023-07-09
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "Trace.h"
+#include <Arduino.h>
+#include <chrono>
+
+namespace
+{
+std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+}
+
+void traceBegin() { epoch = std::chrono::steady_clock::now(); }
+
+uint32_t traceCycles()
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    return static_cast<uint32_t>(static_cast<uint64_t>(ns) * (F_CPU / 1000000) / 1000);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file U8g2lib.h
+ * @author Gino Bollaert
+ * @brief Host stub of the U8g2 SSD1306 128x32 full-buffer driver used by the firmware simulator
+ * @details The frame buffer uses the SSD1306 page layout. Text is drawn with a synthetic fixed-width font so that
+ * different strings produce different pixels. Every transfer to the panel is counted and advances the virtual clock
+ * by its duration on a 400 kHz I2C bus.
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+struct u8g2_cb_t
+{
+};
+
+extern const u8g2_cb_t* const U8G2_R0;
+extern const uint8_t u8g2_font_crox1h_tf[];
+
+#define U8X8_PIN_NONE 255
+
+class U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C
+{
+public:
+    static constexpr int Width = 128;
+    static constexpr int Height = 32;
+    static constexpr int TileWidth = Width / 8;
+    static constexpr int TileHeight = Height / 8;
+    static constexpr int BufferSize = Width * TileHeight;
+
+    U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C(const u8g2_cb_t*, uint8_t reset, uint8_t clock, uint8_t data) {}
+
+    bool begin();
+    void setFontMode(uint8_t) {}
+    void setFont(const uint8_t*) {}
+    void clearBuffer();
+    void clear();
+    void sendBuffer();
+    void updateDisplayArea(uint8_t tx, uint8_t ty, uint8_t tw, uint8_t th);
+    uint8_t* getBufferPtr() { return _buffer; }
+    uint8_t getBufferTileWidth() const { return TileWidth; }
+    uint8_t getBufferTileHeight() const { return TileHeight; }
+    int getDisplayWidth() const { return Width; }
+    int getDisplayHeight() const { return Height; }
+    int getMaxCharHeight() const { return 12; }
+    int getStrWidth(const char* s) const;
+    int drawStr(int x, int y, const char* s);
+    void drawPixel(int x, int y);
+    void setDrawColor(uint8_t color) { _drawColor = color; }
+    void drawBox(int x, int y, int w, int h);
+
+    /** Frame as last received by the panel, in the same layout as the buffer */
+    const uint8_t* panel() const { return _panel; }
+    uint32_t bytesSent() const { return _bytesSent; }
+    uint32_t transfers() const { return _transfers; }
+    void resetStatistics()
+    {
+        _bytesSent = 0;
+        _transfers = 0;
+    }
+
+private:
+    static constexpr int GlyphAdvance = 6;
+    static constexpr int GlyphHeight = 8;
+
+    void transfer(int bytes);
+
+    uint8_t _buffer[BufferSize] = {};
+    uint8_t _panel[BufferSize] = {};
+    uint32_t _bytesSent = 0;
+    uint32_t _transfers = 0;
+    uint8_t _drawColor = 1;
+};
@@ -0,0 +1,66 @@
+/**
+ * @file USBMIDI.h
+ * @author Gino Bollaert
+ * @brief Host stub of the USBComposite MIDI class used by the firmware simulator
+ * @details poll() dispatches the USB MIDI messages queued in sim::Simulator whose arrival time has passed, through the
+ * same virtual handlers as the USBComposite library, and packets written by the firmware are collected there.
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+class USBCompositeDevice
+{
+public:
+    void clear() {}
+    void setManufacturerString(const char*) {}
+    void setProductString(const char*) {}
+    void setVendorId(uint16_t) {}
+    void setProductId(uint16_t) {}
+    bool begin() { return true; }
+};
+
+extern USBCompositeDevice USBComposite;
+
+class USBCompositeSerial
+{
+public:
+    bool registerComponent() { return true; }
+    size_t write(const char* s);
+};
+
+class USBMIDI
+{
+public:
+    virtual ~USBMIDI() = default;
+
+    bool registerComponent() { return true; }
+    void poll();
+
+    void sendNoteOn(unsigned int channel, unsigned int note, unsigned int velocity);
+    void sendNoteOff(unsigned int channel, unsigned int note, unsigned int velocity);
+    void sendControlChange(unsigned int channel, unsigned int controller, unsigned int value);
+    void sendProgramChange(unsigned int channel, unsigned int program);
+    /** Sends one USB MIDI event packet: cable and code index in the low byte, then up to three MIDI bytes */
+    void writePacket(uint32 packet);
+
+    virtual void handleNoteOff(unsigned int channel, unsigned int note, unsigned int velocity) {}
+    virtual void handleNoteOn(unsigned int channel, unsigned int note, unsigned int velocity) {}
+    virtual void handleVelocityChange(unsigned int channel, unsigned int note, unsigned int velocity) {}
+    virtual void handleControlChange(unsigned int channel, unsigned int controller, unsigned int value) {}
+    virtual void handleProgramChange(unsigned int channel, unsigned int program) {}
+    virtual void handleAfterTouch(unsigned int channel, unsigned int velocity) {}
+    virtual void handlePitchChange(unsigned int pitch) {}
+    virtual void handleSysExData(unsigned char data) {}
+    virtual void handleSysExEnd(void) {}
+    virtual void handleSync(void) {}
+    virtual void handleStart(void) {}
+    virtual void handleContinue(void) {}
+    virtual void handleStop(void) {}
+
+private:
+    void dispatch(const uint8_t* bytes, size_t length);
+};
@@ -0,0 +1,57 @@
+/**
+ * @file Yabl.h
+ * @author Gino Bollaert
+ * @brief Host stub of the Yabl button library used by the firmware simulator
+ * @details The button reads its pin through digitalRead() and reports a press/release pair as a single tap.
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+typedef uint8_t Event;
+
+constexpr Event PRESS = 0x01;
+constexpr Event RELEASE = 0x02;
+constexpr Event SINGLE_TAP = 0x04;
+constexpr Event DOUBLE_TAP = 0x08;
+constexpr Event HOLD = 0x10;
+constexpr Event LONG_RELEASE = 0x20;
+constexpr Event USER_EVENT = 0x40;
+constexpr Event ALL_EVENTS = 0xff;
+
+class Button
+{
+public:
+    virtual ~Button() = default;
+
+    void attach(int pin, int mode = INPUT_PULLUP)
+    {
+        _pin = pin;
+        pinMode(pin, static_cast<WiringPinMode>(mode));
+        _down = digitalRead(pin) == LOW;
+    }
+
+    bool update()
+    {
+        _triggered = 0;
+        bool down = digitalRead(_pin) == LOW;
+        if (down != _down)
+        {
+            _down = down;
+            _triggered = down ? PRESS : (RELEASE | SINGLE_TAP);
+        }
+        return _triggered != 0;
+    }
+
+    bool triggered(Event event) const { return (_triggered & event) != 0; }
+    bool down() const { return _down; }
+    void reset() { _triggered = 0; }
+
+private:
+    int _pin = 0;
+    bool _down = false;
+    Event _triggered = 0;
+};
@@ -0,0 +1,303 @@
+/**
+ * @file main.cpp
+ * @author Gino Bollaert
+ * @brief Host firmware simulator
+ * @details Runs the firmware against the stub HAL on a virtual clock. TimerInterrupt() fires at the PWM rate exactly
+ * as configured by setupPwms(), loop() is called at a fixed virtual interval and MIDI input is replayed from a script.
+ *
+ * Script lines are `<time ms> <din|usb> <hex bytes...>`, with `#` starting a comment, e.g. `250 din b0 07 40`.
+ * `--cc-flood <hz>` adds a synthetic stream of control changes over DIN, sweeping CC11, CC91 and CC94 in turn.
+ * `--loop-load-us <us>` stands for other work in the main loop: each loop() is followed by that much busy time, during
+ * which interrupts still run and MIDI keeps arriving. With coalescing and a loop slow enough for the flood to repeat a
+ * controller within it, a run that coalesces nothing fails.
+ * `--flash <file>` keeps the flash in a file, so that saved settings carry over to the next run like a power cycle.
+ *
+ * The PWM log starts with a PwmLogHeader followed by one record of PwmOutCount little-endian uint16 compare values
+ * (in PwmOut order) per PWM period, sampled as latched by the timers.
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "Firmware.h"
+#include "Globals.h"
+#include "Simulator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+struct PwmLogHeader
+{
+    char magic[8] = {'L', 'F', 'O', 'P', 'W', 'M', '1', '\0'};
+    uint32_t channels = PwmOutCount;
+    uint32_t cpuHz = F_CPU;
+    uint32_t periodCycles = 0;
+    uint32_t reserved = 0;
+};
+
+struct Options
+{
+    double durationMs = 5000;
+    double loopUs = 50;
+    double loopLoadUs = 0;
+    std::string script;
+    std::string output = "lfo-sim.pwm";
+    double ccFloodHz = 0;
+    std::string flash;
+};
+
+void usage()
+{
+    std::cerr << "usage: lfo-sim [--duration-ms <ms>] [--loop-us <us>] [--loop-load-us <us>] [--midi <script>]\n"
+                 "               [--cc-flood <hz>] [--flash <image>] [--out <pwm log>]\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        if (arg == "--duration-ms")
+        {
+            options.durationMs = std::stod(argv[++i]);
+        }
+        else if (arg == "--loop-us")
+        {
+            options.loopUs = std::stod(argv[++i]);
+        }
+        else if (arg == "--loop-load-us")
+        {
+            options.loopLoadUs = std::stod(argv[++i]);
+        }
+        else if (arg == "--midi")
+        {
+            options.script = argv[++i];
+        }
+        else if (arg == "--cc-flood")
+        {
+            options.ccFloodHz = std::stod(argv[++i]);
+        }
+        else if (arg == "--flash")
+        {
+            options.flash = argv[++i];
+        }
+        else if (arg == "--out")
+        {
+            options.output = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadScript(const std::string& path, sim::Simulator& simulator)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "cannot open " << path << '\n';
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream in(line);
+        double ms;
+        std::string port;
+        if (!(in >> ms))
+        {
+            continue;
+        }
+        if (!(in >> port) || (port != "din" && port != "usb"))
+        {
+            std::cerr << path << ':' << lineNumber << ": expected din or usb\n";
+            return false;
+        }
+        std::vector<uint8_t> bytes;
+        unsigned int byte;
+        while (in >> std::hex >> byte)
+        {
+            bytes.push_back(static_cast<uint8_t>(byte));
+        }
+        uint64_t at = sim::Simulator::msToCycles(ms);
+        if (port == "din")
+        {
+            simulator.sendDin(at, bytes.data(), bytes.size());
+        }
+        else
+        {
+            simulator.sendUsb(at, bytes.data(), bytes.size());
+        }
+    }
+    return true;
+}
+void addCcFlood(double hz, double durationMs, sim::Simulator& simulator)
+{
+    const uint8_t controllers[] = {(uint8_t)MidiCC::Expression, (uint8_t)MidiCC::AutopanWidth,
+                                   (uint8_t)MidiCC::RotaryPhase};
+    int i = 0;
+    for (double ms = 500; ms < durationMs; ms += 1000 / hz, i++)
+    {
+        int step = (i / 3) % 254;
+        uint8_t message[3] = {0xb0, controllers[i % 3], static_cast<uint8_t>(step < 127 ? step : 254 - step)};
+        simulator.sendDin(sim::Simulator::msToCycles(ms), message, sizeof(message));
+    }
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        usage();
+        return 1;
+    }
+
+    sim::Simulator& simulator = sim::Simulator::instance();
+    if (!options.flash.empty() && !simulator.flash().open(options.flash))
+    {
+        std::cerr << "cannot open " << options.flash << '\n';
+        return 1;
+    }
+    if (!options.script.empty() && !loadScript(options.script, simulator))
+    {
+        return 1;
+    }
+    if (options.ccFloodHz > 0)
+    {
+        addCcFlood(options.ccFloodHz, options.durationMs, simulator);
+    }
+
+    std::ofstream log(options.output, std::ios::binary);
+    if (!log)
+    {
+        std::cerr << "cannot create " << options.output << '\n';
+        return 1;
+    }
+    PwmLogHeader header;
+    log.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    uint64_t periods = 0;
+    simulator.setPeriodCallback([&](timer_dev* dev) {
+        if (dev != Pwms[0].timer)
+        {
+            return;
+        }
+        uint16_t record[PwmOutCount];
+        for (int n = 0; n < PwmOutCount; n++)
+        {
+            record[n] = simulator.activeCompare(Pwms[n].timer, Pwms[n].channel);
+        }
+        log.write(reinterpret_cast<const char*>(record), sizeof(record));
+        periods++;
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    setup();
+    uint64_t end = sim::Simulator::msToCycles(options.durationMs);
+    uint64_t loopCycles = std::max<uint64_t>(1, static_cast<uint64_t>(options.loopUs * sim::Simulator::CyclesPerUs));
+    uint64_t loadCycles = static_cast<uint64_t>(options.loopLoadUs * sim::Simulator::CyclesPerUs);
+    uint64_t loops = 0;
+    uint64_t loopBusyCycles = 0; // virtual time loop() and its load took, e.g. blocking display transfers
+    double loopHostNs = 0;
+    while (simulator.cycles() < end)
+    {
+        uint64_t before = simulator.cycles();
+        auto hostBefore = std::chrono::steady_clock::now();
+        loop();
+        loopHostNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - hostBefore).count();
+        simulator.advance(loadCycles);
+        loopBusyCycles += simulator.cycles() - before;
+        loops++;
+        simulator.advance(loopCycles);
+    }
+    double hostMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    header.periodCycles = static_cast<uint32_t>((Pwms[0].timer->regs.gen->PSC + 1) * (Pwms[0].timer->regs.gen->ARR + 1));
+    log.seekp(0);
+    log.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    double seconds = static_cast<double>(simulator.cycles()) / F_CPU;
+    auto isr = simulator.totalInterruptStats();
+    printf("simulated        %.1f ms (host %.1f ms)\n", seconds * 1000, hostMs);
+    printf("pwm periods      %llu (%.1f Hz) -> %s\n",
+        static_cast<unsigned long long>(periods),
+        periods / seconds,
+        options.output.c_str());
+    printf("interrupts       %llu (%.1f /s), mean %.1f ns, max %llu ns\n",
+        static_cast<unsigned long long>(isr.count),
+        isr.count / seconds,
+        isr.count ? static_cast<double>(isr.totalNs) / isr.count : 0.0,
+        static_cast<unsigned long long>(isr.maxNs));
+    printf("interrupt load   %.3f%% of CPU in entry/exit (%llu cycles each)\n",
+        100.0 * isr.count * sim::Simulator::InterruptOverheadCycles / simulator.cycles(),
+        static_cast<unsigned long long>(sim::Simulator::InterruptOverheadCycles));
+    printf("loop calls       %llu, mean %.1f ns host\n", static_cast<unsigned long long>(loops), loopHostNs / loops);
+    printf("loop blocking    %.3f%% of simulated time\n", 100.0 * loopBusyCycles / simulator.cycles());
+    printf("control changes  %u received, %u applied, %u coalesced\n",
+        controlChanges.received(),
+        controlChanges.applied(),
+        controlChanges.coalesced());
+#if TRACE_PROBES
+    // Host time spent applying them and publishing the result, in cycles at F_CPU
+    const TraceStats& controls = trace.probes[(int)TraceProbe::Controls];
+    printf("control path     %u passes, mean %u cycles, %.1f cycles per received control change\n",
+        controls.count,
+        controls.mean(),
+        controlChanges.received() ? static_cast<double>(controls.total) / controlChanges.received() : 0.0);
+#endif
+    printf("serial overruns  %u\n", simulator.serialOverruns());
+    printf("flash            %llu bytes read, %llu bytes programmed, %llu pages erased, settings record #%u\n",
+        static_cast<unsigned long long>(simulator.flash().bytesRead()),
+        static_cast<unsigned long long>(simulator.flash().bytesProgrammed()),
+        static_cast<unsigned long long>(simulator.flash().totalErases()),
+        settingsLog.sequence());
+#if TRACE_PROBES
+    // Host time: how long the firmware code takes to run here, in cycles at F_CPU
+    printf("trace            %u interrupt overruns (deadline %u cycles)\n", trace.overruns, InterruptDeadline);
+    for (int i = 0; i < TraceProbeCount; i++)
+    {
+        const TraceStats& probe = trace.probes[i];
+        printf("  %-14s %u, min %u, mean %u, max %u cycles\n  %-14s",
+            TraceProbeNames[i],
+            probe.count,
+            probe.count ? probe.min : 0,
+            probe.mean(),
+            probe.max,
+            "log2");
+        for (int n = 0; n < TraceStats::Buckets; n++)
+        {
+            if (probe.histogram[n])
+            {
+                printf(" %d:%u", n, probe.histogram[n]);
+            }
+        }
+        printf("\n");
+    }
+#endif
+
+    // The flood sweeps three controllers in turn, so a loop that spans more than three of its messages sees a repeat
+    bool expectCoalescing = CC_COALESCING && (options.loopUs + options.loopLoadUs) * options.ccFloodHz / 1e6 > 3;
+    if (expectCoalescing && controlChanges.coalesced() == 0)
+    {
+        std::cerr << "no control change was coalesced\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file ClockPllTest.cpp
+ * @author Gino Bollaert
+ * @brief MIDI clock PLL tests on synthesized tick streams
+ * @details Each tick is stamped at its true time plus a latency: up to 1 ms for USB, which delivers once per frame, or
+ * up to 100 us for DIN read from loop(). The filtered tick times are compared with the true ones less the mean
+ * latency, which no receiver can tell from the clock itself. The clock starts close to the wrap of micros().
+ * @date 2023-07-07
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "ClockPll.h"
+#include <cmath>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <random>
+
+namespace
+{
+constexpr double StartUs = 4294000000.0;
+
+double tickUs(double bpm) { return 60e6 / bpm / ClockPll::TicksPerBeat; }
+
+/** Lock and tracking of a clock run through the PLL */
+struct Result
+{
+    int lockTicks = -1;   // ticks taken to lock, 0 if locked already
+    double tempoError = 0; // worst relative period error once settled
+    double phaseError = 0; // worst filtered tick time error once settled, us
+    double phaseRms = 0;   // its RMS
+    int positionErrors = 0;
+};
+
+class Clock
+{
+public:
+    Clock(double bpm, double latencyUs) : _period(tickUs(bpm)), _latency(0, latencyUs), _meanLatency(latencyUs / 2) {}
+
+    void setTempo(double bpm) { _period = tickUs(bpm); }
+    /** Every `n`th tick is lost */
+    void loseEvery(int n) { _lose = n; }
+    /** A stray tick arrives a quarter of the way through every `n`th period */
+    void strayEvery(int n) { _stray = n; }
+
+    /** Runs `ticks` ticks through `pll`; errors are measured from tick `settle` on */
+    Result run(ClockPll& pll, int ticks, int settle)
+    {
+        Result result;
+        result.lockTicks = pll.locked() ? 0 : -1;
+        double sumSquares = 0;
+        int measured = 0;
+        for (int i = 0; i < ticks; i++, _count++, _time += _period)
+        {
+            if (_stray && _count % _stray == _stray / 2)
+            {
+                pll.tick(stamp(_time - _period * 3 / 4));
+            }
+            if (_lose && _count % _lose == _lose - 1)
+            {
+                continue;
+            }
+            pll.tick(stamp(_time));
+            if (pll.locked() && result.lockTicks < 0)
+            {
+                result.lockTicks = i + 1;
+            }
+            if (i < settle)
+            {
+                continue;
+            }
+            double tempoError = std::fabs(pll.period() / 256.0 / _period - 1);
+            uint32_t expected = static_cast<uint32_t>(static_cast<uint64_t>(_time + _meanLatency + 0.5));
+            double phaseError = static_cast<int32_t>(pll.time() - expected);
+            result.tempoError = std::max(result.tempoError, tempoError);
+            result.phaseError = std::max(result.phaseError, std::fabs(phaseError));
+            result.positionErrors += pll.position() != _count % ClockPll::PositionWrap;
+            sumSquares += phaseError * phaseError;
+            measured++;
+        }
+        result.phaseRms = measured ? std::sqrt(sumSquares / measured) : 0;
+        return result;
+    }
+
+private:
+    uint32_t stamp(double time) { return static_cast<uint32_t>(static_cast<uint64_t>(time + _latency(_random))); }
+
+    double _period;
+    double _time = StartUs;
+    int _count = 0;
+    int _lose = 0;
+    int _stray = 0;
+    std::mt19937 _random{11};
+    std::uniform_real_distribution<double> _latency;
+    double _meanLatency;
+};
+
+void print(const char* name, const Result& result)
+{
+    std::printf("[          ] %s: locked in %d ticks, tempo within %.3f%%, tick time within %.0f us (%.0f us RMS)\n",
+                name, result.lockTicks, result.tempoError * 100, result.phaseError, result.phaseRms);
+}
+} // namespace
+
+TEST(ClockPll, LocksToASteadyClock)
+{
+    ClockPll pll;
+    pll.reset();
+    Clock clock(120, 0);
+    Result result = clock.run(pll, 2 * ClockPll::TicksPerBeat, ClockPll::TicksPerBeat);
+    EXPECT_EQ(result.lockTicks, ClockPll::LockTicks);
+    EXPECT_LT(result.tempoError, 0.001);
+    EXPECT_LE(result.phaseError, 2);
+    EXPECT_EQ(result.positionErrors, 0);
+    // 2 Hz for a beat, 0.5 Hz for a bar, and the phase of each on the last tick
+    EXPECT_NEAR(pll.rate(24) / 65536.0, 2, 0.002);
+    EXPECT_NEAR(pll.rate(96) / 65536.0, 0.5, 0.0005);
+    EXPECT_EQ(pll.phase(24), (23ull << 32) / 24);
+    EXPECT_NEAR(pll.phasePerUs(24) / 256.0, 4294967296.0 / 500000, 2);
+    print("120 BPM", result);
+}
+
+TEST(ClockPll, FiltersUsbJitter)
+{
+    ClockPll pll;
+    pll.reset();
+    Clock clock(120, 1000);
+    // A minute of clock, measured after eight beats
+    Result result = clock.run(pll, 120 * ClockPll::TicksPerBeat, 8 * ClockPll::TicksPerBeat);
+    EXPECT_EQ(result.lockTicks, ClockPll::LockTicks);
+    EXPECT_LT(result.tempoError, 0.005);
+    EXPECT_LT(result.phaseError, 350);
+    EXPECT_EQ(result.positionErrors, 0);
+    print("120 BPM, 0-1 ms latency", result);
+}
+
+TEST(ClockPll, FiltersDinJitter)
+{
+    ClockPll pll;
+    pll.reset();
+    Clock clock(174, 100);
+    Result result = clock.run(pll, 174 * ClockPll::TicksPerBeat, 8 * ClockPll::TicksPerBeat);
+    EXPECT_LT(result.tempoError, 0.001);
+    EXPECT_LT(result.phaseError, 50);
+    print("174 BPM, 0-100 us latency", result);
+}
+
+TEST(ClockPll, FollowsATempoChange)
+{
+    ClockPll pll;
+    pll.reset();
+    Clock clock(120, 1000);
+    clock.run(pll, 32 * ClockPll::TicksPerBeat, 0);
+    // Up 5% and settled again within eight beats
+    clock.setTempo(126);
+    Result result = clock.run(pll, 32 * ClockPll::TicksPerBeat, 8 * ClockPll::TicksPerBeat);
+    EXPECT_LT(result.tempoError, 0.005);
+    EXPECT_LT(result.phaseError, 350);
+    EXPECT_EQ(result.positionErrors, 0);
+    print("120 to 126 BPM", result);
+}
+
+TEST(ClockPll, CountsLostTicksAndDropsStrayOnes)
+{
+    ClockPll pll;
+    pll.reset();
+    Clock clock(120, 1000);
+    // Never a stray tick next to a lost one, which would be taken for it
+    clock.loseEvery(37);
+    clock.strayEvery(60);
+    Result result = clock.run(pll, 60 * ClockPll::TicksPerBeat, 8 * ClockPll::TicksPerBeat);
+    EXPECT_EQ(result.positionErrors, 0);
+    EXPECT_LT(result.tempoError, 0.005);
+    EXPECT_LT(result.phaseError, 400);
+    print("120 BPM, lost and stray ticks", result);
+}
+
+TEST(ClockPll, StartAndTimeout)
+{
+    ClockPll pll;
+    pll.reset();
+    uint32_t us = 1000;
+    for (int i = 0; i < 30; i++, us += 20833)
+    {
+        pll.tick(us);
+    }
+    EXPECT_TRUE(pll.locked());
+    EXPECT_EQ(pll.position(), 29);
+    pll.start();
+    pll.tick(us);
+    EXPECT_EQ(pll.position(), 0);
+    EXPECT_EQ(pll.phase(24), 0u);
+
+    // Four periods without a tick
+    EXPECT_FALSE(pll.timedOut(us + 3 * 20833));
+    EXPECT_TRUE(pll.timedOut(us + 5 * 20833));
+    pll.reset();
+    EXPECT_FALSE(pll.locked());
+    EXPECT_FALSE(pll.timedOut(us + 5 * 20833));
+}
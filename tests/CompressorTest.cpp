@@ -0,0 +1,213 @@
+/**
+ * @file CompressorTest.cpp
+ * @author Gino Bollaert
+ * @brief Compressor tests against a floating-point model
+ * @details The envelope traces are what the envelope input delivers at the ADC rate for typical playing: the
+ * rectified, smoothed level of plucked notes with ripple at the note's pitch, hard tone bursts and a slow swell. The
+ * fixed-point compressor takes them block by block, as the firmware does, and is compared with the same follower and
+ * gain computer in double precision.
+ * @date 2023-07-03
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "Compressor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+constexpr double AdcRate = 72000000.0 / 4097;
+constexpr int Block = 16;
+constexpr uint32_t ControlRate = static_cast<uint32_t>(AdcRate) / Block;
+
+double toDb(double gain) { return 20 * std::log10(gain); }
+
+// The compressor in double precision, on the same coefficients and control samples
+class ReferenceCompressor
+{
+public:
+    double process(uint16_t level, const CompressorParams& params)
+    {
+        double input = level / 4096.0;
+        double coefficient = (input > _envelope ? params.attack : params.release) / 65536.0;
+        _envelope += (input - _envelope) * coefficient;
+        if (params.amount == 0 || _envelope <= 0)
+        {
+            return 1;
+        }
+        double over = std::log2(_envelope) - params.threshold / 256.0;
+        return over > 0 ? std::exp2(-over * params.amount / 65536.0) : 1;
+    }
+
+private:
+    double _envelope = 0;
+};
+
+std::vector<uint16_t> pluckedNotes(double seconds)
+{
+    std::vector<uint16_t> trace(static_cast<size_t>(seconds * AdcRate));
+    const double noteSeconds = 0.75;
+    const double pitches[] = {82.4, 110, 146.8, 196};
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        double t = i / AdcRate;
+        int note = static_cast<int>(t / noteSeconds);
+        double since = t - note * noteSeconds;
+        double level = std::min(since / 0.002, 1.0) * std::exp(-since / 0.3) * (note % 2 ? 0.6 : 0.95);
+        double ripple = 1 - 0.1 * std::fabs(std::sin(M_PI * pitches[note % 4] * t));
+        trace[i] = static_cast<uint16_t>(std::lround(4095 * level * ripple));
+    }
+    return trace;
+}
+
+std::vector<uint16_t> toneBursts(double seconds)
+{
+    std::vector<uint16_t> trace(static_cast<size_t>(seconds * AdcRate));
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        double t = i / AdcRate;
+        trace[i] = std::fmod(t, 0.4) < 0.2 ? 3800 : 40;
+    }
+    return trace;
+}
+
+std::vector<uint16_t> swell(double seconds)
+{
+    std::vector<uint16_t> trace(static_cast<size_t>(seconds * AdcRate));
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        double t = i / AdcRate;
+        trace[i] = static_cast<uint16_t>(std::lround(4095 * std::pow(0.5 - 0.5 * std::cos(2 * M_PI * t / seconds), 2)));
+    }
+    return trace;
+}
+
+CompressorParams makeParams(uint32_t attackMs, uint32_t releaseMs, double thresholdDb, double ratio)
+{
+    CompressorParams params;
+    params.attack = Compressor::coefficient(attackMs, ControlRate);
+    params.release = Compressor::coefficient(releaseMs, ControlRate);
+    params.threshold = static_cast<int16_t>(std::lround(thresholdDb / 6.0206 * 256));
+    params.amount = static_cast<uint16_t>(std::lround((1 - 1 / ratio) * 0xffff));
+    return params;
+}
+} // namespace
+
+TEST(Compressor, Log2AndExp2)
+{
+    double worstLog = 0;
+    for (uint32_t x = 1; x < (1u << 24); x += x / 97 + 1)
+    {
+        worstLog = std::max(worstLog, std::fabs(Compressor::log2Q8(x) / 256.0 - std::log2(x)));
+    }
+    EXPECT_LT(worstLog, 0.004);
+
+    double worstExp = 0;
+    for (int32_t x = 0; x < 16 * 256; x++)
+    {
+        double exact = std::exp2(-x / 256.0);
+        if (exact * 65536 < 1024)
+        {
+            break; // below 2^-6 the Q16 result has too few bits for a relative error to mean much
+        }
+        worstExp = std::max(worstExp, std::fabs(Compressor::exp2NegativeQ8(x) / 65536.0 - exact) / exact);
+    }
+    EXPECT_LT(worstExp, 0.002);
+    EXPECT_EQ(Compressor::exp2NegativeQ8(0), Compressor::Unity);
+    EXPECT_EQ(Compressor::exp2NegativeQ8(16 * 256), 0);
+}
+
+TEST(Compressor, AttackAndReleaseTimeConstants)
+{
+    for (uint32_t ms : {2u, 10u, 100u, 1000u})
+    {
+        CompressorParams params;
+        params.attack = Compressor::coefficient(ms, ControlRate);
+        params.release = params.attack;
+        Compressor compressor;
+        // About one time constant, in whole control samples, reaches 1 - 1/e of a step, rising and falling alike
+        const double samplesPerTau = ms * ControlRate / 1000.0;
+        const int steps = static_cast<int>(std::lround(samplesPerTau));
+        const double decay = std::exp(-steps / samplesPerTau);
+        for (int n = 0; n < steps; n++)
+        {
+            compressor.process(4095, params);
+        }
+        EXPECT_NEAR(compressor.envelope() / 16777216.0, 1 - decay, 0.01) << ms << " ms attack";
+        const double top = compressor.envelope();
+        for (int n = 0; n < steps; n++)
+        {
+            compressor.process(0, params);
+        }
+        EXPECT_NEAR(compressor.envelope() / top, decay, 0.01) << ms << " ms release";
+    }
+}
+
+TEST(Compressor, OffLeavesUnityGain)
+{
+    Compressor compressor;
+    CompressorParams params = makeParams(5, 200, -30, 1);
+    EXPECT_EQ(params.amount, 0);
+    for (uint16_t level : pluckedNotes(1))
+    {
+        ASSERT_EQ(compressor.process(level, params), Compressor::Unity);
+    }
+}
+
+TEST(Compressor, TracksTheReferenceOnEnvelopeTraces)
+{
+    struct Case
+    {
+        const char* name;
+        std::vector<uint16_t> trace;
+        CompressorParams params;
+    };
+    const Case cases[] = {
+        {"plucked notes 4:1", pluckedNotes(3), makeParams(5, 250, -18, 4)},
+        {"plucked notes limit", pluckedNotes(3), makeParams(1, 100, -6, 1000)},
+        {"tone bursts 2:1", toneBursts(2), makeParams(20, 500, -24, 2)},
+        {"swell 8:1", swell(4), makeParams(50, 1500, -40, 8)},
+    };
+    for (const Case& c : cases)
+    {
+        Compressor compressor;
+        ReferenceCompressor reference;
+        double worstDb = 0;
+        double minGainDb = 0;
+        for (size_t i = 0; i + Block <= c.trace.size(); i += Block)
+        {
+            uint16_t gain = compressor.processBlock(&c.trace[i], Block, c.params);
+            uint16_t peak = *std::max_element(&c.trace[i], &c.trace[i] + Block);
+            double expected = reference.process(peak, c.params);
+            minGainDb = std::min(minGainDb, toDb(expected));
+            if (expected > 1e-3)
+            {
+                worstDb = std::max(worstDb, std::fabs(toDb(gain / 65536.0) - toDb(expected)));
+            }
+        }
+        // Unity is 0xffff, 0.0001 dB short of 1
+        EXPECT_LT(worstDb, 0.1) << c.name;
+        EXPECT_LT(minGainDb, -3) << c.name << " never compressed";
+        std::printf("[          ] %-20s down to %6.1f dB, within %.3f dB of the float model\n", c.name, minGainDb,
+                    worstDb);
+    }
+}
+
+TEST(Compressor, StrideReadsOnePinOfInterleavedFrames)
+{
+    std::vector<uint16_t> frames(2 * Block);
+    for (int i = 0; i < Block; i++)
+    {
+        frames[2 * i] = 100;
+        frames[2 * i + 1] = 4000;
+    }
+    frames[2 * 7] = 1234;
+    CompressorParams params = makeParams(0, 0, -60, 2);
+    Compressor strided;
+    Compressor single;
+    EXPECT_EQ(strided.processBlock(frames.data(), Block, params, 2), single.process(1234, params));
+    EXPECT_EQ(strided.envelope(), single.envelope());
+}
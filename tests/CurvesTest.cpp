@@ -0,0 +1,69 @@
+/**
+ * @file CurvesTest.cpp
+ * @author Gino Bollaert
+ * @brief CC curve table tests
+ * @details
+ * @date 2023-06-18
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "ClockPll.h"
+#include "Curves.h"
+#include <gtest/gtest.h>
+
+static_assert(RateCurve[127] == 30 << 16);
+static_assert(VolumeCurve[127] == 0xfffc);
+static_assert(RotaryPhaseCurve[64] == 0x80008000u);
+static_assert(CompressorThresholdCurve[127] == 0 && CompressorThresholdCurve[0] == -2048);
+static_assert(CompressorThresholdDbCurve[0] == -48);
+static_assert(CompressorAmountCurve[127] == 0xffff);
+static_assert(ClockDivisionCurve[0] == 0 && ClockDivisionCurve[48] == ClockPll::TicksPerBeat);
+
+TEST(Curves, RateMatchesFloatFormula)
+{
+    for (int val = 0; val < CurveSize; val++)
+    {
+        float rate = val * 3.f / 127;
+        rate = rate + rate * rate * rate;
+        // Q16.16 truncation of r and r^3 costs at most a few parts in 10^5
+        EXPECT_NEAR(RateCurve[val] / 65536.0, rate, 5e-5 * rate + 1e-4) << "val " << val;
+        EXPECT_NEAR(RateRpmCurve[val], rate * 60, 0.51) << "val " << val;
+    }
+}
+
+TEST(Curves, Monotonic)
+{
+    for (int val = 1; val < CurveSize; val++)
+    {
+        EXPECT_GT(RateCurve[val], RateCurve[val - 1]) << "val " << val;
+        EXPECT_GT(RampTimeCurve[val], RampTimeCurve[val - 1]) << "val " << val;
+        EXPECT_GT(VolumeCurve[val], VolumeCurve[val - 1]) << "val " << val;
+        EXPECT_GT(DepthCurve[val], DepthCurve[val - 1]) << "val " << val;
+        EXPECT_GT(AutopanWidthCurve[val], AutopanWidthCurve[val - 1]) << "val " << val;
+        EXPECT_GT(RotaryPhaseCurve[val], RotaryPhaseCurve[val - 1]) << "val " << val;
+    }
+}
+
+TEST(Curves, CompressorCurvesNeverDecrease)
+{
+    // The times are whole milliseconds, so the low ends of the time curves have steps of zero
+    for (int val = 1; val < CurveSize; val++)
+    {
+        EXPECT_GE(CompressorAttackCurve[val], CompressorAttackCurve[val - 1]) << "val " << val;
+        EXPECT_GE(CompressorReleaseCurve[val], CompressorReleaseCurve[val - 1]) << "val " << val;
+        EXPECT_GT(CompressorThresholdCurve[val], CompressorThresholdCurve[val - 1]) << "val " << val;
+        EXPECT_GE(CompressorThresholdDbCurve[val], CompressorThresholdDbCurve[val - 1]) << "val " << val;
+        EXPECT_GT(CompressorAmountCurve[val], CompressorAmountCurve[val - 1]) << "val " << val;
+    }
+    EXPECT_EQ(CompressorAttackCurve[127], 100);
+    EXPECT_EQ(CompressorReleaseCurve[127], 2000);
+}
+
+TEST(Curves, ClockDivisionsDivideTheClockPosition)
+{
+    // The LFO's beat phase is the position modulo the division, which must not jump when the position wraps
+    for (int val = 16; val < 128; val++)
+    {
+        EXPECT_EQ(ClockPll::PositionWrap % ClockDivisionCurve[val], 0) << "val " << val;
+    }
+}
@@ -0,0 +1,683 @@
+/**
+ * @file FirmwareTest.cpp
+ * @author Gino Bollaert
+ * @brief End-to-end firmware tests on the host simulator
+ * @details
+ * @date 2023-06-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "Firmware.h"
+#include "Globals.h"
+#include "Simulator.h"
+#include <chrono>
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace
+{
+class Firmware : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        simulator.reset();
+        simulator.flash().eraseAll();
+        simulator.flash().resetStatistics();
+        simulator.setImageBytes(0);
+        setup();
+    }
+
+    void run(double ms)
+    {
+        uint64_t end = simulator.cycles() + sim::Simulator::msToCycles(ms);
+        while (simulator.cycles() < end)
+        {
+            loop();
+            simulator.advance(50 * sim::Simulator::CyclesPerUs);
+        }
+    }
+
+    void sendDin(std::initializer_list<uint8_t> bytes)
+    {
+        std::vector<uint8_t> data(bytes);
+        simulator.sendDin(simulator.cycles(), data.data(), data.size());
+    }
+
+    /** Runs loop() every 10 us until `done` holds and returns how long that took, in ms */
+    template <typename F> double runUntil(F done, double timeoutMs = 100)
+    {
+        uint64_t start = simulator.cycles();
+        uint64_t end = start + sim::Simulator::msToCycles(timeoutMs);
+        while (!done() && simulator.cycles() < end)
+        {
+            loop();
+            simulator.advance(10 * sim::Simulator::CyclesPerUs);
+        }
+        return static_cast<double>(simulator.cycles() - start) / sim::Simulator::CyclesPerMs;
+    }
+
+    /** SysEx messages the firmware has sent on DIN or USB since the last clearOutput(), F0 to F7 */
+    std::vector<std::vector<uint8_t>> sentSysEx(bool din) const
+    {
+        std::vector<uint8_t> bytes;
+        if (din)
+        {
+            for (const auto& sent : simulator.dinOutput())
+            {
+                bytes.push_back(sent.second);
+            }
+        }
+        else
+        {
+            for (uint32_t packet : simulator.usbOutput())
+            {
+                static const int Length[] = {0, 0, 0, 0, 3, 1, 2, 3};
+                for (int i = 1; i <= Length[packet & 0x07]; i++)
+                {
+                    bytes.push_back(static_cast<uint8_t>(packet >> (8 * i)));
+                }
+            }
+        }
+        std::vector<std::vector<uint8_t>> messages;
+        for (uint8_t byte : bytes)
+        {
+            if (byte == SysEx::Start)
+            {
+                messages.emplace_back();
+            }
+            if (!messages.empty())
+            {
+                messages.back().push_back(byte);
+            }
+        }
+        return messages;
+    }
+
+    /** Sends `message` and waits for the firmware's reply on the same port */
+    std::vector<uint8_t> exchangeSysEx(bool din, const std::vector<uint8_t>& message)
+    {
+        size_t replies = sentSysEx(din).size();
+        if (din)
+        {
+            simulator.sendDin(simulator.cycles(), message.data(), message.size());
+        }
+        else
+        {
+            simulator.sendUsb(simulator.cycles(), message.data(), message.size());
+        }
+        runUntil([&] { return complete(din, replies + 1); }, 1000);
+        auto sent = sentSysEx(din);
+        return sent.size() > replies ? sent[replies] : std::vector<uint8_t>();
+    }
+
+    /** True once `count` whole messages have gone out on the port */
+    bool complete(bool din, size_t count)
+    {
+        // Only the output added since the last call is scanned, as this is polled between loop() calls
+        size_t& scanned = din ? dinScanned : usbScanned;
+        size_t& ends = din ? dinEnds : usbEnds;
+        size_t size = din ? simulator.dinOutput().size() : simulator.usbOutput().size();
+        if (size < scanned)
+        {
+            scanned = 0;
+            ends = 0;
+        }
+        for (; scanned < size; scanned++)
+        {
+            if (din)
+            {
+                ends += simulator.dinOutput()[scanned].second == SysEx::End;
+            }
+            else
+            {
+                uint32_t packet = simulator.usbOutput()[scanned];
+                ends += (packet & 0x07) >= 5;
+            }
+        }
+        return ends >= count && (!din || simulator.dinOutput().back().first <= simulator.cycles());
+    }
+
+    static std::vector<uint8_t> makeSysEx(SysEx::Command command, uint8_t index, const void* payload = nullptr,
+                                          size_t bytes = 0, uint8_t format = PresetFormat)
+    {
+        std::vector<uint8_t> message(SysEx::messageSize(bytes));
+        SysExWriter writer(message.data(), format, command, index);
+        writer.write(payload, bytes);
+        writer.finish();
+        return message;
+    }
+
+    /** Command, index and payload of a message from the firmware */
+    static SysEx::Command readSysEx(const std::vector<uint8_t>& message, uint8_t* index = nullptr,
+                                    void* payload = nullptr, size_t bytes = 0)
+    {
+        SysExReader<sizeof(Preset)> reader;
+        for (size_t i = 1; i + 1 < message.size(); i++)
+        {
+            reader.push(message[i]);
+        }
+        if (message.size() < 2 || !reader.end() || reader.size() != static_cast<int>(bytes))
+        {
+            return SysEx::Command(0);
+        }
+        if (index)
+        {
+            *index = reader.index();
+        }
+        memcpy(payload, reader.payload(), bytes);
+        return reader.command();
+    }
+
+    uint16_t compare(PwmOut out) const
+    {
+        const Pwm& pwm = Pwms[(int)out];
+        return simulator.activeCompare(pwm.timer, pwm.channel);
+    }
+
+    sim::Simulator& simulator = sim::Simulator::instance();
+    size_t dinScanned = 0;
+    size_t dinEnds = 0;
+    size_t usbScanned = 0;
+    size_t usbEnds = 0;
+};
+} // namespace
+
+TEST_F(Firmware, TimerInterruptRunsAtPwmRate)
+{
+    uint64_t before = simulator.overflows(Pwms[0].timer);
+    run(1000);
+    uint64_t periods = simulator.overflows(Pwms[0].timer) - before;
+    EXPECT_NEAR(static_cast<double>(periods), static_cast<double>(F_CPU) / (PwmPrecision + 1), 2);
+}
+
+TEST_F(Firmware, TimerInterruptRunsEveryInterruptPeriodsAndRendersAtSampleRate)
+{
+    // Once per sample, or with PWM_DITHER every PWM period, rendering a sample every DownSample of them
+    uint64_t before = simulator.totalInterruptStats().count;
+    int samples = 0;
+    uint32_t phase = lfo.basePhase();
+    uint64_t end = simulator.cycles() + sim::Simulator::msToCycles(1000);
+    while (simulator.cycles() < end)
+    {
+        loop();
+        simulator.advance(50 * sim::Simulator::CyclesPerUs);
+        samples += lfo.basePhase() != phase;
+        phase = lfo.basePhase();
+    }
+    uint64_t interrupts = simulator.totalInterruptStats().count - before;
+    EXPECT_NEAR(static_cast<double>(interrupts), static_cast<double>(F_CPU) / (PwmPrecision + 1) / InterruptPeriods, 1);
+    EXPECT_EQ(simulator.updates(SampleTimer), simulator.overflows(SampleTimer) / InterruptPeriods);
+    EXPECT_NEAR(samples, static_cast<double>(F_CPU) / (PwmPrecision + 1) / DownSample, 1);
+}
+
+#if PWM_DITHER
+TEST_F(Firmware, PwmTimersStartTheirPeriodsWithTimer1)
+{
+    // Knock TIMER2 to TIMER4 out of phase; the next update event of TIMER1 brings them back in step with it
+    simulator.advance(300);
+    for (timer_dev* dev : {TIMER2, TIMER3, TIMER4})
+    {
+        simulator.advance(700);
+        timer_generate_update(dev);
+    }
+    uint64_t last[4] = {};
+    simulator.setPeriodCallback([&](timer_dev* dev) {
+        timer_dev* timers[4] = {TIMER1, TIMER2, TIMER3, TIMER4};
+        for (int i = 0; i < 4; i++)
+        {
+            if (dev == timers[i])
+            {
+                last[i] = simulator.cycles();
+            }
+        }
+    });
+    run(1);
+    simulator.setPeriodCallback(nullptr);
+    ASSERT_GT(last[0], 0u);
+    for (int i = 1; i < 4; i++)
+    {
+        EXPECT_EQ(last[i], last[0]) << "TIMER" << i + 1;
+    }
+}
+#else
+TEST_F(Firmware, PwmTimersRunFree)
+{
+    EXPECT_NE(SampleTimer->regs.adv->CR2 & TIMER_CR2_MMS, TIMER_CR2_MMS_UPDATE);
+    for (timer_dev* dev : {TIMER2, TIMER3, TIMER4})
+    {
+        EXPECT_EQ(dev->regs.gen->SMCR, 0u);
+    }
+}
+#endif
+
+TEST_F(Firmware, VolumeControlsTremoloOutputs)
+{
+    run(100);
+    uint16_t maxLevel = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        run(5);
+        maxLevel = std::max(maxLevel, compare(PwmOut::L3));
+        maxLevel = std::max(maxLevel, compare(PwmOut::R3));
+    }
+    EXPECT_GT(maxLevel, 0);
+
+    sendDin({0xb0, (uint8_t)MidiCC::Volume, 0});
+    run(20);
+    for (int i = 0; i < 50; i++)
+    {
+        run(5);
+        for (PwmOut out : {PwmOut::L1, PwmOut::R1, PwmOut::L2, PwmOut::R2, PwmOut::L3, PwmOut::R3})
+        {
+            ASSERT_EQ(compare(out), 0);
+        }
+        ASSERT_GT(compare(PwmOut::V3), 0);
+    }
+}
+
+TEST_F(Firmware, DinControlChangeSurvivesRealtimeBytes)
+{
+    // A clock between status and data, and between the two data bytes, must not drop the CC
+    sendDin({0xb0, 0xf8, (uint8_t)MidiCC::Volume, 0xf8, 0xfa, 17});
+    run(100);
+    EXPECT_EQ(state.volume, VolumeCurve[17]);
+
+    // Running status
+    sendDin({0xb0, (uint8_t)MidiCC::Volume, 40, (uint8_t)MidiCC::Expression, 41, 0xf8, (uint8_t)MidiCC::Volume, 42});
+    run(100);
+    EXPECT_EQ(state.volume, VolumeCurve[42]);
+    EXPECT_EQ(state.expression, VolumeCurve[41]);
+}
+
+TEST_F(Firmware, DinControlChangeOnOtherChannelsIsIgnored)
+{
+    sendDin({0xb0, (uint8_t)MidiCC::Volume, 90});
+    run(100);
+    sendDin({0xb1, (uint8_t)MidiCC::Volume, 5, 0xbf, (uint8_t)MidiCC::Volume, 6});
+    run(100);
+    EXPECT_EQ(state.volume, VolumeCurve[90]);
+}
+
+TEST_F(Firmware, DenseControlChangesAreCoalesced)
+{
+    uint32_t received = controlChanges.received();
+    uint32_t applied = controlChanges.applied();
+    uint32_t coalesced = controlChanges.coalesced();
+    // A USB automation burst lands within a single loop(), so only the last value of each controller is applied
+    for (uint8_t val = 0; val < 20; val++)
+    {
+        uint8_t expression[] = {0xb0, (uint8_t)MidiCC::Expression, val};
+        uint8_t volume[] = {0xb0, (uint8_t)MidiCC::Volume, (uint8_t)(100 - val)};
+        simulator.sendUsb(simulator.cycles(), expression, sizeof(expression));
+        simulator.sendUsb(simulator.cycles(), volume, sizeof(volume));
+    }
+    run(1);
+    EXPECT_EQ(controlChanges.received() - received, 40u);
+    EXPECT_EQ(controlChanges.applied() - applied, 2u);
+    EXPECT_EQ(controlChanges.coalesced() - coalesced, 38u);
+    EXPECT_EQ(state.expression, VolumeCurve[19]);
+    EXPECT_EQ(state.volume, VolumeCurve[81]);
+}
+
+TEST_F(Firmware, SettingsAreRestoredAfterAPowerCycle)
+{
+    sendDin({0xb0, (uint8_t)MidiCC::Volume, 17, (uint8_t)MidiCC::Rate, 90});
+    run(SettingsSaveDelayMs / 2);
+    EXPECT_EQ(simulator.flash().bytesProgrammed(), 0u);
+    run(SettingsSaveDelayMs);
+    EXPECT_EQ(simulator.flash().bytesProgrammed(), RecordLog<Settings>::RecordBytes);
+
+    simulator.reset();
+    setup();
+    EXPECT_EQ(state.volume, VolumeCurve[17]);
+    EXPECT_EQ(state.rate, RateCurve[90]);
+    EXPECT_EQ(state.expression, VolumeCurve[DefaultSettings.controls[3]]);
+}
+
+TEST_F(Firmware, ControlSweepIsSavedOnceItSettles)
+{
+    // A one second sweep of a control, then nothing for a while: one record, written after the sweep ends
+    for (int val = 0; val < 128; val++)
+    {
+        uint8_t message[] = {0xb0, (uint8_t)MidiCC::Tremolo, (uint8_t)val};
+        simulator.sendDin(simulator.cycles() + sim::Simulator::msToCycles(val * 8), message, sizeof(message));
+    }
+    run(1000 + SettingsSaveDelayMs - 100);
+    EXPECT_EQ(simulator.flash().bytesProgrammed(), 0u);
+    run(5000);
+    EXPECT_EQ(simulator.flash().bytesProgrammed(), RecordLog<Settings>::RecordBytes);
+    EXPECT_EQ(simulator.flash().programErrors(), 0u);
+}
+
+TEST_F(Firmware, ProgramChangeRecallsAPreset)
+{
+    sendDin({0xb0, (uint8_t)MidiCC::Rate, 100, (uint8_t)MidiCC::Volume, 30, (uint8_t)MidiCC::VoiceMode, 127,
+             (uint8_t)MidiCC::AutopanWidth, 90});
+    run(10);
+    ASSERT_TRUE(storePreset(9));
+    const State stored = state;
+    const Settings storedSettings = settings;
+
+    sendDin({0xb0, (uint8_t)MidiCC::Rate, 10, (uint8_t)MidiCC::Volume, 120, (uint8_t)MidiCC::VoiceMode, 0});
+    run(10);
+    ASSERT_EQ(state.volume, VolumeCurve[120]);
+    ASSERT_EQ(state.voiceMode, VoiceMode::Vibrato);
+
+    const uint32_t retarget = state.lfoRetarget;
+    sendDin({0xc0, 9});
+    run(10);
+    EXPECT_EQ(state.rate, stored.rate);
+    EXPECT_EQ(state.volume, stored.volume);
+    EXPECT_EQ(state.voiceMode, VoiceMode::Chorus);
+    EXPECT_EQ(state.lfoDelta, stored.lfoDelta);
+    EXPECT_EQ(memcmp(state.lfoOffset, stored.lfoOffset, sizeof(state.lfoOffset)), 0);
+    EXPECT_EQ(memcmp(state.osc, stored.osc, sizeof(state.osc)), 0);
+    EXPECT_EQ(state.lfoRetarget, retarget + 1);
+    EXPECT_EQ(memcmp(&settings, &storedSettings, sizeof(Settings)), 0);
+    EXPECT_EQ(digitalRead(PinVoice), HIGH);
+
+    // An empty slot and other channels leave the sound alone
+    sendDin({0xc0, 10, 0xc1, 9});
+    run(10);
+    EXPECT_EQ(state.lfoRetarget, retarget + 1);
+}
+
+TEST_F(Firmware, FlashTakenByTheImageIsNeverWritten)
+{
+    // A sketch grown one byte into the preset bank: the slots on its first page are lost, the rest still work
+    simulator.setImageBytes(PresetFirstPage * InternalFlash::PageSize + 1);
+    EXPECT_FALSE(storePreset(0));
+    EXPECT_EQ(simulator.flash().bytesProgrammed(), 0u);
+    EXPECT_TRUE(storePreset(PresetCount - 1));
+    EXPECT_GT(simulator.flash().bytesProgrammed(), 0u);
+}
+
+TEST_F(Firmware, PresetRecallLatency)
+{
+    const uint8_t controls[SavedControlCount] = {100, 20, 30, 40, 127, 90, 50, 60, 70, 80};
+    for (int i = 0; i < SavedControlCount; i++)
+    {
+        controlChanges.set((uint8_t)SavedControls[i], controls[i]);
+    }
+    run(10);
+    ASSERT_TRUE(storePreset(0));
+    const uint16_t presetDry = compare(PwmOut::Dry);
+    sendDin({0xb0, (uint8_t)MidiCC::Phaser, 0});
+    run(10);
+    ASSERT_NE(compare(PwmOut::Dry), presetDry);
+
+    // From the first MIDI byte on DIN to the PWM output: the program change, then the same sound sent as controls
+    sendDin({0xc0, 0});
+    double recallMs = runUntil([&] { return compare(PwmOut::Dry) == presetDry; });
+    ASSERT_EQ(compare(PwmOut::Dry), presetDry);
+
+    sendDin({0xb0, (uint8_t)MidiCC::Phaser, 0});
+    run(10);
+    std::vector<uint8_t> message = {0xb0};
+    for (int i = 0; i < SavedControlCount; i++)
+    {
+        message.push_back((uint8_t)SavedControls[i]);
+        message.push_back(controls[i]);
+    }
+    simulator.sendDin(simulator.cycles(), message.data(), message.size());
+    double replayMs = runUntil([&] { return compare(PwmOut::Dry) == presetDry && state.rate == RateCurve[100]; });
+    ASSERT_EQ(compare(PwmOut::Dry), presetDry);
+    EXPECT_LT(recallMs, replayMs);
+
+    // The firmware's own work, on the host: a recall against applying all the controls
+    constexpr int Repeats = 10000;
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < Repeats; n++)
+    {
+        recallPreset(0);
+    }
+    auto recallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < Repeats; n++)
+    {
+        for (int i = 0; i < SavedControlCount; i++)
+        {
+            controlChanges.set((uint8_t)SavedControls[i], controls[i] ^ (n & 1));
+        }
+        applyControlChanges();
+    }
+    auto replayNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    std::printf("[          ] MIDI to PWM output: %.2f ms by program change, %.2f ms by %d control changes\n", recallMs,
+                replayMs, SavedControlCount);
+    std::printf("[          ] on the host: %.0f ns per recall, %.0f ns per replay of %d controls\n",
+                static_cast<double>(recallNs.count()) / Repeats, static_cast<double>(replayNs.count()) / Repeats,
+                SavedControlCount);
+}
+
+TEST_F(Firmware, SysExStateDumpAndLoad)
+{
+    sendDin({0xb0, (uint8_t)MidiCC::Rate, 70, (uint8_t)MidiCC::Vibrato, 20, (uint8_t)MidiCC::VoiceMode, 127});
+    run(10);
+    Preset dumped;
+    ASSERT_EQ(readSysEx(exchangeSysEx(false, makeSysEx(SysEx::Command::StateRequest, 0)), nullptr, &dumped,
+                        sizeof(dumped)),
+              SysEx::Command::State);
+    EXPECT_EQ(memcmp(&dumped.settings, &settings, sizeof(Settings)), 0);
+
+    sendDin({0xb0, (uint8_t)MidiCC::Rate, 3, (uint8_t)MidiCC::Vibrato, 120, (uint8_t)MidiCC::VoiceMode, 0});
+    run(10);
+    uint32_t retarget = state.lfoRetarget;
+    auto reply = exchangeSysEx(true, makeSysEx(SysEx::Command::State, 0, &dumped, sizeof(dumped)));
+    ASSERT_EQ(readSysEx(reply), SysEx::Command::Ack);
+    EXPECT_EQ(state.rate, RateCurve[70]);
+    EXPECT_EQ(state.vibratoDepth, DepthCurve[20]);
+    EXPECT_EQ(state.voiceMode, VoiceMode::Chorus);
+    EXPECT_EQ(state.lfoRetarget, retarget + 1);
+    EXPECT_EQ(memcmp(&dumped.settings, &settings, sizeof(Settings)), 0);
+
+    // A payload of the wrong size or format is refused, and other manufacturers' SysEx is ignored
+    reply = exchangeSysEx(true, makeSysEx(SysEx::Command::State, 0, &dumped, sizeof(dumped) - 1));
+    EXPECT_EQ(readSysEx(reply), SysEx::Command::Nak);
+    reply = exchangeSysEx(true, makeSysEx(SysEx::Command::State, 0, &dumped, sizeof(dumped), PresetFormat + 1));
+    EXPECT_EQ(readSysEx(reply), SysEx::Command::Nak);
+    reply = exchangeSysEx(false, makeSysEx(SysEx::Command::Preset, 5, &dumped, sizeof(dumped), PresetFormat + 1));
+    EXPECT_EQ(readSysEx(reply), SysEx::Command::Nak);
+    EXPECT_EQ(state.rate, RateCurve[70]);
+
+    // Out of range control values are taken to seven bits, as from MIDI
+    Preset wild = dumped;
+    memset(wild.settings.controls, 0xff, sizeof(wild.settings.controls));
+    reply = exchangeSysEx(true, makeSysEx(SysEx::Command::State, 0, &wild, sizeof(wild)));
+    ASSERT_EQ(readSysEx(reply), SysEx::Command::Ack);
+    EXPECT_EQ(state.rate, RateCurve[127]);
+    EXPECT_EQ(state.voiceMode, VoiceMode::Chorus);
+    auto other = makeSysEx(SysEx::Command::StateRequest, 0);
+    other[1] = 0x43;
+    EXPECT_TRUE(exchangeSysEx(false, other).empty());
+}
+
+TEST_F(Firmware, SysExBankRoundTrip)
+{
+    // Every preset different, stored the way a user would
+    for (int program = 0; program < PresetCount; program++)
+    {
+        for (int i = 0; i < SavedControlCount; i++)
+        {
+            controlChanges.set((uint8_t)SavedControls[i], (program * 7 + i * 13) & 0x7f);
+        }
+        ASSERT_TRUE(storePreset(program));
+    }
+    // The settings these were made from are saved first, so that only presets are written while loading
+    run(SettingsSaveDelayMs + 10);
+    std::vector<Preset> bank(PresetCount);
+    for (int program = 0; program < PresetCount; program++)
+    {
+        ASSERT_TRUE(presets.read(program, bank[program]));
+    }
+
+    for (bool din : {false, true})
+    {
+        const char* port = din ? "DIN" : "USB";
+        simulator.clearOutput();
+        uint64_t start = simulator.cycles();
+        auto first = exchangeSysEx(din, makeSysEx(SysEx::Command::BankRequest, 0));
+        ASSERT_FALSE(first.empty()) << port;
+        runUntil([&] { return complete(din, PresetCount + 1); }, 20000);
+        double dumpMs = static_cast<double>(simulator.cycles() - start) / sim::Simulator::CyclesPerMs;
+        auto dump = sentSysEx(din);
+        ASSERT_EQ(dump.size(), PresetCount + 1u) << port;
+        uint8_t count = 0;
+        ASSERT_EQ(readSysEx(dump.back(), nullptr, &count, 1), SysEx::Command::BankEnd);
+        EXPECT_EQ(count, PresetCount);
+        dump.pop_back();
+        size_t bytes = 0;
+        for (const auto& message : dump)
+        {
+            bytes += message.size();
+        }
+
+        // Into a new unit: blank presets, loaded one message at a time, each after the previous one's Ack
+        simulator.flash().eraseAll();
+        simulator.flash().resetStatistics();
+        start = simulator.cycles();
+        for (const auto& message : dump)
+        {
+            ASSERT_EQ(readSysEx(exchangeSysEx(din, message)), SysEx::Command::Ack) << port;
+        }
+        double loadMs = static_cast<double>(simulator.cycles() - start) / sim::Simulator::CyclesPerMs;
+        EXPECT_EQ(simulator.flash().totalErases(), 0u);
+        for (int program = 0; program < PresetCount; program++)
+        {
+            Preset preset;
+            ASSERT_TRUE(presets.read(program, preset)) << port << " " << program;
+            EXPECT_EQ(memcmp(&preset, &bank[program], sizeof(Preset)), 0) << port << " " << program;
+        }
+
+        // USB bus time is not modelled, so the USB figures are the firmware's own: loop() and flash programming
+        std::printf("[          ] %s: %d presets in %zu bytes, dumped in %.0f ms (%.1f KB/s), loaded in %.0f ms "
+                    "(%.1f KB/s, %.0f ms of it programming flash)\n",
+                    port, PresetCount, bytes, dumpMs, bytes / dumpMs, loadMs, bytes / loadMs,
+                    simulator.flash().bytesProgrammed() / 2 * 0.052);
+    }
+}
+
+TEST_F(Firmware, CompressorFollowsTheEnvelopeInput)
+{
+    // Fastest attack and release, a threshold of -24 dB and limiting
+    sendDin({0xb0, (uint8_t)MidiCC::CompressorAttack, 0, (uint8_t)MidiCC::CompressorRelease, 0,
+             (uint8_t)MidiCC::CompressorThreshold, 64, (uint8_t)MidiCC::CompressorAmount, 127});
+    run(10);
+    EXPECT_EQ(state.compressorGain, Compressor::Unity);
+    const uint32_t openMul = state.osc[(int)PwmOut::L1].mul;
+
+    // A full-scale envelope is 24 dB over the threshold, and limiting takes all of that off
+    simulator.setAnalog(PinEnvelope, 4095);
+    const double attackMs = runUntil([&] { return state.compressorGain < Compressor::Unity / 8; });
+    ASSERT_LT(state.compressorGain, Compressor::Unity / 8);
+    run(20);
+    const double gainDb = 20 * std::log10(state.compressorGain / 65536.0);
+    EXPECT_NEAR(gainDb, CompressorThresholdDbCurve[64], 0.5);
+    EXPECT_NEAR(state.osc[(int)PwmOut::L1].mul, (openMul * state.compressorGain) >> 16, 1);
+
+    simulator.setAnalog(PinEnvelope, 0);
+    const double releaseMs = runUntil([&] { return state.compressorGain == Compressor::Unity; });
+    EXPECT_EQ(state.compressorGain, Compressor::Unity);
+    EXPECT_EQ(state.osc[(int)PwmOut::L1].mul, openMul);
+
+    // With the amount at zero the input makes no difference
+    sendDin({0xb0, (uint8_t)MidiCC::CompressorAmount, 0});
+    simulator.setAnalog(PinEnvelope, 4095);
+    run(50);
+    EXPECT_EQ(state.compressorGain, Compressor::Unity);
+
+    std::printf("[          ] limiting at %.1f dB: %.2f ms to -18 dB, %.2f ms back to unity\n", gainDb, attackMs,
+                releaseMs);
+}
+
+TEST_F(Firmware, CompressorTurnsDownTheDryOutput)
+{
+    sendDin({0xb0, (uint8_t)MidiCC::Phaser, 127, (uint8_t)MidiCC::CompressorAttack, 0,
+             (uint8_t)MidiCC::CompressorRelease, 0, (uint8_t)MidiCC::CompressorThreshold, 64,
+             (uint8_t)MidiCC::CompressorAmount, 127});
+    run(10);
+    const uint16_t open = compare(PwmOut::Dry);
+    ASSERT_GT(open, PwmMax / 4);
+
+    // 24 dB over the threshold, limited
+    simulator.setAnalog(PinEnvelope, 4095);
+    run(50);
+    EXPECT_LT(compare(PwmOut::Dry), open / 8);
+
+    simulator.setAnalog(PinEnvelope, 0);
+    runUntil([&] { return state.compressorGain == Compressor::Unity; });
+    run(1);
+    EXPECT_NEAR(compare(PwmOut::Dry), open, 1);
+}
+
+TEST_F(Firmware, PotsTurnTheirControls)
+{
+    // Where the pots sit at power-on does not override the settings
+    EXPECT_EQ(state.rate, RateCurve[DefaultSettings.controls[0]]);
+    EXPECT_EQ(state.vibratoDepth, DepthCurve[DefaultSettings.controls[7]]);
+
+    simulator.setAnalog(PinRate, 100 * 32 + 16);
+    simulator.setAnalog(PinTremolo, 4095);
+    const double ms = runUntil([&] { return state.rate == RateCurve[100]; });
+    run(10);
+    EXPECT_EQ(state.rate, RateCurve[100]);
+    EXPECT_EQ(state.tremoloDepth, DepthCurve[127]);
+    EXPECT_EQ(state.vibratoDepth, DepthCurve[DefaultSettings.controls[7]]);
+    EXPECT_EQ(settings.controls[0], 100);
+
+    // MIDI still sets a control, and the pot only takes it back once it is turned
+    sendDin({0xb0, (uint8_t)MidiCC::Rate, 10});
+    run(100);
+    EXPECT_EQ(state.rate, RateCurve[10]);
+    simulator.setAnalog(PinRate, 90 * 32 + 16);
+    run(10);
+    EXPECT_EQ(state.rate, RateCurve[90]);
+
+    std::printf("[          ] pot to LFO rate: %.2f ms\n", ms);
+}
+
+TEST_F(Firmware, LfoFollowsMidiClock)
+{
+    // A quarter note per cycle of a 120 BPM DIN clock: 2 Hz, on the beat
+    sendDin({0xb0, (uint8_t)MidiCC::ClockDivision, 48});
+    run(10);
+    EXPECT_EQ(state.clockTicks, 24);
+    const uint8_t start = 0xfa;
+    const uint8_t tick = 0xf8;
+    const double tickCycles = F_CPU * 60.0 / 120 / ClockPll::TicksPerBeat;
+    const uint64_t first = simulator.cycles() + sim::Simulator::msToCycles(1);
+    simulator.sendDin(first - sim::Simulator::DinByteCycles, &start, 1);
+    const int ticks = 18 * 2 * ClockPll::TicksPerBeat;
+    for (int i = 0; i < ticks; i++)
+    {
+        simulator.sendDin(first + static_cast<uint64_t>(i * tickCycles), &tick, 1);
+    }
+
+    const double lockMs = runUntil([&] { return state.clock.locked; }, 1000);
+    EXPECT_TRUE(state.clock.locked);
+    run(10);
+    EXPECT_NEAR(lfo.frequency(), 2, 0.01);
+
+    // After the rate has ramped and the phase has been pulled in, the LFO stays within 0.2% of a cycle of the beat.
+    // The phase is compared just after each sample is rendered, as due at that time.
+    run(15000);
+    double maxError = 0;
+    for (int n = 0; n < 1000; n++)
+    {
+        uint32_t phase = lfo.basePhase();
+        runUntil([&] { return lfo.basePhase() != phase; });
+        double beats = (simulator.cycles() - first) / (tickCycles * ClockPll::TicksPerBeat);
+        double error = static_cast<int32_t>(lfo.basePhase() - static_cast<uint32_t>(std::fmod(beats, 1) * 4294967296.0));
+        maxError = std::max(maxError, std::fabs(error) / 4294967296.0);
+    }
+    EXPECT_LT(maxError, 0.002);
+
+    // Once the clock stops the LFO runs free at its own rate again
+    run(3000);
+    EXPECT_FALSE(state.clock.locked);
+    EXPECT_EQ(state.lfoDelta, lfo.phaseDeltaQ16(state.rate));
+
+    std::printf("[          ] locked %.0f ms after the first tick, within %.2f%% of a cycle of the beat\n",
+                lockMs - 1, maxError * 100);
+}
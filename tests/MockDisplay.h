@@ -0,0 +1,90 @@
+/**
+ * @file MockDisplay.h
+ * @author Gino Bollaert
+ * @brief Recording DisplayInterface for display tests
+ * @details Models a 128x32 SSD1306 on a 400 kHz I2C bus: it counts the bytes each call would send and the time the
+ * caller would block for, and keeps the text drawn into the current frame.
+ * @date 2023-06-21
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#pragma once
+
+#include "DisplayInterface.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+class MockDisplay : public DisplayInterface
+{
+public:
+    static constexpr int Pages = 4;
+    static constexpr int PageBytes = 128;
+    static constexpr double UsPerByte = 9 / 0.4; // 8 data bits and an ACK at 400 kHz
+
+    void clear() override
+    {
+        lines.clear();
+        lineY.clear();
+        clears++;
+    }
+    void clearRect(int x, int y, int w, int h) override
+    {
+        for (size_t i = lines.size(); i-- > 0;)
+        {
+            if (lineY[i] >= y && lineY[i] < y + h)
+            {
+                lines.erase(lines.begin() + i);
+                lineY.erase(lineY.begin() + i);
+            }
+        }
+        clearRects++;
+    }
+    void show() override
+    {
+        shows++;
+        send(Pages * PageBytes, true);
+    }
+    int width() override { return 128; }
+    int height() override { return 32; }
+    void requestFontHeight(int hgt) override {}
+    int fontHeight() override { return 12; }
+    void drawString(int x, int y, const char* s, Align align = Align::kLeft) override
+    {
+        lines.push_back(s);
+        lineY.push_back(y);
+        strings++;
+    }
+    int pageCount() override { return Pages; }
+    void showPage(int page) override { send(PageBytes, page == Pages - 1); }
+
+    /** Text drawn since the last clear(), and the top of each string */
+    std::vector<std::string> lines;
+    std::vector<int> lineY;
+    int clears = 0;
+    int clearRects = 0;
+    int shows = 0;
+    int strings = 0;
+    int calls = 0;
+    int frames = 0;
+    uint32_t bytes = 0;
+    double maxBlockingUs = 0;
+    std::vector<uint32_t> frameBytes;
+
+private:
+    void send(uint32_t count, bool endOfFrame)
+    {
+        calls++;
+        bytes += count;
+        _frameBytes += count;
+        maxBlockingUs = std::max(maxBlockingUs, count * UsPerByte);
+        if (endOfFrame)
+        {
+            frames++;
+            frameBytes.push_back(_frameBytes);
+            _frameBytes = 0;
+        }
+    }
+
+    uint32_t _frameBytes = 0;
+};
@@ -0,0 +1,96 @@
+/**
+ * @file OledDisplayTest.cpp
+ * @author Gino Bollaert
+ * @brief OledDisplay partial update tests against the recording U8g2 stub
+ * @details
+ * @date 2023-06-22
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "OledDisplay.h"
+#include <cstring>
+#include <gtest/gtest.h>
+
+namespace
+{
+class OledDisplayTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        display.init();
+        driver().resetStatistics();
+    }
+
+    U8G2_SSD1306_128X32_UNIVISION_F_HW_I2C& driver() { return display.driver(); }
+
+    uint32_t draw(const char* title, const char* value)
+    {
+        uint32_t before = driver().bytesSent();
+        display.clear();
+        display.drawString(0, 0, title);
+        display.drawString(0, 16, value);
+        display.show();
+        return driver().bytesSent() - before;
+    }
+
+    bool panelMatchesBuffer()
+    {
+        return memcmp(driver().panel(), driver().getBufferPtr(), 128 * 32 / 8) == 0;
+    }
+
+    OledDisplay display{PB6, PB7};
+};
+} // namespace
+
+TEST_F(OledDisplayTest, FirstFrameSendsOnlyTilesWithContent)
+{
+    uint32_t bytes = draw("Volume:", "100");
+    EXPECT_GT(bytes, 0u);
+    EXPECT_LT(bytes, 512u);
+    EXPECT_TRUE(panelMatchesBuffer());
+}
+
+TEST_F(OledDisplayTest, UnchangedFrameSendsNothing)
+{
+    draw("Volume:", "100");
+    uint32_t transfers = driver().transfers();
+    EXPECT_EQ(draw("Volume:", "100"), 0u);
+    EXPECT_EQ(driver().transfers(), transfers);
+}
+
+TEST_F(OledDisplayTest, ChangedValueSendsAFewDozenBytes)
+{
+    uint32_t full = draw("Volume:", "100");
+    uint32_t bytes = draw("Volume:", "101");
+    printf("[          ] first frame %u bytes, one digit changed %u bytes, full frame 512 bytes\n", full, bytes);
+    EXPECT_GT(bytes, 0u);
+    EXPECT_LE(bytes, 32u);
+    EXPECT_TRUE(panelMatchesBuffer());
+
+    bytes = draw("Volume:", "99");
+    EXPECT_LE(bytes, 64u);
+    EXPECT_TRUE(panelMatchesBuffer());
+}
+
+TEST_F(OledDisplayTest, ShowKeepsTheFrame)
+{
+    draw("Mode:", "Chorus");
+    uint8_t frame[128 * 32 / 8];
+    memcpy(frame, driver().getBufferPtr(), sizeof(frame));
+    display.show();
+    EXPECT_EQ(memcmp(frame, driver().getBufferPtr(), sizeof(frame)), 0);
+}
+
+TEST_F(OledDisplayTest, PagesCombineToTheWholeFrame)
+{
+    draw("Speed:", "48 rpm");
+    display.clear();
+    display.drawString(0, 0, "Ramp Time:");
+    display.drawString(0, 16, "1200 ms");
+    for (int page = 0; page < display.pageCount(); page++)
+    {
+        display.showPage(page);
+    }
+    EXPECT_TRUE(panelMatchesBuffer());
+}
@@ -0,0 +1,139 @@
+/**
+ * @file PotFilterTest.cpp
+ * @author Gino Bollaert
+ * @brief Pot filtering tests on synthesized ADC frames
+ * @details The frames interleave four channels as the firmware's scan does: the envelope input first, then three
+ * pots. The ADC noise is uniform, up to a few tens of LSB either way, as an STM32F103 can give on a pot's wiper.
+ * @date 2023-07-05
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "PotFilter.h"
+#include <algorithm>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace
+{
+constexpr int Channels = 4;
+constexpr int Block = 16;
+constexpr int OversampleBits = 6;
+constexpr uint8_t PotChannels[] = {1, 2, 3};
+constexpr double AdcRate = 72000000.0 / 4097;
+
+using Filter = PotFilter<3, OversampleBits>;
+
+class Frames
+{
+public:
+    explicit Frames(int noise) : _noise(-noise, noise) {}
+
+    /** One block of frames with the pots at `levels` plus noise, and a busy envelope input on channel 0 */
+    const uint16_t* block(const double* levels)
+    {
+        for (int i = 0; i < Block; i++)
+        {
+            _frames[i * Channels] = static_cast<uint16_t>(_random() & 0xfff);
+            for (int n = 0; n < 3; n++)
+            {
+                int sample = static_cast<int>(levels[n] + 0.5) + _noise(_random);
+                _frames[i * Channels + 1 + n] = static_cast<uint16_t>(sample < 0 ? 0 : sample > 4095 ? 4095 : sample);
+            }
+        }
+        return _frames;
+    }
+
+private:
+    std::mt19937 _random{7};
+    std::uniform_int_distribution<int> _noise;
+    uint16_t _frames[Block * Channels];
+};
+} // namespace
+
+TEST(PotFilter, FirstReadingSetsThePositionsWithoutChanges)
+{
+    Filter filter(PotChannels, Channels);
+    filter.reset();
+    Frames frames(0);
+    const double levels[] = {0, 2000, 4095};
+    for (int n = 0; n < 64; n++)
+    {
+        ASSERT_EQ(filter.process(frames.block(levels), Block), 0u);
+    }
+    EXPECT_EQ(filter.value(0), 0);
+    EXPECT_EQ(filter.value(1), 2000 / 32);
+    EXPECT_EQ(filter.value(2), 127);
+}
+
+TEST(PotFilter, NoiseDoesNotChatter)
+{
+    // Ten seconds of each pot sitting still on or near a value boundary, with noise well over the hysteresis
+    const double levels[] = {1024, 1040, 3001};
+    Filter filter(PotChannels, Channels);
+    filter.reset();
+    Frames frames(64);
+    PotController raw;
+    raw.reset(static_cast<int>(levels[0]));
+    int changes = 0;
+    int rawChanges = 0;
+    const int blocks = static_cast<int>(10 * AdcRate / Block);
+    for (int n = 0; n < blocks; n++)
+    {
+        const uint16_t* block = frames.block(levels);
+        changes += __builtin_popcount(filter.process(block, Block));
+        for (int i = 0; i < Block; i++)
+        {
+            rawChanges += raw.update(block[i * Channels + 1]);
+        }
+    }
+    EXPECT_EQ(changes, 0);
+    EXPECT_GT(rawChanges, 0);
+    std::printf("[          ] 10 s still with +/-64 LSB of noise: %d changes, %d on every raw sample\n", changes,
+                rawChanges);
+}
+
+TEST(PotFilter, TurningReportsEachValueOnce)
+{
+    // One pot turned up over a second and back down over half of one, the others left alone
+    Filter filter(PotChannels, Channels);
+    filter.reset();
+    Frames frames(24);
+    double levels[] = {0, 500, 3500};
+    filter.process(frames.block(levels), Block);
+
+    std::vector<int> reported;
+    const int upBlocks = static_cast<int>(AdcRate / Block);
+    const int downBlocks = upBlocks / 2;
+    for (int n = 0; n <= upBlocks + downBlocks + 100; n++)
+    {
+        levels[0] = n <= upBlocks ? 4095.0 * n / upBlocks
+                                  : std::max(0.0, 4095.0 * (1 - (n - upBlocks) / static_cast<double>(downBlocks)));
+        uint32_t changed = filter.process(frames.block(levels), Block);
+        ASSERT_EQ(changed & ~1u, 0u) << "block " << n;
+        if (changed)
+        {
+            reported.push_back(filter.value(0));
+        }
+    }
+
+    // Strictly up to the top, then strictly down to the bottom: no value reported twice in a row or going back
+    size_t top = std::max_element(reported.begin(), reported.end()) - reported.begin();
+    for (size_t i = 1; i < reported.size(); i++)
+    {
+        if (i <= top)
+        {
+            EXPECT_GT(reported[i], reported[i - 1]) << "change " << i;
+        }
+        else
+        {
+            EXPECT_LT(reported[i], reported[i - 1]) << "change " << i;
+        }
+    }
+    EXPECT_EQ(reported[top], 127);
+    EXPECT_EQ(reported.back(), 0);
+    // A pot read ~275 times a second can skip values when turned fast, but not many
+    EXPECT_GT(reported.size(), 200u);
+    std::printf("[          ] a full turn up and down: %zu changes reported\n", reported.size());
+}
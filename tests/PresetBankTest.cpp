@@ -0,0 +1,141 @@
+/**
+ * @file PresetBankTest.cpp
+ * @author Gino Bollaert
+ * @brief PresetBank tests on the flash model
+ * @details
+ * @date 2023-06-28
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "FileFlash.h"
+#include "PresetBank.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+constexpr uint32_t PageSize = 1024;
+
+struct Preset
+{
+    uint8_t controls[10];
+    uint32_t derived[40];
+};
+
+Preset makePreset(uint32_t n)
+{
+    Preset preset = {};
+    for (int i = 0; i < 10; i++)
+    {
+        preset.controls[i] = static_cast<uint8_t>((n + i) & 0x7f);
+    }
+    for (int i = 0; i < 40; i++)
+    {
+        preset.derived[i] = n * 0x10001 + i;
+    }
+    return preset;
+}
+
+bool operator==(const Preset& a, const Preset& b) { return memcmp(&a, &b, sizeof(Preset)) == 0; }
+
+constexpr int Count = 128;
+constexpr int Pages = PresetBank<Preset>::pagesFor(Count, PageSize);
+} // namespace
+
+TEST(PresetBank, EmptySlotsReadAsEmpty)
+{
+    sim::FileFlash flash(PageSize, Pages);
+    PresetBank<Preset> bank(flash, Count);
+    Preset preset = makePreset(3);
+    for (int index : {-1, 0, 5, Count - 1, Count})
+    {
+        EXPECT_FALSE(bank.read(index, preset)) << index;
+    }
+    EXPECT_EQ(preset, makePreset(3));
+}
+
+TEST(PresetBank, FillingTheBankNeedsNoErase)
+{
+    sim::FileFlash flash(PageSize, Pages);
+    PresetBank<Preset> bank(flash, Count);
+    for (int index = 0; index < Count; index++)
+    {
+        ASSERT_TRUE(bank.write(index, makePreset(index)));
+    }
+    EXPECT_EQ(flash.totalErases(), 0u);
+    EXPECT_EQ(flash.bytesProgrammed(), Count * PresetBank<Preset>::SlotBytes);
+    for (int index = 0; index < Count; index++)
+    {
+        Preset preset;
+        ASSERT_TRUE(bank.read(index, preset));
+        EXPECT_EQ(preset, makePreset(index));
+    }
+}
+
+TEST(PresetBank, OverwritingKeepsTheRestOfThePage)
+{
+    sim::FileFlash flash(PageSize, Pages);
+    PresetBank<Preset> bank(flash, Count);
+    for (int index = 0; index < Count; index++)
+    {
+        bank.write(index, makePreset(index));
+    }
+    ASSERT_TRUE(bank.write(7, makePreset(1000)));
+    ASSERT_TRUE(bank.write(Count - 1, makePreset(1001)));
+    EXPECT_EQ(flash.totalErases(), 2u);
+    EXPECT_EQ(flash.programErrors(), 0u);
+    for (int index = 0; index < Count; index++)
+    {
+        Preset preset;
+        ASSERT_TRUE(bank.read(index, preset));
+        EXPECT_EQ(preset, index == 7 ? makePreset(1000) : index == Count - 1 ? makePreset(1001) : makePreset(index));
+    }
+}
+
+TEST(PresetBank, StoringWhatIsThereWritesNothing)
+{
+    sim::FileFlash flash(PageSize, Pages);
+    PresetBank<Preset> bank(flash, Count);
+    bank.write(3, makePreset(3));
+    flash.resetStatistics();
+    ASSERT_TRUE(bank.write(3, makePreset(3)));
+    EXPECT_EQ(flash.totalErases(), 0u);
+    EXPECT_EQ(flash.bytesProgrammed(), 0u);
+}
+
+TEST(PresetBank, TornSlotReadsAsEmptyAndIsDroppedOnRewrite)
+{
+    sim::FileFlash flash(PageSize, Pages);
+    PresetBank<Preset> bank(flash, Count);
+    bank.write(0, makePreset(0));
+
+    // A power loss while slot 1 was programmed: its checksum was never written
+    uint16_t header[3] = {PresetBank<Preset>::Magic, sizeof(Preset), 0};
+    flash.program(0, PresetBank<Preset>::SlotBytes, header, 3);
+    Preset preset;
+    EXPECT_FALSE(bank.read(1, preset));
+
+    ASSERT_TRUE(bank.write(1, makePreset(11)));
+    ASSERT_TRUE(bank.read(1, preset));
+    EXPECT_EQ(preset, makePreset(11));
+    ASSERT_TRUE(bank.read(0, preset));
+    EXPECT_EQ(preset, makePreset(0));
+    EXPECT_EQ(flash.programErrors(), 0u);
+}
+
+TEST(PresetBank, SlotsOfAnotherFormatReadAsEmpty)
+{
+    sim::FileFlash flash(PageSize, Pages);
+    PresetBank<Preset> bank(flash, Count, 1);
+    ASSERT_TRUE(bank.write(2, makePreset(2)));
+    ASSERT_TRUE(bank.write(3, makePreset(3)));
+
+    // After a change to the layout the old presets are gone, and overwriting one drops the rest of its page
+    PresetBank<Preset> changed(flash, Count, 2);
+    Preset preset;
+    EXPECT_FALSE(changed.read(2, preset));
+    ASSERT_TRUE(changed.write(3, makePreset(33)));
+    EXPECT_FALSE(changed.read(2, preset));
+    ASSERT_TRUE(changed.read(3, preset));
+    EXPECT_EQ(preset, makePreset(33));
+    EXPECT_FALSE(bank.read(3, preset));
+}
@@ -0,0 +1,163 @@
+/**
+ * @file PwmDitherTest.cpp
+ * @author Gino Bollaert
+ * @brief Noise floor of the PWM outputs, truncated and dithered
+ * @details A slow, shallow tremolo is rendered as 16-bit levels at the sample rate and requantized to 12-bit compare
+ * values at the PWM rate, each level held for DownSample periods as TimerInterrupt() does. The error against the held
+ * levels is taken to the frequency domain (Hann window) and its power summed over the band the LFO can produce, up to
+ * half the sample rate; what lies above is left to the output filters.
+ * @date 2023-07-10
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "PwmDither.h"
+#include "Trace.h"
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+constexpr int Channels = 10;
+constexpr int Shift = 4;
+constexpr int DownSample = 35;
+constexpr double PwmRate = 72000000.0 / 4097;
+constexpr double SampleRate = PwmRate / DownSample;
+constexpr int Samples = 1024;
+constexpr int Periods = Samples * DownSample;
+
+/** 16-bit levels of a 1 Hz sine, `depth` LSBs either side of mid-scale, held for DownSample periods each */
+std::vector<uint16_t> heldLevels(double depth)
+{
+    std::vector<uint16_t> levels(Periods);
+    for (int i = 0; i < Samples; i++)
+    {
+        double v = 32768 + depth * std::sin(2 * M_PI * i / SampleRate);
+        for (int p = 0; p < DownSample; p++)
+        {
+            levels[i * DownSample + p] = static_cast<uint16_t>(std::lround(v));
+        }
+    }
+    return levels;
+}
+
+/** RMS of `error` (16-bit LSBs) from just above DC to half the sample rate, and its mean */
+struct Band
+{
+    double noiseRms = 0;
+    double dc = 0;
+};
+
+Band inBand(const std::vector<double>& error)
+{
+    const int n = static_cast<int>(error.size());
+    std::vector<double> windowed(n);
+    double windowPower = 0;
+    Band band;
+    for (int i = 0; i < n; i++)
+    {
+        double w = 0.5 - 0.5 * std::cos(2 * M_PI * i / n);
+        windowed[i] = error[i] * w;
+        windowPower += w * w;
+        band.dc += error[i] / n;
+    }
+    // Hann leaks DC into the first two bins
+    const int lastBin = static_cast<int>(SampleRate / 2 / (PwmRate / n));
+    double power = 0;
+    for (int k = 3; k <= lastBin; k++)
+    {
+        std::complex<double> sum = 0;
+        std::complex<double> rotation = std::polar(1.0, -2 * M_PI * k / n);
+        std::complex<double> phasor = 1;
+        for (int i = 0; i < n; i++)
+        {
+            sum += windowed[i] * phasor;
+            phasor *= rotation;
+        }
+        power += 2 * std::norm(sum) / (n * windowPower);
+    }
+    band.noiseRms = std::sqrt(power);
+    return band;
+}
+
+/** Error of the compare values (in 16-bit LSBs) against the levels for one channel */
+template <typename Requantize> std::vector<double> requantizationError(const std::vector<uint16_t>& levels, Requantize f)
+{
+    std::vector<double> error(levels.size());
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        error[i] = (f(levels[i]) << Shift) - static_cast<double>(levels[i]);
+    }
+    return error;
+}
+
+double db(double ratio) { return 20 * std::log10(ratio); }
+} // namespace
+
+TEST(PwmDither, CompareValuesAverageToTheLevel)
+{
+    PwmDither<1, Shift> dither;
+    for (uint16_t level : {0, 1, 7, 8, 15, 0x7ff9, 0xfff0, 0xffff})
+    {
+        dither.reset();
+        uint32_t sum = 0;
+        for (int p = 0; p < 1 << Shift; p++)
+        {
+            uint16_t compare;
+            dither.next(&level, &compare);
+            EXPECT_LE(compare, 1 << (16 - Shift));
+            sum += compare;
+        }
+        EXPECT_EQ(sum, level) << "level " << level;
+    }
+}
+
+TEST(PwmDither, LowersTheNoiseFloorOfSlowShallowModulation)
+{
+    // 1 Hz at 2.5 LSB either side, as a tremolo at 2% depth and low volume shows on 12 bits
+    std::vector<uint16_t> levels = heldLevels(40);
+    PwmDither<1, Shift> dither;
+    Band truncated = inBand(requantizationError(levels, [](uint16_t level) { return level >> Shift; }));
+    Band dithered = inBand(requantizationError(levels, [&](uint16_t level) {
+        uint16_t compare;
+        dither.next(&level, &compare);
+        return compare;
+    }));
+
+    // Dithered, what remains below half the sample rate is well under one 16-bit step, and there is no offset
+    EXPECT_LT(dithered.noiseRms, 0.25);
+    EXPECT_LT(std::fabs(dithered.dc), 0.01);
+    EXPECT_GT(db(truncated.noiseRms / dithered.noiseRms), 20);
+    std::printf("[          ] in-band error, 16-bit LSBs RMS: %.3f truncated (offset %.2f), %.4f dithered (offset %.4f)"
+                ", %.1f dB lower\n",
+                truncated.noiseRms, truncated.dc, dithered.noiseRms, dithered.dc,
+                db(truncated.noiseRms / dithered.noiseRms));
+}
+
+TEST(PwmDither, CostPerInterrupt)
+{
+    // One PWM period of all ten outputs, as TimerInterrupt() runs it between samples. Host time, in 72 MHz cycles.
+    PwmDither<Channels, Shift> dither;
+    uint16_t levels[Channels];
+    uint16_t compare[Channels];
+    for (int n = 0; n < Channels; n++)
+    {
+        levels[n] = static_cast<uint16_t>(0x1234 * (n + 1));
+    }
+    constexpr int Calls = 1000000;
+    uint32_t checksum = 0;
+    traceBegin();
+    uint32_t start = traceCycles();
+    for (int i = 0; i < Calls; i++)
+    {
+        dither.next(levels, compare);
+        checksum += compare[i % Channels];
+        levels[i % Channels] += 1;
+    }
+    double cycles = static_cast<double>(traceCycles() - start) / Calls;
+    EXPECT_NE(checksum, 0u);
+    std::printf("[          ] %.1f cycles per PWM period for %d outputs on the host, plus %d interrupts per sample\n",
+                cycles, Channels, DownSample - 1);
+}
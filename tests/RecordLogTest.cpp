@@ -0,0 +1,151 @@
+/**
+ * @file RecordLogTest.cpp
+ * @author Gino Bollaert
+ * @brief RecordLog tests on the file-backed flash model
+ * @details
+ * @date 2023-06-26
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "FileFlash.h"
+#include "RecordLog.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace
+{
+constexpr uint32_t PageSize = 1024;
+constexpr int Pages = 4;
+
+struct Settings
+{
+    uint8_t controls[10];
+};
+
+Settings makeSettings(uint32_t n)
+{
+    Settings settings;
+    for (int i = 0; i < 10; i++)
+    {
+        settings.controls[i] = static_cast<uint8_t>((n + i) & 0x7f);
+    }
+    return settings;
+}
+
+bool operator==(const Settings& a, const Settings& b) { return memcmp(&a, &b, sizeof(Settings)) == 0; }
+
+class RecordLogTest : public ::testing::Test
+{
+protected:
+    void SetUp() override { std::remove(path.c_str()); }
+    void TearDown() override { std::remove(path.c_str()); }
+
+    std::string path = ::testing::TempDir() + "lfo-record-log.bin";
+};
+} // namespace
+
+TEST_F(RecordLogTest, EmptyFlashRestoresNothing)
+{
+    sim::FileFlash flash(PageSize, Pages);
+    RecordLog<Settings> log(flash);
+    Settings settings = makeSettings(7);
+    EXPECT_FALSE(log.restore(settings));
+    EXPECT_EQ(settings, makeSettings(7));
+}
+
+TEST_F(RecordLogTest, RestoresTheLatestRecordAfterAPowerCycle)
+{
+    for (uint32_t saves : {1u, 45u, 46u, 47u, 184u, 500u})
+    {
+        {
+            sim::FileFlash flash(PageSize, Pages, path);
+            flash.eraseAll();
+            RecordLog<Settings> log(flash);
+            for (uint32_t n = 1; n <= saves; n++)
+            {
+                ASSERT_TRUE(log.append(makeSettings(n)));
+            }
+        }
+        sim::FileFlash flash(PageSize, Pages, path);
+        RecordLog<Settings> log(flash);
+        Settings settings = {};
+        ASSERT_TRUE(log.restore(settings)) << saves << " saves";
+        EXPECT_EQ(settings, makeSettings(saves)) << saves << " saves";
+        EXPECT_EQ(log.sequence(), saves);
+
+        // Appending carries on after the restored record
+        ASSERT_TRUE(log.append(makeSettings(saves + 1)));
+        EXPECT_EQ(flash.programErrors(), 0u);
+        RecordLog<Settings> again(flash);
+        ASSERT_TRUE(again.restore(settings));
+        EXPECT_EQ(settings, makeSettings(saves + 1));
+    }
+}
+
+TEST_F(RecordLogTest, TornRecordIsSkipped)
+{
+    sim::FileFlash flash(PageSize, Pages);
+    RecordLog<Settings> log(flash);
+    for (uint32_t n = 1; n <= 10; n++)
+    {
+        log.append(makeSettings(n));
+    }
+
+    // A power loss while the 11th record was programmed: its checksum was never written
+    const uint32_t offset = 10 * RecordLog<Settings>::RecordBytes;
+    uint16_t header[4] = {RecordLog<Settings>::Magic, sizeof(Settings), 11, 0};
+    flash.program(0, offset, header, 4);
+
+    RecordLog<Settings> restored(flash);
+    Settings settings = {};
+    ASSERT_TRUE(restored.restore(settings));
+    EXPECT_EQ(settings, makeSettings(10));
+    ASSERT_TRUE(restored.append(makeSettings(12)));
+    EXPECT_EQ(flash.programErrors(), 0u);
+    ASSERT_TRUE(RecordLog<Settings>(flash).restore(settings));
+    EXPECT_EQ(settings, makeSettings(12));
+}
+
+TEST_F(RecordLogTest, WearIsLevelledAndBootScanIsBounded)
+{
+    constexpr uint32_t Saves = 10000;
+    sim::FileFlash flash(PageSize, Pages, path);
+    RecordLog<Settings> log(flash);
+    for (uint32_t n = 1; n <= Saves; n++)
+    {
+        ASSERT_TRUE(log.append(makeSettings(n)));
+    }
+    EXPECT_EQ(flash.programErrors(), 0u);
+
+    uint32_t minErases = flash.erases(0);
+    uint32_t maxErases = flash.erases(0);
+    for (int page = 1; page < Pages; page++)
+    {
+        minErases = std::min(minErases, flash.erases(page));
+        maxErases = std::max(maxErases, flash.erases(page));
+    }
+    EXPECT_LE(maxErases - minErases, 1u);
+
+    const double programmed = static_cast<double>(flash.bytesProgrammed()) / (Saves * sizeof(Settings));
+    const double erased = static_cast<double>(flash.totalErases()) * PageSize / (Saves * sizeof(Settings));
+    EXPECT_EQ(flash.totalErases(), (Saves + log.slotsPerPage() - 1) / log.slotsPerPage());
+
+    // Boot: the first record of every page, then the newest page up to its first blank slot
+    sim::FileFlash boot(PageSize, Pages, path);
+    RecordLog<Settings> restored(boot);
+    Settings settings = {};
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(restored.restore(settings));
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(settings, makeSettings(Saves));
+    EXPECT_LE(restored.scannedBytes(), (Pages + log.slotsPerPage()) * RecordLog<Settings>::RecordBytes);
+
+    std::printf("[          ] %u saves of %zu bytes: %.2f bytes programmed and %.1f bytes erased per payload byte, "
+                "%u-%u erases per page\n",
+                Saves, sizeof(Settings), programmed, erased, minErases, maxErases);
+    std::printf("[          ] boot scan: %u of %u bytes read, %lld ns on the host\n", restored.scannedBytes(),
+                PageSize * Pages, static_cast<long long>(ns));
+}
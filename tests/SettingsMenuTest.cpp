@@ -0,0 +1,266 @@
+/**
+ * @file SettingsMenuTest.cpp
+ * @author Gino Bollaert
+ * @brief SettingsMenu navigation tests on linked and prebuilt trees
+ * @details The encoder is turned and pressed through the simulator's pins, as the hardware would.
+ * @date 2023-06-25
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "MockDisplay.h"
+#include "SettingsMenu.h"
+#include "Simulator.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+constexpr int PinButton = PB12;
+constexpr int PinA = PB13;
+constexpr int PinB = PB14;
+
+class CountingAction : public Action
+{
+public:
+    using Action::Action;
+    void perform() override { performed++; }
+    int performed = 0;
+};
+
+class TestMenu : public SettingsMenu
+{
+public:
+    using SettingsMenu::context;
+    using SettingsMenu::selectedItem;
+    using SettingsMenu::SettingsMenu;
+};
+
+int channel = 1;
+int mode = 0;
+int depth = 50;
+const char* modes[] = {"Vibrato", "Chorus", "Rotary"};
+
+Menu root("Settings");
+IntSetting channelSetting("Channel", channel, 1, 16, 1);
+Menu voiceMenu("Voice");
+CountingAction tuneAction("Tune");
+ChoiceSetting modeSetting("Mode", mode, modes, 3, 0);
+IntSetting depthSetting("Depth", depth, 0, 100, 50);
+
+constexpr MenuNode Tree[] = {
+    {&root, MenuNode::kNone, 1, 3},
+    {&channelSetting, 0, 0, 0},
+    {&voiceMenu, 0, 4, 2},
+    {&tuneAction, 0, 0, 0},
+    {&modeSetting, 2, 0, 0},
+    {&depthSetting, 2, 0, 0},
+};
+static_assert(isValidMenuTree(Tree), "children must follow their parent and point back to it");
+
+constexpr MenuNode BrokenTree[] = {
+    {&root, MenuNode::kNone, 1, 2},
+    {&channelSetting, 0, 0, 0},
+    {&voiceMenu, 1, 0, 0},
+};
+static_assert(!isValidMenuTree(BrokenTree), "a child pointing to the wrong parent is rejected");
+
+class SettingsMenuTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        simulator.reset();
+        simulator.setPin(PinA, HIGH);
+        simulator.setPin(PinB, HIGH);
+        simulator.setPin(PinButton, HIGH);
+        channel = 1;
+        mode = 0;
+        depth = 50;
+    }
+
+    /** Turns the encoder by `clicks` detents, clockwise when positive */
+    void turn(TestMenu& menu, int clicks)
+    {
+        static const uint8_t states[] = {3, 1, 0, 2};
+        for (int step = 0; step < 2 * std::abs(clicks); step++)
+        {
+            _quadrature = (_quadrature + (clicks > 0 ? 1 : 3)) % 4;
+            simulator.setPin(PinA, states[_quadrature] & 1 ? HIGH : LOW);
+            simulator.setPin(PinB, states[_quadrature] & 2 ? HIGH : LOW);
+            rotary.update();
+        }
+        menu.updateRotary();
+    }
+
+    void tap(TestMenu& menu)
+    {
+        simulator.setPin(PinButton, LOW);
+        rotary.update();
+        simulator.setPin(PinButton, HIGH);
+        rotary.update();
+        menu.updateRotary();
+    }
+
+    sim::Simulator& simulator = sim::Simulator::instance();
+    MockDisplay display;
+    RotaryButton rotary{PinButton, PinA, PinB, INPUT_PULLUP, false};
+
+private:
+    int _quadrature = 0;
+};
+} // namespace
+
+TEST_F(SettingsMenuTest, LinkedItemsAreFlattenedWhenShown)
+{
+    TestMenu menu(&display, rotary);
+    int level = 3;
+    Menu* sub = new Menu("Sub");
+    menu.addChild(new IntSetting("Level", level, 0, 10, 3));
+    menu.addChild(sub);
+    sub->addChild(new IntSetting("Inner", level, 0, 10, 3));
+    sub->addChild(menu.createBackAction());
+
+    menu.updateRotary();
+    EXPECT_EQ(menu.context(), &menu);
+    EXPECT_STREQ(menu.selectedItem()->name(), "Level");
+    ASSERT_GE(display.lines.size(), 5u);
+    EXPECT_EQ(display.lines[0], ">");
+    EXPECT_EQ(display.lines[1], "Level");
+    EXPECT_EQ(display.lines[2], "3");
+
+    turn(menu, 1);
+    EXPECT_STREQ(menu.selectedItem()->name(), "Sub");
+    tap(menu);
+    EXPECT_EQ(menu.context(), sub);
+    EXPECT_STREQ(menu.selectedItem()->name(), "Inner");
+    turn(menu, 1);
+    tap(menu);
+    EXPECT_EQ(menu.context(), &menu);
+    EXPECT_EQ(menu.selectedItem(), sub);
+}
+
+TEST_F(SettingsMenuTest, PrebuiltTreeNavigatesByIndex)
+{
+    TestMenu menu(&display, rotary);
+    menu.setTree(Tree);
+    menu.updateRotary();
+    EXPECT_EQ(menu.context(), &root);
+    EXPECT_EQ(menu.selectedItem(), &channelSetting);
+
+    turn(menu, 5);
+    EXPECT_EQ(menu.selectedItem(), &tuneAction);
+    tap(menu);
+    EXPECT_EQ(tuneAction.performed, 1);
+
+    turn(menu, -1);
+    tap(menu);
+    EXPECT_EQ(menu.context(), &voiceMenu);
+    EXPECT_EQ(menu.selectedItem(), &modeSetting);
+
+    turn(menu, 1);
+    tap(menu);
+    turn(menu, -7);
+    tap(menu);
+    EXPECT_EQ(depth, 43);
+    EXPECT_EQ(menu.selectedItem(), &depthSetting);
+
+    menu.navigateToItem(&channelSetting);
+    EXPECT_EQ(menu.context(), &root);
+    EXPECT_EQ(menu.selectedItem(), &channelSetting);
+}
+
+TEST_F(SettingsMenuTest, ChoiceSettingIsEditedInItsOwnList)
+{
+    TestMenu menu(&display, rotary);
+    menu.setTree(Tree);
+    menu.updateRotary();
+    menu.navigateToItem(&modeSetting);
+    tap(menu);
+    EXPECT_EQ(menu.context(), &modeSetting);
+    turn(menu, 2);
+    tap(menu);
+    EXPECT_EQ(mode, 2);
+    EXPECT_EQ(menu.context(), &voiceMenu);
+    EXPECT_EQ(menu.selectedItem(), &modeSetting);
+}
+
+TEST_F(SettingsMenuTest, ResetToDefaultsVisitsTheWholeTree)
+{
+    TestMenu menu(&display, rotary);
+    menu.setTree(Tree);
+    channel = 9;
+    mode = 1;
+    depth = 0;
+    menu.resetToDefaults();
+    EXPECT_EQ(channel, 1);
+    EXPECT_EQ(mode, 0);
+    EXPECT_EQ(depth, 50);
+}
+
+TEST_F(SettingsMenuTest, IdleMenuIsNotRedrawn)
+{
+    TestMenu menu(&display, rotary);
+    menu.setTree(Tree);
+    menu.updateRotary();
+    EXPECT_EQ(display.shows, 1);
+
+    // One minute of polling at 1 kHz with the encoder untouched
+    for (int ms = 0; ms < 60000; ms++)
+    {
+        rotary.update();
+        menu.updateRotary();
+    }
+    EXPECT_EQ(display.shows, 1);
+    EXPECT_EQ(display.strings, 5);
+
+    // Navigating redraws once per step that moves the selection; steps against either end of the list do not
+    int before = display.shows;
+    for (int i = 0; i < 10; i++)
+    {
+        turn(menu, 1);
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        turn(menu, -1);
+    }
+    EXPECT_EQ(display.shows - before, 4);
+}
+
+TEST_F(SettingsMenuTest, SelectionMoveRedrawsOnlyTheTwoLinesInvolved)
+{
+    TestMenu menu(&display, rotary);
+    menu.setTree(Tree);
+    menu.updateRotary();
+    ASSERT_EQ(display.clears, 1);
+
+    turn(menu, 1);
+    EXPECT_EQ(display.clears, 1);
+    EXPECT_EQ(display.clearRects, 2);
+    EXPECT_EQ(display.lines, (std::vector<std::string>{"Channel", "1", ">", "Voice", "..."}));
+
+    // Scrolling moves every line, so the whole display is redrawn
+    turn(menu, 1);
+    EXPECT_EQ(display.clears, 2);
+    EXPECT_EQ(display.clearRects, 2);
+    EXPECT_EQ(display.lines, (std::vector<std::string>{"Voice", "...", ">", "Tune", ""}));
+}
+
+TEST_F(SettingsMenuTest, EditingRedrawsOnlyTheEditedLine)
+{
+    TestMenu menu(&display, rotary);
+    menu.setTree(Tree);
+    menu.updateRotary();
+    tap(menu);
+    EXPECT_EQ(display.clearRects, 1);
+    int strings = display.strings;
+
+    turn(menu, 3);
+    EXPECT_EQ(channel, 4);
+    EXPECT_EQ(display.clears, 1);
+    EXPECT_EQ(display.clearRects, 2);
+    EXPECT_EQ(display.strings - strings, 2);
+    EXPECT_EQ(display.lines, (std::vector<std::string>{"Voice", "...", "Channel", "< 4 >"}));
+
+    tap(menu);
+    EXPECT_EQ(display.clearRects, 3);
+    EXPECT_EQ(display.lines, (std::vector<std::string>{"Voice", "...", ">", "Channel", "4"}));
+}
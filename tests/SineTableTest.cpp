@@ -0,0 +1,181 @@
+/**
+ * @file SineTableTest.cpp
+ * @author Gino Bollaert
+ * @brief Compile-time sine table and interpolation tests
+ * @details
+ * @date 2023-06-14
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "SinePolynomial.h"
+#include "SineTable.h"
+#include "WaveTable.h"
+#include <cmath>
+#include <cstdio>
+#include <gtest/gtest.h>
+
+namespace
+{
+// The table that used to be pasted into WaveTable.h, as printed by gen-sine
+/* clang-format off */
+const uint16_t LegacyTable[256] = {
+  0x0, 0xa, 0x27, 0x59, 0x9e, 0xf6, 0x163, 0x1e2,
+  0x276, 0x31c, 0x3d6, 0x4a3, 0x583, 0x676, 0x77b, 0x894,
+  0x9be, 0xafb, 0xc4a, 0xdab, 0xf1d, 0x10a1, 0x1236, 0x13dc,
+  0x1592, 0x1759, 0x1930, 0x1b17, 0x1d0e, 0x1f14, 0x2128, 0x234c,
+  0x257d, 0x27bd, 0x2a0a, 0x2c65, 0x2ecc, 0x3140, 0x33c0, 0x364c,
+  0x38e3, 0x3b85, 0x3e32, 0x40e8, 0x43a9, 0x4673, 0x4946, 0x4c21,
+  0x4f04, 0x51ef, 0x54e0, 0x57d9, 0x5ad8, 0x5ddc, 0x60e6, 0x63f4,
+  0x6707, 0x6a1e, 0x6d38, 0x7054, 0x7374, 0x7695, 0x79b8, 0x7cdb,
+  0x7fff, 0x8324, 0x8647, 0x896a, 0x8c8b, 0x8fab, 0x92c7, 0x95e1,
+  0x98f8, 0x9c0b, 0x9f19, 0xa223, 0xa527, 0xa826, 0xab1f, 0xae10,
+  0xb0fb, 0xb3de, 0xb6b9, 0xb98c, 0xbc56, 0xbf17, 0xc1cd, 0xc47a,
+  0xc71c, 0xc9b3, 0xcc3f, 0xcebf, 0xd133, 0xd39a, 0xd5f5, 0xd842,
+  0xda82, 0xdcb3, 0xded7, 0xe0eb, 0xe2f1, 0xe4e8, 0xe6cf, 0xe8a6,
+  0xea6d, 0xec23, 0xedc9, 0xef5e, 0xf0e2, 0xf254, 0xf3b5, 0xf504,
+  0xf641, 0xf76b, 0xf884, 0xf989, 0xfa7c, 0xfb5c, 0xfc29, 0xfce3,
+  0xfd89, 0xfe1d, 0xfe9c, 0xff09, 0xff61, 0xffa6, 0xffd8, 0xfff5,
+  0xffff, 0xfff5, 0xffd8, 0xffa6, 0xff61, 0xff09, 0xfe9c, 0xfe1d,
+  0xfd89, 0xfce3, 0xfc29, 0xfb5c, 0xfa7c, 0xf989, 0xf884, 0xf76b,
+  0xf641, 0xf504, 0xf3b5, 0xf254, 0xf0e2, 0xef5e, 0xedc9, 0xec23,
+  0xea6d, 0xe8a6, 0xe6cf, 0xe4e8, 0xe2f1, 0xe0eb, 0xded7, 0xdcb3,
+  0xda82, 0xd842, 0xd5f5, 0xd39a, 0xd133, 0xcebf, 0xcc3f, 0xc9b3,
+  0xc71c, 0xc47a, 0xc1cd, 0xbf17, 0xbc56, 0xb98c, 0xb6b9, 0xb3de,
+  0xb0fb, 0xae10, 0xab1f, 0xa826, 0xa527, 0xa223, 0x9f19, 0x9c0b,
+  0x98f8, 0x95e1, 0x92c7, 0x8fab, 0x8c8b, 0x896a, 0x8647, 0x8324,
+  0x8000, 0x7cdb, 0x79b8, 0x7695, 0x7374, 0x7054, 0x6d38, 0x6a1e,
+  0x6707, 0x63f4, 0x60e6, 0x5ddc, 0x5ad8, 0x57d9, 0x54e0, 0x51ef,
+  0x4f04, 0x4c21, 0x4946, 0x4673, 0x43a9, 0x40e8, 0x3e32, 0x3b85,
+  0x38e3, 0x364c, 0x33c0, 0x3140, 0x2ecc, 0x2c65, 0x2a0a, 0x27bd,
+  0x257d, 0x234c, 0x2128, 0x1f14, 0x1d0e, 0x1b17, 0x1930, 0x1759,
+  0x1592, 0x13dc, 0x1236, 0x10a1, 0xf1d, 0xdab, 0xc4a, 0xafb,
+  0x9be, 0x894, 0x77b, 0x676, 0x583, 0x4a3, 0x3d6, 0x31c,
+  0x276, 0x1e2, 0x163, 0xf6, 0x9e, 0x59, 0x27, 0xa,
+};
+/* clang-format on */
+
+template <typename Table, typename Interpolation> double maxError()
+{
+    constexpr double Pi = 3.14159265358979323846;
+    double worst = 0;
+    for (uint32_t i = 0; i < (1u << 20); i++)
+    {
+        uint32_t phase = (i << 12) + (i * 2654435761u >> 20); // spread over the fraction bits as well
+        double ideal = (1 - std::cos(2 * Pi * (phase / 4294967296.0))) / 2 * 0xffff;
+        worst = std::max(worst, std::fabs(Interpolation::template sample<Table>(phase) - ideal));
+    }
+    return worst;
+}
+
+template <int Bits, bool QuarterWave, typename Interpolation>
+void reportMaxError(const char* interpolation, double bound)
+{
+    using Table = RaisedCosineTable<Bits, QuarterWave>;
+    double error = maxError<Table, Interpolation>();
+    std::printf("[          ] %5u entries%s, %-6s: %5u bytes, max error %8.3f LSB\n", Table::Size,
+                QuarterWave ? " (quarter)" : "          ", interpolation,
+                static_cast<unsigned>(Table::StoredSize * sizeof(uint16_t)), error);
+    EXPECT_LT(error, bound) << Table::Size << " entries, " << interpolation;
+}
+
+template <int Bits, bool QuarterWave> void reportAllInterpolations(double none, double linear, double cubic)
+{
+    reportMaxError<Bits, QuarterWave, NoInterpolation>("none", none);
+    reportMaxError<Bits, QuarterWave, LinearInterpolation>("linear", linear);
+    reportMaxError<Bits, QuarterWave, CubicInterpolation>("cubic", cubic);
+}
+} // namespace
+
+TEST(SineTable, DefaultMatchesLegacyTable)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        ASSERT_EQ(RaisedCosineTable<8>::at(i), LegacyTable[i]) << "index " << i;
+    }
+}
+
+TEST(SineTable, QuarterWaveMatchesFullTable)
+{
+    for (uint32_t i = 0; i < RaisedCosineTable<10>::Size; i++)
+    {
+        ASSERT_EQ((RaisedCosineTable<10, true>::at(i)), RaisedCosineTable<10>::at(i)) << "index " << i;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        ASSERT_EQ((RaisedCosineTable<8, true>::at(i)), LegacyTable[i]) << "index " << i;
+    }
+}
+
+TEST(SineTable, GeneratedAtCompileTime)
+{
+    static_assert(RaisedCosineTable<8>::at(0) == 0);
+    static_assert(RaisedCosineTable<8>::at(128) == 0xffff);
+    static_assert(RaisedCosineTable<12, true>::at(3 * 1024) == 0x8000);
+    static_assert(sizeof(RaisedCosineTable<12, true>) == 1);
+}
+
+TEST(SineTable, MaxErrorPerConfiguration)
+{
+    // Bounds are a little above the measured errors, to catch regressions
+    reportAllInterpolations<6, false>(3300, 45, 2);
+    reportAllInterpolations<6, true>(3300, 45, 2);
+    reportAllInterpolations<8, false>(820, 4, 1.5);
+    reportAllInterpolations<8, true>(820, 4, 1.5);
+    reportAllInterpolations<10, false>(210, 2, 1.5);
+    reportAllInterpolations<10, true>(210, 2, 1.5);
+}
+
+TEST(SineTable, PolynomialMaxError)
+{
+    constexpr double Pi = 3.14159265358979323846;
+    double ideal = 0;
+    double table = 0;
+    for (uint32_t i = 0; i < (1u << 20); i++)
+    {
+        uint32_t phase = (i << 12) + (i * 2654435761u >> 20);
+        double exact = (1 - std::cos(2 * Pi * (phase / 4294967296.0))) / 2 * 0xffff;
+        int polynomial = PolynomialSine::evaluate(phase);
+        ideal = std::max(ideal, std::fabs(polynomial - exact));
+        table = std::max(table, std::fabs(polynomial - LinearInterpolation::sample<RaisedCosineTable<8>>(phase)));
+    }
+    std::printf("[          ] polynomial: 0 bytes, max error %.3f LSB, %.3f LSB from the default table\n", ideal, table);
+    EXPECT_LT(ideal, 1);
+    EXPECT_LE(table, 4);
+    EXPECT_EQ(PolynomialSine::evaluate(0), 0);
+    EXPECT_EQ(PolynomialSine::evaluate(0x80000000u), 0xffff);
+}
+
+TEST(SineTable, PolynomialRenderBlockMatchesPerSample)
+{
+    WaveTable<9, RaisedCosineTable<8>, PolynomialSine> block(502, 0.75f);
+    WaveTable<9, RaisedCosineTable<8>, PolynomialSine> reference(502, 0.75f);
+    for (int n = 0; n < 9; n++)
+    {
+        block.setPhaseOffset(n * 0x1c71c71cu, n);
+        reference.setPhaseOffset(n * 0x1c71c71cu, n);
+    }
+    uint16_t out[9 * 64];
+    block.renderBlock(out, 64);
+    for (int k = 0; k < 64; k++)
+    {
+        reference.advance();
+        for (int n = 0; n < 9; n++)
+        {
+            ASSERT_EQ(out[n * 64 + k], reference.sampleIP(n)) << "frame " << k << ", phase " << n;
+        }
+    }
+}
+
+TEST(SineTable, DefaultWaveTableIsUnchanged)
+{
+    // The default WaveTable keeps the legacy 256-entry table and linear interpolation
+    WaveTable<1> lfo(502, 0.75f);
+    WaveTable<1, RaisedCosineTable<8, true>, LinearInterpolation> quarter(502, 0.75f);
+    for (int k = 0; k < 2000; k++)
+    {
+        lfo.advance();
+        quarter.advance();
+        ASSERT_EQ(lfo.sampleIP(), quarter.sampleIP()) << "frame " << k;
+        ASSERT_EQ(lfo.sample(), quarter.sample()) << "frame " << k;
+    }
+}
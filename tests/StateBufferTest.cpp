@@ -0,0 +1,91 @@
+/**
+ * @file StateBufferTest.cpp
+ * @author Gino Bollaert
+ * @brief StateBuffer tests
+ * @details
+ * @date 2023-06-07
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "StateBuffer.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+namespace
+{
+// Every field carries the same sequence number, so a torn snapshot shows up as a mismatch
+struct Frame
+{
+    uint32_t sequence = 0;
+    uint32_t fields[63] = {};
+};
+
+Frame makeFrame(uint32_t sequence)
+{
+    Frame frame;
+    frame.sequence = sequence;
+    for (uint32_t& field : frame.fields)
+    {
+        field = sequence;
+    }
+    return frame;
+}
+} // namespace
+
+TEST(StateBuffer, ReturnsLatestPublished)
+{
+    StateBuffer<Frame> buffer;
+    EXPECT_EQ(buffer.acquire().sequence, 0u);
+    buffer.publish(makeFrame(1));
+    EXPECT_EQ(buffer.acquire().sequence, 1u);
+    EXPECT_EQ(buffer.acquire().sequence, 1u);
+    buffer.publish(makeFrame(2));
+    buffer.publish(makeFrame(3));
+    buffer.publish(makeFrame(4));
+    EXPECT_EQ(buffer.acquire().sequence, 4u);
+}
+
+TEST(StateBuffer, ConcurrentPublishAndAcquireNeverTear)
+{
+    constexpr uint32_t Publishes = 500000;
+    StateBuffer<Frame> buffer;
+    std::atomic<bool> done{false};
+    uint64_t reads = 0;
+    uint32_t torn = 0;
+    uint32_t backwards = 0;
+
+    std::thread reader([&]() {
+        uint32_t last = 0;
+        while (!done.load(std::memory_order_acquire))
+        {
+            const Frame& frame = buffer.acquire();
+            for (uint32_t field : frame.fields)
+            {
+                if (field != frame.sequence)
+                {
+                    torn++;
+                    break;
+                }
+            }
+            if (frame.sequence < last)
+            {
+                backwards++;
+            }
+            last = frame.sequence;
+            reads++;
+        }
+    });
+
+    for (uint32_t sequence = 1; sequence <= Publishes; sequence++)
+    {
+        buffer.publish(makeFrame(sequence));
+    }
+    done.store(true, std::memory_order_release);
+    reader.join();
+
+    EXPECT_EQ(torn, 0u);
+    EXPECT_EQ(backwards, 0u);
+    EXPECT_GT(reads, 0u);
+    EXPECT_EQ(buffer.acquire().sequence, Publishes);
+}
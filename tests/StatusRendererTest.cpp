@@ -0,0 +1,82 @@
+/**
+ * @file StatusRendererTest.cpp
+ * @author Gino Bollaert
+ * @brief StatusRenderer tests
+ * @details
+ * @date 2023-06-21
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "MockDisplay.h"
+#include "StatusRenderer.h"
+#include <gtest/gtest.h>
+
+TEST(StatusRenderer, SetOnlyMarksTheStatusDirty)
+{
+    MockDisplay display;
+    StatusRenderer status(display);
+    status.set("Volume:", "100");
+    EXPECT_TRUE(status.busy());
+    EXPECT_EQ(display.calls, 0);
+    EXPECT_EQ(display.clears, 0);
+}
+
+TEST(StatusRenderer, SendsOnePagePerUpdate)
+{
+    MockDisplay display;
+    StatusRenderer status(display);
+    status.set("Volume:", "100");
+    uint32_t now = StatusRenderer::FrameIntervalMs;
+    for (int page = 0; page < MockDisplay::Pages; page++)
+    {
+        status.update(now++);
+        EXPECT_EQ(display.calls, page + 1);
+    }
+    EXPECT_FALSE(status.busy());
+    status.update(now++);
+    EXPECT_EQ(display.calls, MockDisplay::Pages);
+
+    ASSERT_EQ(display.frames, 1);
+    EXPECT_EQ(display.frameBytes[0], 512u);
+    EXPECT_DOUBLE_EQ(display.maxBlockingUs, MockDisplay::PageBytes * MockDisplay::UsPerByte);
+    EXPECT_EQ(display.lines, (std::vector<std::string>{"Volume:", "100"}));
+}
+
+TEST(StatusRenderer, UnchangedStatusSendsNothing)
+{
+    MockDisplay display;
+    StatusRenderer status(display);
+    status.set("Mode:", "Chorus");
+    for (uint32_t now = 0; now < 100; now++)
+    {
+        status.update(now);
+    }
+    int calls = display.calls;
+    status.set("Mode:", "Chorus");
+    EXPECT_FALSE(status.busy());
+    for (uint32_t now = 100; now < 200; now++)
+    {
+        status.update(now);
+    }
+    EXPECT_EQ(display.calls, calls);
+}
+
+TEST(StatusRenderer, SweepIsRateLimitedAndEndsOnTheLatestValue)
+{
+    MockDisplay display;
+    StatusRenderer status(display);
+    // A value change every millisecond for 300 ms, with loop() calling update() every millisecond too
+    for (uint32_t now = 0; now < 300; now++)
+    {
+        status.set("Expression:", String(static_cast<int>(now)).c_str());
+        status.update(now);
+    }
+    for (uint32_t now = 300; now < 400; now++)
+    {
+        status.update(now);
+    }
+    EXPECT_LE(display.frames, 300 / static_cast<int>(StatusRenderer::FrameIntervalMs) + 2);
+    EXPECT_EQ(display.calls, display.frames * MockDisplay::Pages);
+    EXPECT_EQ(display.lines, (std::vector<std::string>{"Expression:", "299"}));
+    EXPECT_LE(display.maxBlockingUs, MockDisplay::PageBytes * MockDisplay::UsPerByte);
+}
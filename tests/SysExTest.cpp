@@ -0,0 +1,102 @@
+/**
+ * @file SysExTest.cpp
+ * @author Gino Bollaert
+ * @brief SysExReader and SysExWriter tests
+ * @details
+ * @date 2023-06-30
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "SysEx.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+std::vector<uint8_t> makeMessage(SysEx::Command command, uint8_t index, const std::vector<uint8_t>& payload,
+                                 uint8_t format = 3)
+{
+    std::vector<uint8_t> message(SysEx::messageSize(payload.size()));
+    SysExWriter writer(message.data(), format, command, index);
+    writer.write(payload.data(), payload.size());
+    EXPECT_EQ(writer.finish(), message.size());
+    return message;
+}
+
+/** Feeds the bytes between F0 and F7 to `reader` and returns what end() says */
+template <int N> bool receive(SysExReader<N>& reader, const std::vector<uint8_t>& message)
+{
+    reader.reset();
+    for (size_t i = 1; i + 1 < message.size(); i++)
+    {
+        reader.push(message[i]);
+    }
+    return reader.end();
+}
+
+std::vector<uint8_t> makePayload(size_t size)
+{
+    std::vector<uint8_t> payload(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        payload[i] = static_cast<uint8_t>(i * 37 + 0x85);
+    }
+    return payload;
+}
+} // namespace
+
+TEST(SysEx, RoundTripsEveryPayloadSize)
+{
+    SysExReader<64> reader;
+    for (size_t size = 0; size <= 64; size++)
+    {
+        std::vector<uint8_t> payload = makePayload(size);
+        std::vector<uint8_t> message = makeMessage(SysEx::Command::Preset, 42, payload);
+        ASSERT_EQ(message.front(), SysEx::Start);
+        ASSERT_EQ(message.back(), SysEx::End);
+        for (size_t i = 1; i + 1 < message.size(); i++)
+        {
+            ASSERT_LT(message[i], 0x80) << size;
+        }
+        ASSERT_TRUE(receive(reader, message)) << size;
+        EXPECT_EQ(reader.format(), 3);
+        EXPECT_EQ(reader.command(), SysEx::Command::Preset);
+        EXPECT_EQ(reader.index(), 42);
+        ASSERT_EQ(reader.size(), static_cast<int>(size));
+        EXPECT_TRUE(std::equal(payload.begin(), payload.end(), reader.payload())) << size;
+    }
+}
+
+TEST(SysEx, CorruptedMessagesAreRejected)
+{
+    SysExReader<16> reader;
+    std::vector<uint8_t> message = makeMessage(SysEx::Command::State, 0, makePayload(16));
+    for (size_t i = 1; i + 1 < message.size(); i++)
+    {
+        std::vector<uint8_t> corrupt = message;
+        corrupt[i] ^= 0x01;
+        EXPECT_FALSE(receive(reader, corrupt)) << i;
+    }
+
+    // Cut short, too long for the buffer, or for another device
+    std::vector<uint8_t> truncated(message.begin(), message.end() - 4);
+    truncated.push_back(SysEx::End);
+    EXPECT_FALSE(receive(reader, truncated));
+    SysExReader<15> small;
+    EXPECT_FALSE(receive(small, message));
+    std::vector<uint8_t> other = message;
+    other[1] = 0x43;
+    EXPECT_FALSE(receive(reader, other));
+
+    // The reader takes the next message after a bad one, without a reset()
+    for (size_t i = 1; i + 1 < truncated.size(); i++)
+    {
+        reader.push(truncated[i]);
+    }
+    EXPECT_FALSE(reader.end());
+    for (size_t i = 1; i + 1 < message.size(); i++)
+    {
+        reader.push(message[i]);
+    }
+    EXPECT_TRUE(reader.end());
+}
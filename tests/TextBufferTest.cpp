@@ -0,0 +1,172 @@
+/**
+ * @file TextBufferTest.cpp
+ * @author Gino Bollaert
+ * @brief TextBuffer formatting and heap use of the display and menu render paths
+ * @details Replaces the global allocation functions with counting ones, so that a test can check that a render path
+ * makes no heap allocation once it has warmed up.
+ * @date 2023-06-24
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "Firmware.h"
+#include "Globals.h"
+#include "OledDisplay.h"
+#include "SettingsMenu.h"
+#include "Simulator.h"
+#include "TextBuffer.h"
+#include <atomic>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <new>
+
+void handleControlValue(MidiCC cc, int val);
+
+namespace
+{
+std::atomic<bool> countAllocations{false};
+std::atomic<int> allocations{0};
+
+/** Counts the heap allocations made during its lifetime */
+class AllocationCounter
+{
+public:
+    AllocationCounter()
+    {
+        allocations = 0;
+        countAllocations = true;
+    }
+    ~AllocationCounter() { countAllocations = false; }
+    int count() const { return allocations; }
+};
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    if (countAllocations)
+    {
+        allocations++;
+    }
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+TEST(TextBuffer, FormatsIntegers)
+{
+    DisplayText text;
+    text += 0;
+    text += ' ';
+    text += -128;
+    text += ' ';
+    text += static_cast<uint16_t>(65535);
+    text += ' ';
+    text += static_cast<int8_t>(-100);
+    text += '%';
+    EXPECT_STREQ(text.c_str(), "0 -128 65535 -100%");
+}
+
+TEST(TextBuffer, TruncatesAtCapacity)
+{
+    TextBuffer<8> text("< ");
+    text += "Vibrato";
+    text += " >";
+    EXPECT_STREQ(text.c_str(), "< Vibrat");
+    EXPECT_EQ(text.length(), 8);
+    text += 12345;
+    EXPECT_EQ(text.length(), 8);
+    text.clear();
+    text += TextBuffer<4>("ab");
+    EXPECT_STREQ(text.c_str(), "ab");
+}
+
+TEST(TextBuffer, FormattingDoesNotAllocate)
+{
+    AllocationCounter counter;
+    DisplayText text("Speed: ");
+    text += RateRpmCurve[127];
+    text += " rpm";
+    EXPECT_EQ(counter.count(), 0);
+}
+
+TEST(TextBuffer, StatusRenderingDoesNotAllocate)
+{
+    OledDisplay display(PinDisplayScl, PinDisplaySda);
+    display.init();
+    StatusRenderer status(display);
+    uint32_t now = 0;
+    AllocationCounter counter;
+    for (int val = 0; val < 128; val++)
+    {
+        DisplayText value;
+        value += PercentCurve[val];
+        value += '%';
+        status.set("Tremolo/Auto-pan:", value.c_str());
+        for (int i = 0; i < 8; i++)
+        {
+            status.update(now);
+            now += 5;
+        }
+    }
+    EXPECT_EQ(counter.count(), 0);
+}
+
+TEST(TextBuffer, MenuRenderingDoesNotAllocate)
+{
+    OledDisplay display(PinDisplayScl, PinDisplaySda);
+    display.init();
+    RotaryButton rotary(PB12, PB13, PB14, INPUT_PULLUP, false);
+    SettingsMenu menu(&display, rotary);
+    int channel = 1;
+    int mode = 0;
+    const char* modes[] = {"Vibrato", "Chorus"};
+    menu.addChild(new IntSetting("MIDI Channel", channel, 1, 16, 1));
+    menu.addChild(new ChoiceSetting("Mode", mode, modes, 2, 0));
+    menu.addChild(menu.createBackAction());
+    menu.show();
+
+    AllocationCounter counter;
+    for (int i = 0; i < 16; i++)
+    {
+        channel = i + 1;
+        menu.show();
+    }
+    EXPECT_EQ(counter.count(), 0);
+}
+
+TEST(TextBuffer, FirmwareControlPathDoesNotAllocate)
+{
+    sim::Simulator& simulator = sim::Simulator::instance();
+    simulator.reset();
+    setup();
+    for (int i = 0; i < 100; i++)
+    {
+        loop();
+        simulator.advance(50 * sim::Simulator::CyclesPerUs);
+    }
+
+    AllocationCounter counter;
+    const MidiCC controls[] = {MidiCC::Rate, MidiCC::RampTime, MidiCC::Volume, MidiCC::Expression,
+                               MidiCC::VoiceMode, MidiCC::AutopanWidth, MidiCC::Tremolo, MidiCC::Vibrato,
+                               MidiCC::RotaryPhase, MidiCC::Phaser};
+    for (int val = 0; val < 128; val += 9)
+    {
+        for (MidiCC cc : controls)
+        {
+            handleControlValue(cc, val);
+            for (int i = 0; i < 20; i++)
+            {
+                loop();
+                simulator.advance(50 * sim::Simulator::CyclesPerUs);
+            }
+        }
+    }
+    EXPECT_EQ(counter.count(), 0);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file TraceTest.cpp
+ * @author Gino Bollaert
+ * @brief Trace probe statistics and the host cycle counter
+ * @details
+ * @date 2023-07-09
+ * @copyright Gino Bollaert. All rights reserved.
+ */
+
+#include "Trace.h"
+#include <Arduino.h>
+#include <chrono>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <thread>
+
+TEST(Trace, StatsKeepMinMaxMeanAndLog2Histogram)
+{
+    TraceStats stats;
+    EXPECT_EQ(stats.mean(), 0u);
+    for (uint32_t cycles : {0u, 1u, 2u, 3u, 4u, 1000u, 1023u, 1024u, 0x80000000u})
+    {
+        stats.record(cycles);
+    }
+    EXPECT_EQ(stats.count, 9u);
+    EXPECT_EQ(stats.min, 0u);
+    EXPECT_EQ(stats.max, 0x80000000u);
+    EXPECT_EQ(stats.total, 0x80000000ull + 3057);
+    EXPECT_EQ(stats.mean(), static_cast<uint32_t>((0x80000000ull + 3057) / 9));
+    EXPECT_EQ(stats.histogram[0], 1u); // 0
+    EXPECT_EQ(stats.histogram[1], 1u); // 1
+    EXPECT_EQ(stats.histogram[2], 2u); // 2, 3
+    EXPECT_EQ(stats.histogram[3], 1u); // 4
+    EXPECT_EQ(stats.histogram[10], 2u); // 1000, 1023
+    EXPECT_EQ(stats.histogram[11], 1u); // 1024
+    EXPECT_EQ(stats.histogram[TraceStats::Buckets - 1], 1u); // anything over 2^23
+
+    stats.reset();
+    EXPECT_EQ(stats.count, 0u);
+    EXPECT_EQ(stats.min, UINT32_MAX);
+    EXPECT_EQ(stats.histogram[2], 0u);
+}
+
+TEST(Trace, HostCyclesCountAtCpuClock)
+{
+    traceBegin();
+    uint32_t start = traceCycles();
+    auto hostStart = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint32_t cycles = traceCycles() - start;
+    double hostMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - hostStart).count();
+    EXPECT_NEAR(cycles / (F_CPU / 1000.0), hostMs, 0.1);
+
+    // Back to back readings cost next to nothing
+    start = traceCycles();
+    uint32_t span = traceCycles() - start;
+    EXPECT_LT(span, 1000u);
+    std::printf("[          ] %.1f ms slept: %u cycles; back to back readings %u cycles apart\n", hostMs, cycles, span);
+}
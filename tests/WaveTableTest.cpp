@@ -9,10 +9,197 @@
 
 #include "WaveTable.h"
 #include <gtest/gtest.h>
+#include <vector>
 
 TEST(WaveTable, Ramp)
 {
     constexpr float SampleRate = 500;
     WaveTable<1> lfo(SampleRate, 1);
     lfo.rampFrequency(0.1, 1000);
-}
\ No newline at end of file
+}
+
+namespace
+{
+template <int N> void expectBlocksMatchPerSample(WaveTable<N>& block, WaveTable<N>& reference, int frames)
+{
+    std::vector<uint16_t> out(N * frames);
+    block.renderBlock(out.data(), frames);
+    for (int k = 0; k < frames; k++)
+    {
+        reference.advance();
+        for (int n = 0; n < N; n++)
+        {
+            ASSERT_EQ(out[n * frames + k], reference.sampleIP(n)) << "frame " << k << ", phase " << n;
+        }
+    }
+}
+
+template <int N> void rampAll(WaveTable<N>& lfo, float freq, uint32_t ms)
+{
+    for (int n = 0; n < N; n++)
+    {
+        lfo.rampPhaseOffset(n * 0x1c71c71cu, ms, n);
+    }
+    lfo.rampFrequency(freq, ms);
+}
+} // namespace
+
+TEST(WaveTable, RenderBlockSteadyState)
+{
+    constexpr uint32_t SampleRate = 502;
+    WaveTable<9> block(SampleRate, 0.75f);
+    WaveTable<9> reference(SampleRate, 0.75f);
+    for (int n = 0; n < 9; n++)
+    {
+        block.setPhaseOffset(n * 0x1c71c71cu, n);
+        reference.setPhaseOffset(n * 0x1c71c71cu, n);
+    }
+    for (int frames : {1, 7, 64, 500})
+    {
+        expectBlocksMatchPerSample(block, reference, frames);
+    }
+}
+
+TEST(WaveTable, RenderBlockAcrossRamp)
+{
+    constexpr uint32_t SampleRate = 502;
+    WaveTable<9> block(SampleRate, 0.75f);
+    WaveTable<9> reference(SampleRate, 0.75f);
+    rampAll(block, 6.6f, 100);
+    rampAll(reference, 6.6f, 100);
+
+    // 100 ms is 50 samples, so the ramp ends inside the third block
+    for (int frames : {16, 16, 32, 5, 128})
+    {
+        expectBlocksMatchPerSample(block, reference, frames);
+    }
+
+    rampAll(block, 0.3f, 2000);
+    rampAll(reference, 0.3f, 2000);
+    for (int i = 0; i < 20; i++)
+    {
+        expectBlocksMatchPerSample(block, reference, 61);
+    }
+}
+
+TEST(WaveTable, RenderFrameMatchesSeparateOutputStage)
+{
+    constexpr uint32_t SampleRate = 502;
+    constexpr int Shift = 4;
+    WaveTable<9> fused(SampleRate, 0.75f);
+    WaveTable<9> reference(SampleRate, 0.75f);
+    OutputGain gains[9];
+    for (int n = 0; n < 9; n++)
+    {
+        gains[n] = {static_cast<uint32_t>(0xffff - n * 0x1234), static_cast<uint32_t>(n * 0x0777)};
+    }
+    rampAll(fused, 6.6f, 100);
+    rampAll(reference, 6.6f, 100);
+
+    uint16_t out[9];
+    for (int k = 0; k < 200; k++)
+    {
+        fused.renderFrame<Shift>(gains, out);
+        reference.advance();
+        for (int n = 0; n < 9; n++)
+        {
+            uint32_t v = ((reference.sampleIP(n) * gains[n].mul) >> 16) + gains[n].offset;
+            ASSERT_EQ(out[n], v >> Shift) << "frame " << k << ", phase " << n;
+            ASSERT_EQ(fused.sampleIP(n), reference.sampleIP(n));
+        }
+    }
+}
+
+TEST(WaveTable, PhaseOffsetsRoundTripExactly)
+{
+    constexpr uint32_t SampleRate = 502;
+    // PhaseOffset2 and PhaseOffset3 from Globals.h, and values a float cannot hold
+    const uint32_t offsets[9] = {0, 1431655765u, 2863311531u, 0x12345679u, 0xffffffffu,
+                                 0x80000001u, 0x00ffff01u, 0xdeadbeefu, 7};
+    const uint32_t targets[9] = {2863311531u, 0, 1431655765u, 0xffffffffu, 0x12345679u,
+                                 0x7fffffffu, 0xdeadbeefu, 0x00ffff01u, 0x80000001u};
+    WaveTable<9> lfo(SampleRate, 0.75f);
+    lfo.setPhases(0, offsets);
+    lfo.resetPhase();
+    lfo.advance();
+    for (int n = 0; n < 9; n++)
+    {
+        ASSERT_EQ(lfo.phaseOffset(n), offsets[n]);
+        ASSERT_EQ(lfo.phase(n), offsets[n]);
+    }
+
+    lfo.rampPhases(0, targets, 1000);
+    for (int k = 0; k < 502; k++)
+    {
+        ASSERT_TRUE(lfo.ramping()) << "frame " << k;
+        lfo.advance();
+    }
+    lfo.advance();
+    for (int n = 0; n < 9; n++)
+    {
+        ASSERT_EQ(lfo.phase(n), targets[n]) << "phase " << n;
+    }
+
+    for (int n = 0; n < 9; n++)
+    {
+        lfo.rampPhaseOffset(offsets[n], 37, n);
+    }
+    for (int k = 0; k < 20; k++)
+    {
+        lfo.advance();
+    }
+    for (int n = 0; n < 9; n++)
+    {
+        ASSERT_EQ(lfo.phase(n), offsets[n]) << "phase " << n;
+    }
+}
+
+TEST(WaveTable, RampTakesTheShortestWayRound)
+{
+    WaveTable<1> lfo(502, 0.75f);
+    lfo.setPhaseDelta(0);
+    lfo.setPhaseOffset(0xf0000000u);
+    lfo.rampPhaseOffset(0x10000000u, 100);
+    uint32_t previous = 0xf0000000u;
+    for (int k = 0; k < 51; k++)
+    {
+        lfo.advance();
+        ASSERT_LE(lfo.phase() - previous, 0x20000000u / 50 + 1) << "frame " << k;
+        previous = lfo.phase();
+    }
+    EXPECT_EQ(lfo.phase(), 0x10000000u);
+}
+
+TEST(WaveTable, RampLengthAtEverySampleRate)
+{
+    for (uint32_t sampleRate : {500u, 999u, 1000u, 8000u, 48000u})
+    {
+        WaveTable<1> lfo(sampleRate, 1);
+        lfo.setPhaseDelta(0);
+        lfo.rampPhaseOffset(0x80000000u, 1000);
+        uint32_t samples = 0;
+        while (lfo.ramping() && samples <= sampleRate)
+        {
+            lfo.advance();
+            samples++;
+        }
+        EXPECT_EQ(samples, sampleRate) << sampleRate << " Hz";
+        lfo.advance();
+        EXPECT_EQ(lfo.phase(), 0x80000000u) << sampleRate << " Hz";
+    }
+}
+
+TEST(WaveTable, PhaseDeltaQ16)
+{
+    for (uint32_t sampleRate : {500u, 502u, 1000u, 17574u})
+    {
+        WaveTable<1> lfo(sampleRate, 1);
+        for (uint32_t freq = 1; freq < 30 << 16; freq = freq * 3 + 7)
+        {
+            double exact = freq * 65536.0 / sampleRate;
+            EXPECT_NEAR(lfo.phaseDeltaQ16(freq), exact, 1.0) << freq << " / 65536 Hz at " << sampleRate;
+        }
+        EXPECT_EQ(lfo.phaseDeltaQ16(static_cast<uint32_t>(sampleRate) << 16), 0u); // one cycle per sample wraps
+        EXPECT_EQ(lfo.phaseDeltaQ16(static_cast<uint32_t>(sampleRate) << 15), 0x80000000u);
+    }
+}
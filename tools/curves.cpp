@@ -2,48 +2,71 @@
  * @file curves.cpp
  * @author Gino Bollaert
  * @brief MIDI CC curve preview
- * @details
+ * @details Prints the lookup tables from Curves.h that the firmware uses
  * @date 2023-05-12
  * @copyright Gino Bollaert. All rights reserved.
  */
 
-#include <iostream>
+#include "Curves.h"
 #include <cmath>
+#include <iostream>
 
 int main()
 {
     std::cout << "Rate:\n";
-    for (int val = 0; val < 128; val++)
+    for (int val = 0; val < CurveSize; val++)
     {
-        float rate = val * 3.f / 127;
-        rate = rate + rate * rate * rate;
-        std::cout << "  " << val << ":\t" << rate << "Hz = " << int(rate * 60 + 0.5f) << "RPM\n";
+        std::cout << "  " << val << ":\t" << RateCurve[val] / 65536.0 << "Hz = " << RateRpmCurve[val] << "RPM\n";
     }
     std::cout << std::dec << '\n';
 
     std::cout << "Ramp Time:\n";
-    for (int val = 0; val < 128; val++)
+    for (int val = 0; val < CurveSize; val++)
     {
-        uint32_t ms = ((1001 * val) >> 7) + ((4071 * val * val) >> 14);
-        std::cout << "  " << val << ":\t" << ms << " ms\n";
+        std::cout << "  " << val << ":\t" << RampTimeCurve[val] << " ms\n";
     }
     std::cout << std::dec << '\n';
 
     std::cout << "Volume / Expression:\n";
-    for (int val = 0; val < 128; val++)
+    for (int val = 0; val < CurveSize; val++)
     {
-        uint16_t v = ((val * val) << 1) + val * 262;
+        uint16_t v = VolumeCurve[val];
         float f = float(v) / 0xffff;
         float d = 20 * log10f(f);
         std::cout << "  " << std::dec << val << ":\t" << d << "dB = " << f << "\t(" << std::hex << v << ")\n";
     }
     std::cout << std::dec << '\n';
 
-    std::cout << "Autopan Width:\n";
-    for (int val = 0; val < 128; val++)
+    std::cout << "Tremolo / Vibrato / Phaser Depth:\n";
+    for (int val = 0; val < CurveSize; val++)
     {
-        int p = val * 200 / 128;
-        std::cout << "  " << val << ":\t" << (p > 100 ? p - 200 : p) << "%\n";
+        std::cout << "  " << std::dec << val << ":\t" << int(PercentCurve[val]) << "%\t(" << std::hex
+                  << DepthCurve[val] << ")\n";
     }
     std::cout << std::dec << '\n';
-}
\ No newline at end of file
+
+    std::cout << "Autopan Width / Rotary Phase:\n";
+    for (int val = 0; val < CurveSize; val++)
+    {
+        std::cout << "  " << std::dec << val << ":\t" << int(SignedPercentCurve[val]) << "%\t(" << std::hex
+                  << AutopanWidthCurve[val] << ", " << RotaryPhaseCurve[val] << ")\n";
+    }
+    std::cout << std::dec << '\n';
+
+    std::cout << "Compressor Attack / Release / Threshold / Amount:\n";
+    for (int val = 0; val < CurveSize; val++)
+    {
+        std::cout << "  " << std::dec << val << ":\t" << CompressorAttackCurve[val] << " ms\t"
+                  << CompressorReleaseCurve[val] << " ms\t" << int(CompressorThresholdDbCurve[val]) << "dB\t"
+                  << int(PercentCurve[val]) << "%\t(" << CompressorThresholdCurve[val] << ", " << std::hex
+                  << CompressorAmountCurve[val] << ")\n";
+    }
+    std::cout << std::dec << '\n';
+
+    std::cout << "Clock Division (ticks per cycle):\n";
+    for (int val = 0; val < CurveSize; val += 16)
+    {
+        std::cout << "  " << val << "-" << val + 15 << ":\t" << int(ClockDivisionCurve[val]) << '\n';
+    }
+    std::cout << '\n';
+}